@@ -122,15 +122,28 @@
 #include <linux/slab.h>
 #include <linux/usb.h>
 #include <linux/moduleparam.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
+#include <linux/vmalloc.h>
+#include <linux/log2.h>
+#include <linux/bitmap.h>
+#include <linux/mm.h>
+#include <linux/uaccess.h>
 
 #include <sound/control.h>
 #include <sound/tlv.h>
+#include <sound/hwdep.h>
 
 #include "usbaudio.h"
+#include "card.h"
 #include "mixer.h"
 #include "helper.h"
 
 #include "mixer_scarlett_gen2.h"
+#include "mixer_scarlett_gen2_hwdep.h"
+
+#define CREATE_TRACE_POINTS
+#include "mixer_scarlett_gen2_trace.h"
 
 /* device_setup value to enable */
 #define SCARLETT2_ENABLE 0x01
@@ -138,6 +151,53 @@
 /* device_setup value to allow turning MSD mode back on */
 #define SCARLETT2_MSD_ENABLE 0x02
 
+/* The configuration is saved to NVRAM when it has not been changed for
+ * save_quiet_ms, but not later than save_max_delay_ms after the first
+ * unsaved change
+ */
+static unsigned int scarlett2_save_quiet_ms = 2000;
+module_param_named(scarlett2_save_quiet_ms, scarlett2_save_quiet_ms, uint, 0644);
+MODULE_PARM_DESC(scarlett2_save_quiet_ms, "Scarlett Gen 2/3: quiet period before saving the configuration to NVRAM (ms)");
+
+static unsigned int scarlett2_save_max_delay_ms = 10000;
+module_param_named(scarlett2_save_max_delay_ms, scarlett2_save_max_delay_ms, uint, 0644);
+MODULE_PARM_DESC(scarlett2_save_max_delay_ms, "Scarlett Gen 2/3: maximum delay of saving the configuration to NVRAM (ms)");
+
+/* Transport backend of the proprietary protocol: "usb" or "loopback" */
+static char *scarlett2_transport = "usb";
+module_param_named(scarlett2_transport, scarlett2_transport, charp, 0444);
+MODULE_PARM_DESC(scarlett2_transport, "Scarlett Gen 2/3: transport of the proprietary protocol (usb, loopback)");
+
+/* Count transfers of each command on top of the selected transport */
+static bool scarlett2_record;
+module_param_named(scarlett2_record, scarlett2_record, bool, 0444);
+MODULE_PARM_DESC(scarlett2_record, "Scarlett Gen 2/3: record statistics of the proprietary protocol transfers");
+
+/* Number of packets kept by the protocol capture, 0 disables it */
+static unsigned int scarlett2_pcap_entries;
+module_param_named(scarlett2_pcap_entries, scarlett2_pcap_entries, uint, 0444);
+MODULE_PARM_DESC(scarlett2_pcap_entries, "Scarlett Gen 2/3: number of proprietary packets captured for debugfs capture.pcap (0 = off)");
+
+/* Token bucket limits of the proprietary traffic in bytes per second, 0 = unlimited */
+static unsigned int scarlett2_rate_limit;
+module_param_named(scarlett2_rate_limit, scarlett2_rate_limit, uint, 0644);
+MODULE_PARM_DESC(scarlett2_rate_limit, "Scarlett Gen 2/3: proprietary traffic limit while no PCM stream is running (bytes/s, 0 = unlimited)");
+
+static unsigned int scarlett2_rate_limit_pcm = 65536;
+module_param_named(scarlett2_rate_limit_pcm, scarlett2_rate_limit_pcm, uint, 0644);
+MODULE_PARM_DESC(scarlett2_rate_limit_pcm, "Scarlett Gen 2/3: proprietary traffic limit while a PCM stream is running (bytes/s, 0 = unlimited)");
+
+static unsigned int scarlett2_rate_burst = 4096;
+module_param_named(scarlett2_rate_burst, scarlett2_rate_burst, uint, 0644);
+MODULE_PARM_DESC(scarlett2_rate_burst, "Scarlett Gen 2/3: proprietary traffic burst allowed by the limiter (bytes)");
+
+/* Verify the incrementally maintained checksum of the software
+ * configuration against the full recompute on each commit
+ */
+static bool scarlett2_cksum_check;
+module_param_named(scarlett2_cksum_check, scarlett2_cksum_check, bool, 0644);
+MODULE_PARM_DESC(scarlett2_cksum_check, "Scarlett Gen 2/3: verify the software configuration checksum with the full recompute (debug)");
+
 /* some gui mixers can't handle negative ctl values */
 #define SCARLETT2_VOLUME_BIAS 127
 
@@ -229,7 +289,30 @@ static const u16 scarlett2_sw_config_mixer_values[173] = {
 
 #define SCARLETT2_SW_CONFIG_BASE                 0xec
 
-#define SCARLETT2_SW_CONFIG_PACKET_SIZE          992      /* The maximum packet size used to transfer data */
+#define SCARLETT2_SW_CONFIG_PACKET_SIZE          992      /* The packet size known to work for all devices */
+#define SCARLETT2_USB_MAX_CHUNK                  1024     /* The largest data chunk probed at initialisation */
+#define SCARLETT2_CONFIG_MIRROR_MAX              0xb2     /* Size of the largest hardware configuration area */
+#define SCARLETT2_CONFIG_SPACE_MAX               0x100    /* Bytes addressable by the config items */
+#define SCARLETT2_CONFIG_WRITE_GAP               4        /* Largest gap filled from the mirror to join writes */
+#define SCARLETT2_HWDEP_CFG_OFFSET               0x40     /* Hardware configuration copy in the shared memory */
+#define SCARLETT2_HWDEP_SW_CFG_OFFSET            PAGE_SIZE /* Software configuration copy in the shared memory */
+#define SCARLETT2_HWDEP_XFER_MAX                 0x2000   /* Largest ranged read or write of the hwdep device */
+#define SCARLETT2_USB_MAX_PAYLOAD                (SCARLETT2_USB_MAX_CHUNK + 8) /* SET_DATA offset, size and one data chunk */
+#define SCARLETT2_CMD_SLOTS                      32       /* Number of preallocated command slots */
+#define SCARLETT2_CMD_TIMEOUT                    1000     /* Timeout of one USB transfer in milliseconds */
+#define SCARLETT2_ACTIVATE_DELAY                 10       /* Window for collecting activations in milliseconds */
+#define SCARLETT2_SW_FLUSH_DELAY                 20       /* Window for collecting software configuration changes in milliseconds */
+#define SCARLETT2_SW_FLUSH_GAP                   32       /* Largest clean gap sent to join dirty ranges */
+#define SCARLETT2_SW_FLUSH_RETRY_DELAY           200      /* Delay before sending the software configuration again after a failure in milliseconds */
+#define SCARLETT2_CMD_RETRIES                    3        /* Number of retries of the failed command */
+#define SCARLETT2_CMD_BACKOFF                    2        /* Delay before the first retry in milliseconds, doubled each time */
+#define SCARLETT2_RESYNC_ATTEMPTS                3        /* Number of attempts to redo the INIT_1/INIT_2 handshake */
+#define SCARLETT2_PCM_SUBSTREAMS_MAX             8        /* Largest number of PCM substreams watched by the rate limiter */
+
+/* Recovery of the failed command */
+#define SCARLETT2_RECOVER_NONE                   0        /* The device has rejected the command, fail it */
+#define SCARLETT2_RECOVER_RETRY                  1        /* Send the command again */
+#define SCARLETT2_RECOVER_RESYNC                 2        /* Resynchronise the sequence numbers, then send it again */
 
 #define SCARLETT2_SW_CONFIG_MIXER_INPUTS         30       /* 30 inputs per one mixer in config */
 #define SCARLETT2_SW_CONFIG_MIXER_OUTPUTS        12       /* 12 outputs in config */
@@ -303,6 +386,9 @@ enum {
 	SCARLETT2_CONFIG_COUNT = 18
 };
 
+#define SCARLETT2_CONFIG_BIT(item)               BIT(SCARLETT2_CONFIG_##item)
+#define SCARLETT2_CONFIG_ALL                     (BIT(SCARLETT2_CONFIG_COUNT) - 1)
+
 static const char *const scarlett2_button_names[SCARLETT2_BUTTON_MAX] = {
 	"Mute", "Dim"
 };
@@ -414,11 +500,37 @@ struct scarlett2_sw_cfg {
 	__le32 checksum;                                                    /* +0x1a6c: checksum of the area */
 } __packed;
 
+struct scarlett2_transport_ops;
+struct scarlett2_record;
+struct scarlett2_pcap;
+struct scarlett2_cmd_stats;
+
+/* Proprietary command queued for asynchronous transfer */
+struct scarlett2_cmd {
+	struct list_head list;                                            /* Link in the queue or in the free list */
+	u32 cmd;                                                          /* Command code */
+	u16 req_size;                                                     /* Size of the request payload */
+	u16 resp_size;                                                    /* Expected size of the response payload */
+	void *resp_data;                                                  /* Where to store the response payload, may be NULL */
+	struct completion *done;                                          /* Signalled on finish, NULL for asynchronous commands */
+	int err;                                                          /* Result of the command */
+	u8 low_prio;                                                      /* Polling command, sent when no other command waits */
+	u8 retries;                                                       /* Number of failed attempts */
+	struct scarlett2_usb_packet *req;                                 /* DMA-safe request packet, payload is built in place */
+	u64 queue_ns;                                                     /* Time when the command has been queued */
+	u64 submit_ns;                                                    /* Time when the transfer has been started */
+};
+
 struct scarlett2_mixer_data {
 	struct usb_mixer_interface *mixer;
-	struct mutex usb_mutex; /* prevent sending concurrent USB requests */
+	struct mutex usb_mutex; /* prevent interleaving of multi-packet USB transactions */
 	struct mutex data_mutex; /* lock access to this data */
+	struct workqueue_struct *wq; /* ordered queue for the deferred work of this device */
 	struct delayed_work work;
+	struct delayed_work activate_work; /* deferred activation of changed config items */
+	u32 activate_pending; /* bit mask of pending activations, protected by cmd_lock */
+	u8 save_pending; /* NVRAM save has been scheduled, protected by cmd_lock */
+	unsigned long save_first; /* time of the first unsaved change, protected by cmd_lock */
 	const struct scarlett2_device_info *info;
 	__u8 interface; /* vendor-specific interface number */
 	__u8 endpoint; /* interrupt endpoint address */
@@ -427,6 +539,7 @@ struct scarlett2_mixer_data {
 	int num_inputs; /* Overall number of inputs */
 	int num_outputs; /* Overall number of outputs */
 	u16 scarlett2_seq;
+	u16 chunk_size; /* maximum data size of GET_DATA accepted by the device */
 	u8 vol_updated; /* Flag that indicates that volume has been updated */
 	u8 line_ctl_updated; /* Flag that indicates that state of PAD, INST buttons have been updated */
 	u8 speaker_updated; /* Flag that indicates that speaker/talkback has been updated */
@@ -460,13 +573,125 @@ struct scarlett2_mixer_data {
 	struct snd_kcontrol *pow_ctls[SCARLETT2_48V_SWITCH_MAX];
 	struct snd_kcontrol *button_ctls[SCARLETT2_BUTTON_MAX];
 	struct snd_kcontrol *mix_talkback_ctls[SCARLETT2_OUTPUT_MIX_MAX]; /* Talkback controls for each mix */
+	struct snd_kcontrol *mix_ctls[SCARLETT2_INPUT_MIX_MAX * SCARLETT2_OUTPUT_MIX_MAX]; /* Matrix mixer gain controls */
+	struct snd_kcontrol *mix_mute_ctls[SCARLETT2_INPUT_MIX_MAX * SCARLETT2_OUTPUT_MIX_MAX]; /* Matrix mixer mute controls */
+	struct snd_kcontrol *mux_ctls[SCARLETT2_MUX_MAX];                 /* Routing controls */
+	struct snd_kcontrol *ghalo_custom_ctl;                            /* Custom gain halos control */
+	struct snd_kcontrol *ghalo_led_ctls[SCARLETT2_GAIN_HALO_LEDS_MAX]; /* Gain halo led controls */
+	struct snd_kcontrol *ghalo_level_ctls[SCARLETT2_GAIN_HALO_LEVELS]; /* Gain halo level controls */
+	struct snd_kcontrol *ghalo_scheme_ctl;                            /* Whole gain halo color scheme */
 	s8 mux[SCARLETT2_MUX_MAX];                                        /* Routing of outputs */
 	u8 mix[SCARLETT2_INPUT_MIX_MAX * SCARLETT2_OUTPUT_MIX_MAX];       /* Matrix mixer */
 	u8 mix_talkback[SCARLETT2_OUTPUT_MIX_MAX];                        /* Talkback enable for mixer output */
 	u8 mix_mutes[SCARLETT2_INPUT_MIX_MAX * SCARLETT2_OUTPUT_MIX_MAX]; /* Mixer input mutes */
 
+	/* Hardware configuration mirror */
+	spinlock_t cfg_lock;                                              /* Protects the mirror */
+	u8 *cfg_mirror;                                                   /* Copy of the hardware configuration area, in shm */
+	u8 cfg_mirror_size;                                               /* Size of the configuration area of the device */
+	u32 cfg_valid;                                                    /* Bit mask of config items valid in the mirror */
+	u32 cfg_inval_count;                                              /* Number of invalidations, detects races with reads */
+	struct work_struct cfg_refresh_work;                              /* Reads the configuration changed by the device */
+	unsigned long stat_cfg_hits;                                      /* Number of reads served from the mirror */
+	unsigned long stat_cfg_misses;                                    /* Number of reads sent to the device */
+	DECLARE_BITMAP(cfg_deferred, SCARLETT2_CONFIG_MIRROR_MAX);        /* Mirror bytes held back by the deferred commit */
+	u32 cfg_deferred_activate;                                        /* Activations held back by the deferred commit */
+
+	/* Deferred commit mode */
+	u8 deferred;                                                      /* Controls only update the driver state */
+	u8 deferred_mux;                                                  /* Routing has to be sent with SET_MUX */
+	u32 deferred_mix;                                                 /* Mixes to be sent with SET_MIX */
+
 	/* Software configuration */
 	struct scarlett2_sw_cfg *sw_cfg;                                  /* Software configuration data */
+	struct scarlett2_sw_cfg *sw_cfg_shadow;                           /* Committed software configuration and its checksum */
+	struct scarlett2_sw_cfg *sw_cfg_shm;                              /* Committed software configuration, in shm */
+	DECLARE_BITMAP(sw_dirty, sizeof(struct scarlett2_sw_cfg));        /* Committed bytes not sent to the device yet */
+	u8 sw_cksum_dirty;                                                /* The checksum has to be sent after the sent ranges */
+	DECLARE_BITMAP(sw_staged, sizeof(struct scarlett2_sw_cfg));       /* Bytes changed by the open transaction */
+	u8 sw_txn_depth;                                                  /* Nesting depth of the open transaction */
+	struct delayed_work sw_flush_work;                                /* Sends the dirty ranges */
+	unsigned long stat_sw_commits;                                    /* Number of committed transactions */
+	unsigned long stat_sw_aborts;                                     /* Number of aborted transactions */
+	unsigned long stat_sw_flushes;                                    /* Number of flushes sent to the device */
+	unsigned long stat_sw_ranges;                                     /* Number of ranges sent by the flushes */
+
+	/* Memory shared with user space through the hwdep device */
+	struct scarlett2_hwdep_shm *shm;                                  /* Header followed by the configuration copies */
+	u32 shm_size;                                                     /* Size of the shared memory */
+	struct snd_hwdep *hwdep;                                          /* The hwdep device */
+
+	/* Asynchronous command engine */
+	spinlock_t cmd_lock;                                              /* Protects the command queue and the engine state */
+	struct list_head cmd_queue;                                       /* Commands waiting for transfer */
+	struct list_head cmd_queue_low;                                   /* Meter and status polls waiting for transfer */
+	struct list_head cmd_free;                                        /* Unused command slots */
+	wait_queue_head_t cmd_wait;                                       /* Wait for a free slot or for the idle engine */
+	struct scarlett2_cmd *cmd_slots;                                  /* Preallocated command slots */
+	struct scarlett2_cmd *cmd_active;                                 /* Command currently being transferred */
+	struct scarlett2_usb_packet *cmd_resp;                            /* DMA-safe response packet */
+	struct timer_list cmd_timer;                                      /* Transfer timeout watchdog */
+	u8 cmd_shutdown;                                                  /* Engine does not accept new commands */
+	u8 cmd_timed_out;                                                 /* Active transfer has been cancelled by the watchdog */
+	u8 cmd_cancelling;                                                /* Watchdog is cancelling, nothing new is submitted */
+	unsigned long cmd_deadline;                                       /* Expiry of the active transfer */
+	u8 cmd_backoff;                                                   /* Transfers are held back until the retry delay passes */
+	u8 resync_step;                                                   /* Pending handshake command: 0 none, 1 INIT_1, 2 INIT_2 */
+	u8 resync_attempts;                                               /* Failed handshakes of the current resynchronisation */
+	struct timer_list cmd_backoff_timer;                              /* End of the retry delay */
+	u8 cmd_throttled;                                                 /* Transfers are held back by the rate limiter */
+	u32 rate_tokens;                                                  /* Bytes which may be transferred without waiting */
+	u64 rate_last;                                                    /* Time of the last token refill */
+	struct snd_usb_substream *pcm_subs[SCARLETT2_PCM_SUBSTREAMS_MAX]; /* PCM substreams of the card, taken at probe */
+	u8 num_pcm_subs;                                                  /* Number of the PCM substreams */
+	struct timer_list cmd_throttle_timer;                             /* Time when enough tokens are available */
+	struct scarlett2_cmd resync_cmd;                                  /* Command slot reserved for the handshake */
+	unsigned int cmd_errors;                                          /* Number of failed asynchronous commands */
+	int cmd_last_error;                                               /* Error code of the last failed asynchronous command */
+	struct snd_kcontrol *cmd_status_ctl;                              /* Command status control */
+
+	/* Transport backend */
+	const struct scarlett2_transport_ops *transport;                  /* Transport used by the command engine */
+	const struct scarlett2_transport_ops *transport_lower;            /* Transport wrapped by the recorder, NULL if not recording */
+	const struct scarlett2_transport_ops *xfer_ops;                   /* Transport served by xfer_work */
+	void *transport_data;                                             /* Private data of the transport */
+	struct scarlett2_record *record;                                  /* Recorder state */
+	struct scarlett2_pcap *pcap;                                      /* Protocol capture ring, NULL if disabled */
+	struct work_struct xfer_work;                                     /* Transfer for transports without asynchronous I/O */
+	struct urb *cmd_urb;                                              /* Control URB used for all USB transfers */
+	struct usb_ctrlrequest *cmd_setup;                                /* Setup packet of the control URB */
+
+	/* Statistics, protected by cmd_lock */
+	unsigned long stat_cmd_sent;                                      /* Number of commands transferred to the device */
+	unsigned long stat_cmd_retries;                                   /* Number of retried transfers */
+	unsigned long stat_resyncs;                                       /* Number of sequence resynchronisations */
+	unsigned long stat_resync_failed;                                 /* Number of resynchronisations given up */
+	unsigned long stat_throttled;                                     /* Number of commands delayed by the rate limiter */
+	unsigned long stat_throttled_pcm;                                 /* Number of delays while a PCM stream was running */
+	u64 stat_throttle_ns;                                             /* Overall time the commands were delayed */
+	unsigned long stat_set_data;                                      /* Number of queued SET_DATA commands */
+	unsigned long stat_set_data_merged;                               /* Number of SET_DATA commands merged into pending ones */
+	unsigned long stat_set_data_merged_bytes;                         /* Number of bytes carried by the merged commands */
+	unsigned long stat_activate_requested;                            /* Number of requested activations */
+	unsigned long stat_activate_sent;                                 /* Number of DATA_CMD activations sent */
+	unsigned long stat_save_issued;                                   /* Number of NVRAM saves sent */
+	unsigned long stat_save_coalesced;                                /* Number of changes joined to the pending NVRAM save */
+	struct scarlett2_cmd_stats *cmd_stats;                            /* Statistics for each command id */
+
+	/* Meter polling */
+	struct mutex meter_mutex;                                         /* Allows one meter poll at a time */
+	u16 meter_levels[SCARLETT2_NUM_METERS];                           /* Result of the last meter poll */
+	u64 meter_time;                                                   /* Time when the last meter poll has finished */
+	unsigned long stat_meter_polls;                                   /* Number of meter polls sent to the device */
+	unsigned long stat_meter_merged;                                  /* Number of meter reads served by a concurrent poll */
+
+	/* Lock hold times, updated by the owner of the mutex */
+	u64 usb_mutex_locked;                                             /* Time when usb_mutex has been taken */
+	u64 usb_mutex_max_hold;                                           /* Maximum hold time of usb_mutex (ns) */
+	u64 data_mutex_locked;                                            /* Time when data_mutex has been taken */
+	u64 data_mutex_max_hold;                                          /* Maximum hold time of data_mutex (ns) */
+
+	struct dentry *debugfs_dir;                                       /* Debugfs directory of the device */
 };
 
 /*
@@ -568,6 +793,16 @@ struct scarlett2_usb_packet {
 	u8 data[];
 };
 
+/* SET_DATA request payload */
+struct scarlett2_usb_set_data {
+	__le32 offset;
+	__le32 size;
+	u8 data[];
+} __packed;
+
+/* The size of the preallocated request/response buffers */
+#define SCARLETT2_USB_MAX_PACKET (sizeof(struct scarlett2_usb_packet) + SCARLETT2_USB_MAX_PAYLOAD)
+
 /*** Model-specific data ***/
 static const struct scarlett2_port_name s6i6_gen2_ports[] = {
 	{ SCARLETT2_PORT_OUT, SCARLETT2_PORT_TYPE_ANALOGUE, 0, "Headphones 1 L" },
@@ -1435,6 +1670,42 @@ static const struct scarlett2_device_info *scarlett2_supported_devices[] = {
 #define SCARLETT2_USB_SET_DATA                   0x00800001
 #define SCARLETT2_USB_DATA_CMD                   0x00800002
 
+/* Indexes of commands in statistics */
+enum {
+	SCARLETT2_CMD_ID_INIT_1,
+	SCARLETT2_CMD_ID_INIT_2,
+	SCARLETT2_CMD_ID_GET_METER_LEVELS,
+	SCARLETT2_CMD_ID_SET_MIX,
+	SCARLETT2_CMD_ID_GET_MUX,
+	SCARLETT2_CMD_ID_SET_MUX,
+	SCARLETT2_CMD_ID_GET_DATA,
+	SCARLETT2_CMD_ID_SET_DATA,
+	SCARLETT2_CMD_ID_DATA_CMD,
+	SCARLETT2_CMD_ID_OTHER,
+	SCARLETT2_CMD_ID_COUNT
+};
+
+static const char *const scarlett2_cmd_names[SCARLETT2_CMD_ID_COUNT] = {
+	"INIT_1", "INIT_2", "GET_METER_LEVELS", "SET_MIX", "GET_MUX",
+	"SET_MUX", "GET_DATA", "SET_DATA", "DATA_CMD", "OTHER"
+};
+
+static int scarlett2_cmd_id(u32 cmd)
+{
+	switch (cmd) {
+	case SCARLETT2_USB_INIT_1:           return SCARLETT2_CMD_ID_INIT_1;
+	case SCARLETT2_USB_INIT_2:           return SCARLETT2_CMD_ID_INIT_2;
+	case SCARLETT2_USB_GET_METER_LEVELS: return SCARLETT2_CMD_ID_GET_METER_LEVELS;
+	case SCARLETT2_USB_SET_MIX:          return SCARLETT2_CMD_ID_SET_MIX;
+	case SCARLETT2_USB_GET_MUX:          return SCARLETT2_CMD_ID_GET_MUX;
+	case SCARLETT2_USB_SET_MUX:          return SCARLETT2_CMD_ID_SET_MUX;
+	case SCARLETT2_USB_GET_DATA:         return SCARLETT2_CMD_ID_GET_DATA;
+	case SCARLETT2_USB_SET_DATA:         return SCARLETT2_CMD_ID_SET_DATA;
+	case SCARLETT2_USB_DATA_CMD:         return SCARLETT2_CMD_ID_DATA_CMD;
+	default:                             return SCARLETT2_CMD_ID_OTHER;
+	}
+}
+
 /*#define SCARLETT2_USB_VOLUME_STATUS_OFFSET 0x31*/
 #define SCARLETT2_VOLUMES_BASE                   0x34
 
@@ -1728,2420 +1999,5264 @@ static void scarlett2_fill_request_header(struct scarlett2_mixer_data *private,
 	req->pad = 0;
 }
 
-static int scarlett2_usb_tx(struct usb_device *dev, int interface,
-			    void *buf, u16 size)
-{
-	return snd_usb_ctl_msg(dev, usb_sndctrlpipe(dev, 0),
-			SCARLETT2_USB_CMD_REQ,
-			USB_RECIP_INTERFACE | USB_TYPE_CLASS | USB_DIR_OUT,
-			0, interface, buf, size);
-}
+/* Transport backend of the proprietary protocol. The synchronous tx()
+ * and rx() transfer one packet and return the number of transferred
+ * bytes. submit() is called with cmd_lock held, it starts the transfer
+ * of the command request followed by the transfer of the response into
+ * private->cmd_resp, and the end is reported by scarlett2_cmd_xfer_done().
+ * cancel() aborts the active transfer. An emulated transport replies
+ * without the device, so the probe does not need the vendor-specific
+ * interface and the interrupt endpoint is not polled.
+ */
+struct scarlett2_transport_ops {
+	const char *name;
+	bool emulated;
+	int (*init)(struct scarlett2_mixer_data *private);
+	void (*free)(struct scarlett2_mixer_data *private);
+	int (*tx)(struct scarlett2_mixer_data *private, u8 request, void *buf, u16 size);
+	int (*rx)(struct scarlett2_mixer_data *private, u8 request, void *buf, u16 size);
+	int (*submit)(struct scarlett2_mixer_data *private, struct scarlett2_cmd *cmd);
+	void (*cancel)(struct scarlett2_mixer_data *private);
+};
 
-static int scarlett2_usb_rx(struct usb_device *dev, int interface,
-			    u32 usb_req, void *buf, u16 size)
-{
-	return snd_usb_ctl_msg(dev, usb_sndctrlpipe(dev, 0),
-			usb_req,
-			USB_RECIP_INTERFACE | USB_TYPE_CLASS | USB_DIR_IN,
-			0, interface, buf, size);
-}
+/*** Protocol capture ***
+ *
+ * Requests and responses are stored with timestamps in a lock-free ring:
+ * writers reserve entries with an atomic counter and publish them with
+ * the sequence number, readers drop entries overwritten while copying.
+ * The debugfs capture.pcap file presents the ring as USBPcap control
+ * transfers, the format reverse-eng/decode.cpp reads.
+ */
 
-static int scarlett2_usb(
-	struct usb_mixer_interface *mixer, u32 cmd,
-	void *req_data, u16 req_size, void *resp_data, u16 resp_size);
+#define SCARLETT2_PCAP_REQUEST                   0        /* Host to device packet */
+#define SCARLETT2_PCAP_RESPONSE                  1        /* Device to host packet */
 
-static int scarlett2_commit_software_config(
-	struct usb_mixer_interface *mixer,
-	void *ptr, /* the pointer of the first changed byte in the configuration */
-	int bytes /* the actual number of bytes changed in the configuration */
-);
-static int scarlett2_update_volumes(struct usb_mixer_interface *mixer);
+struct scarlett2_pcap_entry {
+	u32 seq;                                                          /* Index of the stored packet + 1, 0 while being written */
+	u16 len;                                                          /* Length of the packet */
+	u8 dir;                                                           /* SCARLETT2_PCAP_REQUEST or SCARLETT2_PCAP_RESPONSE */
+	u64 time_ns;                                                      /* Wall clock time of the transfer */
+	u8 data[SCARLETT2_USB_MAX_PACKET];                                /* Packet data */
+};
 
-/* Cargo cult proprietary initialisation sequence */
-static int scarlett2_usb_init(struct usb_mixer_interface *mixer)
-{
-	struct snd_usb_audio *chip = mixer->chip;
-	struct usb_device *dev = chip->dev;
-	struct scarlett2_mixer_data *private = mixer->private_data;
-	u16 buf_size = sizeof(struct scarlett2_usb_packet) + 8;
-	struct scarlett2_usb_packet *buf;
-	int err;
+struct scarlett2_pcap {
+	atomic_t head;                                                    /* Number of packets ever written */
+	u32 mask;                                                         /* Number of entries - 1 */
+	struct scarlett2_pcap_entry entries[];
+};
 
-	if (snd_usb_pipe_sanity_check(dev, usb_sndctrlpipe(dev, 0))) {
-		return -EINVAL;
-	}
+/* pcap file format with USBPcap link type */
+struct scarlett2_pcap_file_hdr {
+	__le32 magic;
+	__le16 version_major;
+	__le16 version_minor;
+	__le32 thiszone;
+	__le32 sigfigs;
+	__le32 snaplen;
+	__le32 network;
+} __packed;
 
-	buf = kmalloc(buf_size, GFP_KERNEL);
-	if (!buf) {
-		err = -ENOMEM;
-		goto error;
-	}
+struct scarlett2_pcap_rec_hdr {
+	__le32 ts_sec;
+	__le32 ts_usec;
+	__le32 incl_len;
+	__le32 orig_len;
+} __packed;
 
-	// step 0
-	err = scarlett2_usb_rx(dev, private->interface, SCARLETT2_USB_CMD_INIT,
-			       buf, buf_size);
-	if (err < 0)
-		goto error;
+struct scarlett2_usbpcap_hdr {
+	__le16 header_len;
+	__le64 irp_id;
+	__le32 status;
+	__le16 function;
+	u8 info;
+	__le16 bus;
+	__le16 device;
+	u8 endpoint;
+	u8 transfer;
+	__le32 data_length;
+	u8 stage;
+} __packed;
 
-	// step 1
-	private->scarlett2_seq = 1;
-	err = scarlett2_usb(mixer, SCARLETT2_USB_INIT_1, NULL, 0, NULL, 0);
-	if (err < 0)
-		goto error;
+#define SCARLETT2_PCAP_LINKTYPE_USBPCAP          249
+#define SCARLETT2_USBPCAP_CONTROL_TRANSFER       0x08     /* URB_FUNCTION_CONTROL_TRANSFER */
+#define SCARLETT2_USBPCAP_TRANSFER_CONTROL       2
+#define SCARLETT2_USBPCAP_INFO_PDO_TO_FDO        0x01     /* Device to host */
+#define SCARLETT2_USBPCAP_STAGE_SETUP            0
+#define SCARLETT2_USBPCAP_STAGE_COMPLETE         3
 
-	// step 2
-	private->scarlett2_seq = 1;
-	err = scarlett2_usb(mixer, SCARLETT2_USB_INIT_2, NULL, 0, NULL, 84);
-	if (err < 0)
-		goto error;
+/* Maximum size of the pcap records produced for one ring entry */
+#define SCARLETT2_PCAP_MAX_ENTRY_SIZE \
+	(2 * (sizeof(struct scarlett2_pcap_rec_hdr) + sizeof(struct scarlett2_usbpcap_hdr) + \
+	      sizeof(struct usb_ctrlrequest)) + SCARLETT2_USB_MAX_PACKET)
 
-	err = 0;
+static void scarlett2_pcap_init(struct scarlett2_mixer_data *private)
+{
+	unsigned int count;
 
-error:
-	kfree(buf);
-	return err;
+	if (!scarlett2_pcap_entries)
+		return;
+
+	count = roundup_pow_of_two(min_t(unsigned int, scarlett2_pcap_entries, 65536));
+	private->pcap = vzalloc(sizeof(struct scarlett2_pcap) +
+				count * sizeof(struct scarlett2_pcap_entry));
+	if (!private->pcap)
+		return;
+
+	atomic_set(&private->pcap->head, 0);
+	private->pcap->mask = count - 1;
 }
 
-/* Send a proprietary format request to the Scarlett interface */
-static int scarlett2_usb(
-	struct usb_mixer_interface *mixer, u32 cmd,
-	void *req_data, u16 req_size, void *resp_data, u16 resp_size)
+static void scarlett2_pcap_free(struct scarlett2_mixer_data *private)
 {
-	struct scarlett2_mixer_data *private = mixer->private_data;
-	struct usb_device *dev = mixer->chip->dev;
-	u16 req_buf_size = sizeof(struct scarlett2_usb_packet) + req_size;
-	u16 resp_buf_size = sizeof(struct scarlett2_usb_packet) + resp_size;
-	struct scarlett2_usb_packet *req, *resp = NULL;
-	int err;
+	vfree(private->pcap);
+	private->pcap = NULL;
+}
 
-	req = kmalloc(req_buf_size, GFP_KERNEL);
-	if (!req) {
-		err = -ENOMEM;
-		goto error;
-	}
+/* Store the packet, may be called from any context */
+static void scarlett2_pcap_record(struct scarlett2_mixer_data *private,
+				  u8 dir, const void *buf, int len)
+{
+	struct scarlett2_pcap *pcap = private->pcap;
+	struct scarlett2_pcap_entry *e;
+	u32 idx;
+
+	if ((!pcap) || (len <= 0))
+		return;
+
+	idx = atomic_inc_return(&pcap->head) - 1;
+	e = &pcap->entries[idx & pcap->mask];
+
+	WRITE_ONCE(e->seq, 0);
+	smp_wmb();
+	e->len = min_t(int, len, SCARLETT2_USB_MAX_PACKET);
+	e->dir = dir;
+	e->time_ns = ktime_get_real_ns();
+	memcpy(e->data, buf, e->len);
+	smp_store_release(&e->seq, idx + 1);
+}
 
-	resp = kmalloc(resp_buf_size, GFP_KERNEL);
-	if (!resp) {
-		err = -ENOMEM;
-		goto error;
+/* Append one USBPcap control transfer stage to the pcap image */
+static size_t scarlett2_pcap_put(struct scarlett2_mixer_data *private, u8 *dst,
+				 const struct scarlett2_pcap_entry *e, u32 idx, u8 stage,
+				 const struct usb_ctrlrequest *setup, const void *data, u16 len)
+{
+	struct usb_device *dev = private->mixer->chip->dev;
+	struct scarlett2_pcap_rec_hdr *rec = (void *)dst;
+	struct scarlett2_usbpcap_hdr *hdr = (void *)(rec + 1);
+	u8 *payload = (u8 *)(hdr + 1);
+	u32 rem, size;
+
+	hdr->header_len = cpu_to_le16(sizeof(*hdr));
+	hdr->irp_id = cpu_to_le64(idx);
+	hdr->status = 0;
+	hdr->function = cpu_to_le16(SCARLETT2_USBPCAP_CONTROL_TRANSFER);
+	hdr->info = (stage == SCARLETT2_USBPCAP_STAGE_COMPLETE) ? SCARLETT2_USBPCAP_INFO_PDO_TO_FDO : 0;
+	hdr->bus = cpu_to_le16(dev->bus->busnum);
+	hdr->device = cpu_to_le16(dev->devnum);
+	hdr->endpoint = (e->dir == SCARLETT2_PCAP_RESPONSE) ? USB_DIR_IN : USB_DIR_OUT;
+	hdr->transfer = SCARLETT2_USBPCAP_TRANSFER_CONTROL;
+	hdr->stage = stage;
+
+	if (setup) {
+		memcpy(payload, setup, sizeof(*setup));
+		payload += sizeof(*setup);
 	}
+	if (len)
+		memcpy(payload, data, len);
 
-	mutex_lock(&private->usb_mutex);
+	size = (payload - (u8 *)hdr) + len;
+	hdr->data_length = cpu_to_le32(size - sizeof(*hdr));
 
-	/* build request message and send it */
-	scarlett2_fill_request_header(private, req, cmd, req_size);
+	rec->ts_sec = cpu_to_le32((u32)div_u64_rem(e->time_ns, NSEC_PER_SEC, &rem));
+	rec->ts_usec = cpu_to_le32(rem / NSEC_PER_USEC);
+	rec->incl_len = cpu_to_le32(size);
+	rec->orig_len = cpu_to_le32(size);
 
-	if (req_size)
-		memcpy(req->data, req_data, req_size);
+	return sizeof(*rec) + size;
+}
 
-	err = scarlett2_usb_tx(dev, private->interface, req, req_buf_size);
+/* Convert the captured packets into the pcap image, returns its size */
+static size_t scarlett2_pcap_build(struct scarlett2_mixer_data *private, u8 *dst,
+				   struct scarlett2_pcap_entry *tmp)
+{
+	struct scarlett2_pcap *pcap = private->pcap;
+	struct scarlett2_pcap_file_hdr *fhdr = (void *)dst;
+	struct scarlett2_pcap_entry *e;
+	struct usb_ctrlrequest setup;
+	size_t off = sizeof(*fhdr);
+	u32 head, idx;
+
+	fhdr->magic = cpu_to_le32(0xa1b2c3d4);
+	fhdr->version_major = cpu_to_le16(2);
+	fhdr->version_minor = cpu_to_le16(4);
+	fhdr->thiszone = 0;
+	fhdr->sigfigs = 0;
+	fhdr->snaplen = cpu_to_le32(0xffff);
+	fhdr->network = cpu_to_le32(SCARLETT2_PCAP_LINKTYPE_USBPCAP);
+
+	head = atomic_read(&pcap->head);
+	idx = (head > pcap->mask) ? head - pcap->mask - 1 : 0;
+
+	for ( ; idx != head; ++idx) {
+		/* Take a consistent copy of the entry or skip it */
+		e = &pcap->entries[idx & pcap->mask];
+		if (smp_load_acquire(&e->seq) != idx + 1)
+			continue;
+		memcpy(tmp, e, sizeof(*tmp));
+		smp_rmb();
+		if (READ_ONCE(e->seq) != idx + 1)
+			continue;
 
-	if (err != req_buf_size) {
-		usb_audio_err(
-			mixer->chip,
-			"Scarlett Gen 2 USB request result cmd %x was %d\n",
-			cmd, err);
-		err = -EINVAL;
-		goto unlock;
+		setup.wValue = 0;
+		setup.wIndex = cpu_to_le16(private->interface);
+		setup.wLength = cpu_to_le16(tmp->len);
+
+		if (tmp->dir == SCARLETT2_PCAP_REQUEST) {
+			setup.bRequestType = USB_RECIP_INTERFACE | USB_TYPE_CLASS | USB_DIR_OUT;
+			setup.bRequest = SCARLETT2_USB_CMD_REQ;
+			off += scarlett2_pcap_put(private, &dst[off], tmp, idx,
+						  SCARLETT2_USBPCAP_STAGE_SETUP, &setup, tmp->data, tmp->len);
+			off += scarlett2_pcap_put(private, &dst[off], tmp, idx,
+						  SCARLETT2_USBPCAP_STAGE_COMPLETE, NULL, NULL, 0);
+		} else {
+			setup.bRequestType = USB_RECIP_INTERFACE | USB_TYPE_CLASS | USB_DIR_IN;
+			setup.bRequest = SCARLETT2_USB_CMD_RESP;
+			off += scarlett2_pcap_put(private, &dst[off], tmp, idx,
+						  SCARLETT2_USBPCAP_STAGE_SETUP, &setup, NULL, 0);
+			off += scarlett2_pcap_put(private, &dst[off], tmp, idx,
+						  SCARLETT2_USBPCAP_STAGE_COMPLETE, NULL, tmp->data, tmp->len);
+		}
 	}
 
-	/* send a second message to get the response */
-	err = scarlett2_usb_rx(dev, private->interface, SCARLETT2_USB_CMD_RESP,
-			       resp, resp_buf_size);
+	return off;
+}
 
-	/* validate the response */
-	if (err != resp_buf_size) {
-		usb_audio_err(
-			mixer->chip,
-			"Scarlett Gen 2 USB response result cmd %x was %d expected %d\n",
-			cmd, err, resp_buf_size);
-		err = -EINVAL;
-		goto unlock;
-	}
+/*** Command statistics ***/
 
-	/* cmd/seq/size should match except when initialising
-	 * seq sent = 1, response = 0
-	 */
-	if (resp->cmd != req->cmd ||
-	    (resp->seq != req->seq && (req->seq != 1 || resp->seq != 0)) ||
-	    resp_size != le16_to_cpu(resp->size) ||
-	    resp->error ||
-	    resp->pad) {
-		usb_audio_err(
-			mixer->chip,
-			"Scarlett Gen 2 USB invalid response; "
-			   "cmd tx/rx %d/%d seq %d/%d size %d/%d "
-			   "error %d pad %d\n",
-			le32_to_cpu(req->cmd), le32_to_cpu(resp->cmd),
-			le16_to_cpu(req->seq), le16_to_cpu(resp->seq),
-			resp_size, le16_to_cpu(resp->size),
-			le32_to_cpu(resp->error),
-			le32_to_cpu(resp->pad));
-		err = -EINVAL;
-		goto unlock;
-	}
+/* Latency histogram bucket N counts round trips of [2^(N-1), 2^N) us */
+#define SCARLETT2_LATENCY_BUCKETS                20
 
-	if (resp_data && resp_size > 0)
-		memcpy(resp_data, resp->data, resp_size);
+struct scarlett2_cmd_stats {
+	unsigned long count;                                              /* Number of finished commands */
+	unsigned long bytes_tx;                                           /* Bytes sent including the packet header */
+	unsigned long bytes_rx;                                           /* Bytes received including the packet header */
+	unsigned long errors;                                             /* Number of failed commands */
+	unsigned long latency[SCARLETT2_LATENCY_BUCKETS];                 /* log2 histogram of the transfer latency */
+};
 
-unlock:
-	mutex_unlock(&private->usb_mutex);
-error:
-	kfree(req);
-	kfree(resp);
-	return err;
+/* Account the finished command; called with cmd_lock held */
+static void scarlett2_cmd_stats_account(struct scarlett2_mixer_data *private,
+					struct scarlett2_cmd *cmd, int err, u64 xfer_ns)
+{
+	struct scarlett2_cmd_stats *st;
+
+	if (!private->cmd_stats)
+		return;
+
+	st = &private->cmd_stats[scarlett2_cmd_id(cmd->cmd)];
+	st->count++;
+	st->bytes_tx += sizeof(struct scarlett2_usb_packet) + cmd->req_size;
+	if (err < 0)
+		st->errors++;
+	else
+		st->bytes_rx += sizeof(struct scarlett2_usb_packet) + cmd->resp_size;
+	st->latency[min_t(int, fls64(div_u64(xfer_ns, NSEC_PER_USEC)), SCARLETT2_LATENCY_BUCKETS - 1)]++;
 }
 
-/* Send SCARLETT2_USB_DATA_CMD SCARLETT2_USB_CONFIG_SAVE */
-static void scarlett2_config_save(struct usb_mixer_interface *mixer)
+static void scarlett2_mutex_lock(struct mutex *lock, u64 *locked)
 {
-	__le32 req = cpu_to_le32(SCARLETT2_USB_CONFIG_SAVE);
-
-	scarlett2_usb(mixer, SCARLETT2_USB_DATA_CMD,
-		      &req, sizeof(u32),
-		      NULL, 0);
+	mutex_lock(lock);
+	*locked = ktime_get_ns();
 }
 
-/* Delayed work to save config */
-static void scarlett2_config_save_work(struct work_struct *work)
+static void scarlett2_mutex_unlock(struct mutex *lock, u64 *locked, u64 *max_hold)
 {
-	struct scarlett2_mixer_data *private =
-		container_of(work, struct scarlett2_mixer_data, work.work);
+	u64 held = ktime_get_ns() - *locked;
 
-	scarlett2_config_save(private->mixer);
+	if (held > *max_hold)
+		WRITE_ONCE(*max_hold, held);
+	mutex_unlock(lock);
 }
 
-/* Send a USB message to set a configuration parameter (volume level,
- * sw/hw volume switch, line/inst level switch, pad, or air switch)
+#define scarlett2_usb_lock(private) \
+	scarlett2_mutex_lock(&(private)->usb_mutex, &(private)->usb_mutex_locked)
+#define scarlett2_usb_unlock(private) \
+	scarlett2_mutex_unlock(&(private)->usb_mutex, &(private)->usb_mutex_locked, \
+			       &(private)->usb_mutex_max_hold)
+#define scarlett2_data_lock(private) \
+	scarlett2_mutex_lock(&(private)->data_mutex, &(private)->data_mutex_locked)
+#define scarlett2_data_unlock(private) \
+	scarlett2_mutex_unlock(&(private)->data_mutex, &(private)->data_mutex_locked, \
+			       &(private)->data_mutex_max_hold)
+
+/*** Traffic shaping ***
+ *
+ * The proprietary commands share the bus with the isochronous streams,
+ * so their throughput is limited with a token bucket of bytes. The
+ * tighter scarlett2_rate_limit_pcm budget applies while any PCM stream
+ * of the card is running.
  */
-static int scarlett2_usb_set_config(
-	struct usb_mixer_interface *mixer,
-	int config_item_num, int index, int value)
+
+/* Remember the PCM substreams of the card. The streams are created
+ * before the mixer by the same probe and stay until the card is freed,
+ * so the rate limiter can check them later without walking pcm_list,
+ * which is not protected in the atomic context.
+ */
+static void scarlett2_pcm_init(struct scarlett2_mixer_data *private)
 {
-	struct {
-		__le32 offset;
-		__le32 bytes;
-		__le32 value;
-	} __packed req;
-	__le32 req2;
-	int err;
-	struct scarlett2_mixer_data *private = mixer->private_data;
-	const struct scarlett2_device_info *info = private->info;
-	const struct scarlett2_config *config_item = &info->config[config_item_num];
+	struct snd_usb_stream *as;
+	int i;
 
-	if (config_item->size <= 0) {
-		usb_audio_warn(mixer->chip, "There is no existing config item %d\n", config_item_num);
-		return -EINVAL;
+	list_for_each_entry(as, &private->mixer->chip->pcm_list, list) {
+		for (i = 0; i < 2; ++i) {
+			if (private->num_pcm_subs >= SCARLETT2_PCM_SUBSTREAMS_MAX)
+				return;
+			private->pcm_subs[private->num_pcm_subs++] = &as->substream[i];
+		}
 	}
+}
 
-	/* Cancel any pending NVRAM save */
-	cancel_delayed_work_sync(&private->work);
+/* Check if any PCM stream of the card is running; the streams are
+ * freed before the mixer once the device is gone
+ */
+static bool scarlett2_pcm_running(struct scarlett2_mixer_data *private)
+{
+	int i;
 
-	/* Send the configuration parameter data */
-	req.offset = cpu_to_le32(config_item->offset + index * config_item->size);
-	req.bytes  = cpu_to_le32(config_item->size);
-	req.value  = cpu_to_le32(value);
+	if (atomic_read(&private->mixer->chip->shutdown))
+		return false;
 
-	err = scarlett2_usb(mixer, SCARLETT2_USB_SET_DATA,
-			    &req, sizeof(u32) * 2 + config_item->size,
-			    NULL, 0);
-	if (err < 0)
-		return err;
+	for (i = 0; i < private->num_pcm_subs; ++i)
+		if (private->pcm_subs[i]->running)
+			return true;
 
-	/* Activate the change */
-	if (config_item->activate > 0) {
-		req2 = cpu_to_le32(config_item->activate);
-		err = scarlett2_usb(mixer, SCARLETT2_USB_DATA_CMD,
-			    &req2, sizeof(req2), NULL, 0);
-		if (err < 0)
-			return err;
+	return false;
+}
+
+/* Take tokens for the transfer of cost bytes; if there are not enough,
+ * hold the transfers back until the bucket refills. Called with cmd_lock held.
+ */
+static bool scarlett2_rate_allow(struct scarlett2_mixer_data *private, unsigned int cost)
+{
+	bool pcm = scarlett2_pcm_running(private);
+	unsigned int rate = (pcm) ? scarlett2_rate_limit_pcm : scarlett2_rate_limit;
+	unsigned int burst = max(scarlett2_rate_burst, cost);
+	u64 now = ktime_get_ns();
+	u64 delta = min_t(u64, now - private->rate_last, NSEC_PER_SEC);
+	u64 wait;
+
+	private->rate_last = now;
+	if (!rate) {
+		private->rate_tokens = burst;
+		return true;
 	}
 
-	/* Schedule the change to be written to NVRAM */
-	schedule_delayed_work(&private->work, msecs_to_jiffies(2000));
+	private->rate_tokens = min_t(u64, private->rate_tokens + div_u64(delta * rate, NSEC_PER_SEC), burst);
+	if (private->rate_tokens >= cost) {
+		private->rate_tokens -= cost;
+		return true;
+	}
 
-	return 0;
+	wait = div_u64((u64)(cost - private->rate_tokens) * NSEC_PER_SEC, rate);
+	private->cmd_throttled = 1;
+	private->stat_throttled++;
+	if (pcm)
+		private->stat_throttled_pcm++;
+	private->stat_throttle_ns += wait;
+	mod_timer(&private->cmd_throttle_timer, jiffies + max(1UL, nsecs_to_jiffies(wait)));
+
+	return false;
 }
 
-/* Send a set of USB messages to get configuration data; result placed in *data */
-static int scarlett2_usb_get(
-	struct usb_mixer_interface *mixer,
-	int offset, void *data, int bytes)
+/*** Asynchronous command engine ***
+ *
+ * Each proprietary command is a pair of transfers: the request
+ * (SCARLETT2_USB_CMD_REQ) and the response (SCARLETT2_USB_CMD_RESP).
+ * Commands are built in place in preallocated slots and queued; the
+ * transport walks the queue from its completion callbacks, so the
+ * kcontrol put() callbacks only update the cached state, queue the
+ * transfer and return. Readers queue their command the same way and
+ * sleep until the response arrives. Failures of asynchronous commands
+ * are reported to userspace through the command status control.
+ */
+
+static void scarlett2_cmd_submit_next(struct scarlett2_mixer_data *private);
+
+/* Check that there is nothing queued or being transferred */
+static bool scarlett2_cmd_idle(struct scarlett2_mixer_data *private)
 {
-	struct {
-		__le32 offset;
-		__le32 size;
-	} __packed req;
+	unsigned long flags;
+	bool idle;
 
-	int i, chunk, err;
-	u8 *buf = (u8 *)data;
+	spin_lock_irqsave(&private->cmd_lock, flags);
+	idle = (!private->cmd_active) && list_empty(&private->cmd_queue) &&
+		list_empty(&private->cmd_queue_low);
+	spin_unlock_irqrestore(&private->cmd_lock, flags);
 
-	/* Request the config space with fixed-size data chunks */
-	for (i=0; i<bytes; i += chunk) {
-		/* Compute the chunk size */
-		chunk = (bytes - i);
-		if (chunk > SCARLETT2_SW_CONFIG_PACKET_SIZE)
-			chunk = SCARLETT2_SW_CONFIG_PACKET_SIZE;
+	return idle;
+}
 
-		/* Request yet another chunk */
-		req.offset = cpu_to_le32(offset + i);
-		req.size   = cpu_to_le32(chunk);
+/* Wait until all queued commands have been transferred */
+static void scarlett2_cmd_flush(struct scarlett2_mixer_data *private)
+{
+	wait_event(private->cmd_wait, scarlett2_cmd_idle(private));
+}
 
-		err = scarlett2_usb(mixer, SCARLETT2_USB_GET_DATA, &req, sizeof(req), &buf[i], chunk);
-		if (err < 0)
-			return err;
-	}
+/* Take a free slot; *cmd is NULL if the engine has been shut down */
+static bool scarlett2_cmd_try_alloc(struct scarlett2_mixer_data *private,
+				    struct scarlett2_cmd **cmd)
+{
+	unsigned long flags;
+	bool res = true;
+
+	spin_lock_irqsave(&private->cmd_lock, flags);
+	if (private->cmd_shutdown)
+		*cmd = NULL;
+	else if (!list_empty(&private->cmd_free)) {
+		*cmd = list_first_entry(&private->cmd_free, struct scarlett2_cmd, list);
+		list_del(&(*cmd)->list);
+		(*cmd)->low_prio = 0;
+		(*cmd)->retries = 0;
+	} else
+		res = false;
+	spin_unlock_irqrestore(&private->cmd_lock, flags);
 
-	return 0;
+	return res;
 }
 
-/* Send a set of USB messages to set configuration data */
-static int scarlett2_usb_set(
-	struct usb_mixer_interface *mixer,
-	int offset, const void *data, int bytes)
+/* Allocate the command slot, sleeps while all slots are in use */
+static struct scarlett2_cmd *scarlett2_cmd_alloc(struct scarlett2_mixer_data *private)
 {
-	struct {
-		__le32 offset;
-		__le32 size;
-		u8 data[SCARLETT2_SW_CONFIG_PACKET_SIZE];
-	} __packed req;
-	int i, chunk, err = 0;
-	const u8 *buf = (const u8 *)data;
+	struct scarlett2_cmd *cmd = NULL;
 
-	/* Transfer the configuration with fixed-size data chunks */
-	for (i=0; i<bytes; i += chunk) {
-		/* Compute the chunk size */
-		chunk = (bytes - i);
-		if (chunk > SCARLETT2_SW_CONFIG_PACKET_SIZE)
-			chunk = SCARLETT2_SW_CONFIG_PACKET_SIZE;
+	wait_event(private->cmd_wait, scarlett2_cmd_try_alloc(private, &cmd));
+	return cmd;
+}
+
+/* Return the command slot to the free list */
+static void scarlett2_cmd_release(struct scarlett2_mixer_data *private,
+				  struct scarlett2_cmd *cmd)
+{
+	unsigned long flags;
 
-		/* Send yet another chunk of data */
-		req.offset = cpu_to_le32(offset + i);
-		req.size   = cpu_to_le32(chunk);
-		memcpy(req.data, &buf[i], chunk);
+	spin_lock_irqsave(&private->cmd_lock, flags);
+	list_add(&cmd->list, &private->cmd_free);
+	spin_unlock_irqrestore(&private->cmd_lock, flags);
 
-		err = scarlett2_usb(mixer, SCARLETT2_USB_SET_DATA, &req, chunk + sizeof(__le32)*2, NULL, 0);
-		if (err < 0)
-			return err;
+	wake_up(&private->cmd_wait);
+}
+
+/* Check that a slot can be taken without waiting */
+static bool scarlett2_cmd_slot_ready(struct scarlett2_mixer_data *private)
+{
+	unsigned long flags;
+	bool ready;
+
+	spin_lock_irqsave(&private->cmd_lock, flags);
+	ready = (private->cmd_shutdown) || (!list_empty(&private->cmd_free));
+	spin_unlock_irqrestore(&private->cmd_lock, flags);
+
+	return ready;
+}
+
+/* Queue a DATA_CMD for each pending activation; called with cmd_lock
+ * held, so the activations taken from activate_pending are in the queue
+ * before any other command. The activations left without a free slot
+ * stay pending and false is returned.
+ */
+static bool scarlett2_activate_queue(struct scarlett2_mixer_data *private)
+{
+	struct scarlett2_cmd *cmd;
+	int id;
+
+	/* Nothing can be sent any more */
+	if (private->cmd_shutdown) {
+		private->activate_pending = 0;
+		return true;
 	}
 
-	return err;
+	for (id = 0; private->activate_pending; ++id) {
+		if (!(private->activate_pending & BIT(id)))
+			continue;
+		if (list_empty(&private->cmd_free))
+			return false;
+
+		cmd = list_first_entry(&private->cmd_free, struct scarlett2_cmd, list);
+		list_del(&cmd->list);
+		*(__le32 *)cmd->req->data = cpu_to_le32(id);
+		cmd->cmd = SCARLETT2_USB_DATA_CMD;
+		cmd->req_size = sizeof(__le32);
+		cmd->resp_size = 0;
+		cmd->resp_data = NULL;
+		cmd->done = NULL;
+		cmd->err = 0;
+		cmd->low_prio = 0;
+		cmd->retries = 0;
+		cmd->queue_ns = ktime_get_ns();
+		list_add_tail(&cmd->list, &private->cmd_queue);
+
+		private->activate_pending &= ~BIT(id);
+		private->stat_activate_sent++;
+	}
+
+	return true;
 }
 
-/* Send a USB message to get configuration parameters; result placed in *buf */
-static int scarlett2_usb_get_config(
-	struct usb_mixer_interface *mixer,
-	int config_item_num, int count, void *buf)
+/* Finish the command; called with cmd_lock held */
+static void scarlett2_cmd_finish(struct scarlett2_mixer_data *private,
+				 struct scarlett2_cmd *cmd, int err)
 {
-	struct scarlett2_mixer_data *private = mixer->private_data;
-	const struct scarlett2_device_info *info = private->info;
-	const struct scarlett2_config *config_item = &info->config[config_item_num];
+	cmd->err = err;
 
-	/* No such configuration entry? */
-	if (config_item->size <= 0) {
-		usb_audio_warn(mixer->chip, "Configuration item #%d was not found\n", config_item_num);
-		return -EINVAL;
+	if (cmd->done) {
+		/* The waiter owns the slot and handles the error */
+		complete(cmd->done);
+	} else {
+		if ((err < 0) && (!private->cmd_shutdown)) {
+			private->cmd_errors++;
+			private->cmd_last_error = err;
+			if (private->cmd_status_ctl)
+				snd_ctl_notify(private->mixer->chip->card,
+					       SNDRV_CTL_EVENT_MASK_VALUE,
+					       &private->cmd_status_ctl->id);
+		}
+		list_add(&cmd->list, &private->cmd_free);
 	}
 
-	return scarlett2_usb_get(mixer, config_item->offset, buf, config_item->size * count);
+	wake_up(&private->cmd_wait);
 }
 
-/* Send a USB message to get volume status; result placed in *buf */
-static int scarlett2_usb_get_volume_status(
-	struct usb_mixer_interface *mixer,
-	struct scarlett2_usb_volume_status *buf)
+/* Hold the transfers back for the given delay; called with cmd_lock held */
+static void scarlett2_cmd_backoff(struct scarlett2_mixer_data *private, unsigned int delay)
 {
-	return scarlett2_usb_get(mixer, 0, buf, sizeof(*buf));
+	private->cmd_backoff = 1;
+	mod_timer(&private->cmd_backoff_timer, jiffies + msecs_to_jiffies(delay));
 }
 
-/* Send a USB message to set the volumes for all inputs of one mix
- * (values obtained from private->mix[])
+/* Put the failed command back to the head of its queue if another
+ * attempt may succeed; called with cmd_lock held
  */
-static int scarlett2_usb_set_mix(struct usb_mixer_interface *mixer,
-				     int mix_num)
+static bool scarlett2_cmd_retry(struct scarlett2_mixer_data *private,
+				struct scarlett2_cmd *cmd, int err, int recover)
 {
-	struct scarlett2_mixer_data *private = mixer->private_data;
-	const struct scarlett2_device_info *info = private->info;
+	/* The handshake itself is only repeated by the resynchronisation */
+	if ((recover == SCARLETT2_RECOVER_NONE) ||
+	    (private->cmd_shutdown) ||
+	    (err == -ENODEV) || (err == -ESHUTDOWN) ||
+	    (cmd->retries >= SCARLETT2_CMD_RETRIES) ||
+	    (cmd->cmd == SCARLETT2_USB_INIT_1) || (cmd->cmd == SCARLETT2_USB_INIT_2))
+		return false;
+
+	cmd->retries++;
+	private->stat_cmd_retries++;
+	if ((recover == SCARLETT2_RECOVER_RESYNC) && (!private->resync_step)) {
+		private->resync_step = 1;
+		private->resync_attempts = 0;
+		private->stat_resyncs++;
+	}
 
-	struct {
-		__le16 mix_num;
-		__le16 data[SCARLETT2_INPUT_MIX_MAX + 1]; /* 1 additional output for talkback */
-	} __packed req;
-
-	int i, j;
-	int num_mixer_in = info->ports[SCARLETT2_PORT_TYPE_MIX].num[SCARLETT2_PORT_OUT];
-	int volume;
+	list_add(&cmd->list, (cmd->low_prio) ? &private->cmd_queue_low : &private->cmd_queue);
+	scarlett2_cmd_backoff(private, SCARLETT2_CMD_BACKOFF << (cmd->retries - 1));
 
-	req.mix_num = cpu_to_le16(mix_num);
+	return true;
+}
 
-	for (i = 0, j = mix_num * num_mixer_in; i < num_mixer_in; i++, j++) {
-		volume = (private->mix_mutes[j]) ? 0 : private->mix[j]; /* Apply mute control */
-		req.data[i] = cpu_to_le16(scarlett2_mixer_values[volume]);
+/* Move the resynchronisation on after the handshake command has finished;
+ * called with cmd_lock held
+ */
+static void scarlett2_resync_done(struct scarlett2_mixer_data *private, int err)
+{
+	if (err >= 0) {
+		private->resync_step = (private->resync_step == 1) ? 2 : 0;
+		return;
 	}
 
-	if (info->has_talkback)
-		req.data[num_mixer_in++] = cpu_to_le16(0x2000);
+	if ((!private->cmd_shutdown) && (++private->resync_attempts < SCARLETT2_RESYNC_ATTEMPTS)) {
+		private->resync_step = 1;
+		scarlett2_cmd_backoff(private, SCARLETT2_CMD_BACKOFF << private->resync_attempts);
+		return;
+	}
 
-	return scarlett2_usb(mixer, SCARLETT2_USB_SET_MIX,
-			     &req, num_mixer_in * sizeof(__le16) + sizeof(__le16),
-			     NULL, 0);
+	/* Give up, the queued commands go on with the current state */
+	private->resync_step = 0;
+	private->stat_resync_failed++;
+	usb_audio_err(private->mixer->chip,
+		"Scarlett Gen 2 USB resynchronisation failed: %d\n", err);
 }
 
-/* Send USB messages to get mux inputs */
-static int scarlett2_usb_get_mux(struct usb_mixer_interface *mixer)
+/* Finish the active command or schedule its recovery, then start the
+ * next one; called with cmd_lock held
+ */
+static void scarlett2_cmd_complete(struct scarlett2_mixer_data *private,
+				   int err, int recover)
 {
-	struct scarlett2_mixer_data *private = mixer->private_data;
-	const struct scarlett2_device_info *info = private->info;
-	const struct scarlett2_ports *ports = info->ports;
-	int mux_size, i, src_port, dst_port, err;
-	u32 mux_id;
-	struct {
-		__le16 num;
-		__le16 count;
-	} __packed req;
-
-	__le32 data[SCARLETT2_MUX_MAX];
-
-	mux_size  = info->mux_size[SCARLETT2_PORT_OUT];
-
-	/* Send the request */
-	req.num   = 0;
-	req.count = cpu_to_le16(mux_size);
-	err = scarlett2_usb(mixer, SCARLETT2_USB_GET_MUX, &req, 2 * sizeof(__le16), data, sizeof(__le32) * mux_size);
-	if (err < 0)
-		return err;
-
-	/* Clear mux state */
-	for (i=0 ; i < SCARLETT2_MUX_MAX; ++i)
-		private->mux[i] = 0;
+	struct scarlett2_cmd *cmd = private->cmd_active;
+	struct scarlett2_usb_set_data *data;
+	u64 xfer_ns;
+
+	private->cmd_active = NULL;
+	del_timer(&private->cmd_timer);
+	if (private->cmd_timed_out) {
+		private->cmd_timed_out = 0;
+		if (err < 0)
+			err = -ETIMEDOUT;
+	}
 
-	for (i=0; i<mux_size; ++i) {
-		/* Decode input and output port indexes, remember mux state for the port */
-		mux_id = le32_to_cpu(data[i]);
-		src_port = scarlett2_mux_to_id(ports, SCARLETT2_PORT_IN, mux_id >> 12);
-		dst_port = scarlett2_mux_to_id(ports, SCARLETT2_PORT_OUT, mux_id);
-		if ((dst_port >= 0) && (dst_port < SCARLETT2_MUX_MAX))
-			private->mux[dst_port] = src_port;
+	if (cmd) {
+		xfer_ns = ktime_get_ns() - cmd->submit_ns;
+		trace_scarlett2_cmd_done(cmd->cmd, le16_to_cpu(cmd->req->seq),
+					 cmd->req_size, cmd->resp_size, err,
+					 cmd->submit_ns - cmd->queue_ns, xfer_ns);
+		if (cmd->cmd == SCARLETT2_USB_SET_DATA) {
+			/* The range may have grown by merging, see scarlett2_cmd_merge_set_data */
+			data = (void *)cmd->req->data;
+			trace_scarlett2_usb_set_chunk(le16_to_cpu(cmd->req->seq), le32_to_cpu(data->offset),
+						      le32_to_cpu(data->size), err,
+						      cmd->submit_ns - cmd->queue_ns, xfer_ns);
+		}
+		scarlett2_cmd_stats_account(private, cmd, err, xfer_ns);
+		if (cmd == &private->resync_cmd)
+			scarlett2_resync_done(private, err);
+		else if ((err >= 0) || (!scarlett2_cmd_retry(private, cmd, err, recover)))
+			scarlett2_cmd_finish(private, cmd, err);
 	}
 
-	return err;
+	scarlett2_cmd_submit_next(private);
 }
 
-/* Send USB messages to set mux inputs */
-static int scarlett2_usb_set_mux(struct usb_mixer_interface *mixer)
+/* Called by the transport when the response of the active command has
+ * been received into private->cmd_resp or the transfer has failed
+ */
+static void scarlett2_cmd_xfer_done(struct scarlett2_mixer_data *private,
+				    int err, int length)
 {
-	struct scarlett2_mixer_data *private = mixer->private_data;
-	const struct scarlett2_device_info *info = private->info;
-	const struct scarlett2_ports *ports = info->ports;
-	int direction, conn_id, order, port, port_idx, err = 0;
-	int mute_idx;
-	u32 src_mux, dst_mux;
+	struct snd_usb_audio *chip = private->mixer->chip;
+	struct scarlett2_usb_packet *resp = private->cmd_resp;
+	struct scarlett2_cmd *cmd;
+	struct scarlett2_usb_packet *req;
+	int recover = SCARLETT2_RECOVER_RETRY;
+	unsigned long flags;
 
-	static const int assignment_order[] = {
-		SCARLETT2_PORT_TYPE_PCM,
-		SCARLETT2_PORT_TYPE_ANALOGUE,
-		SCARLETT2_PORT_TYPE_SPDIF,
-		SCARLETT2_PORT_TYPE_ADAT,
-		SCARLETT2_PORT_TYPE_MIX,
-		SCARLETT2_PORT_TYPE_TALKBACK
-	};
+	spin_lock_irqsave(&private->cmd_lock, flags);
 
-	struct {
-		__le16 pad;
-		__le16 num;
-		__le32 data[SCARLETT2_MUX_MAX];
-	} __packed req;
+	cmd = private->cmd_active;
+	if (!cmd)
+		goto unlock;
+	req = cmd->req;
 
-	/* Sync mutes if required */
-	scarlett2_update_volumes(mixer);
+	if (err >= 0)
+		scarlett2_pcap_record(private, SCARLETT2_PCAP_RESPONSE, resp,
+				      min_t(int, length, SCARLETT2_USB_MAX_PACKET));
 
-	/* mux settings for each rate */
-	for (direction = SCARLETT2_PORT_OUT_44; direction <= SCARLETT2_PORT_OUT_176; ++direction) {
-		/* init request */
-		req.pad = 0;
-		req.num = cpu_to_le16(direction - SCARLETT2_PORT_OUT_44);
+	/* validate the response */
+	if (err < 0) {
+		if (!private->cmd_shutdown)
+			usb_audio_err(chip,
+				"Scarlett Gen 2 USB request result cmd %x was %d\n",
+				cmd->cmd, err);
+	} else if (length != sizeof(struct scarlett2_usb_packet) + cmd->resp_size) {
+		usb_audio_err(chip,
+			"Scarlett Gen 2 USB response result cmd %x was %d expected %d\n",
+			cmd->cmd, length,
+			(int)(sizeof(struct scarlett2_usb_packet) + cmd->resp_size));
+		err = -EINVAL;
+		/* Only the response to another request calls for the
+		 * resynchronisation; a short answer to this one, like the
+		 * reply to an oversized GET_DATA, is not worth repeating and
+		 * a truncated header is retried
+		 */
+		if (length < sizeof(struct scarlett2_usb_packet))
+			recover = SCARLETT2_RECOVER_RETRY;
+		else if (resp->cmd != req->cmd ||
+			 (resp->seq != req->seq && (req->seq != 1 || resp->seq != 0)))
+			recover = SCARLETT2_RECOVER_RESYNC;
+		else
+			recover = SCARLETT2_RECOVER_NONE;
+	}
+	/* cmd/seq/size should match except when initialising
+	 * seq sent = 1, response = 0
+	 */
+	else if (resp->cmd != req->cmd ||
+	    (resp->seq != req->seq && (req->seq != 1 || resp->seq != 0)) ||
+	    cmd->resp_size != le16_to_cpu(resp->size) ||
+	    resp->error ||
+	    resp->pad) {
+		usb_audio_err(chip,
+			"Scarlett Gen 2 USB invalid response; "
+			   "cmd tx/rx %d/%d seq %d/%d size %d/%d "
+			   "error %d pad %d\n",
+			le32_to_cpu(req->cmd), le32_to_cpu(resp->cmd),
+			le16_to_cpu(req->seq), le16_to_cpu(resp->seq),
+			cmd->resp_size, le16_to_cpu(resp->size),
+			le32_to_cpu(resp->error),
+			le32_to_cpu(resp->pad));
+		err = -EINVAL;
+		/* The device may have lost track of the sequence, otherwise
+		 * it has rejected the request and there is no point to retry
+		 */
+		recover = (resp->cmd != req->cmd || resp->seq != req->seq) ?
+			SCARLETT2_RECOVER_RESYNC : SCARLETT2_RECOVER_NONE;
+	} else if ((cmd->resp_data) && (cmd->resp_size > 0))
+		memcpy(cmd->resp_data, resp->data, cmd->resp_size);
 
-		/* form the request data */
-		conn_id = 0;
-		for (order = 0; order < sizeof(assignment_order)/sizeof(int); ++order) {
-			int port_type = assignment_order[order];
+	scarlett2_cmd_complete(private, err, recover);
 
-			for (port = 0; port < ports[port_type].num[direction]; ++port) {
-				port_idx = scarlett2_get_port_num(ports, SCARLETT2_PORT_OUT, port_type, port);
+unlock:
+	spin_unlock_irqrestore(&private->cmd_lock, flags);
+}
 
-				/* Lower 12 bits for destination, next 12 bits for source */
-				mute_idx= scarlett2_output_index(mixer, port_type, port);
-				src_mux = ((mute_idx >= 0) && (private->mutes[mute_idx])) ? 0 :
-				          scarlett2_id_to_mux(ports, SCARLETT2_PORT_IN, private->mux[port_idx]);
-				dst_mux = scarlett2_id_to_mux(ports, SCARLETT2_PORT_OUT, port_idx);
+/* Start the transfer of the next queued command, polls go last;
+ * called with cmd_lock held
+ */
+static void scarlett2_cmd_submit_next(struct scarlett2_mixer_data *private)
+{
+	struct scarlett2_cmd *cmd;
+	int err;
 
-				req.data[conn_id++] = cpu_to_le32((src_mux << 12) | dst_mux);
+	while ((!private->cmd_active) && (!private->cmd_backoff) && (!private->cmd_throttled) &&
+	       (!private->cmd_cancelling)) {
+		/* Redo the handshake before anything else; the device keeps its state */
+		if ((private->resync_step) && (!private->cmd_shutdown)) {
+			cmd = &private->resync_cmd;
+			cmd->cmd = (private->resync_step == 1) ? SCARLETT2_USB_INIT_1 : SCARLETT2_USB_INIT_2;
+			cmd->req_size = 0;
+			cmd->resp_size = (private->resync_step == 1) ? 0 : 84;
+			cmd->resp_data = NULL;
+			cmd->done = NULL;
+			cmd->queue_ns = ktime_get_ns();
+			private->scarlett2_seq = 1;
+			scarlett2_fill_request_header(private, cmd->req, cmd->cmd, 0);
+			scarlett2_pcap_record(private, SCARLETT2_PCAP_REQUEST, cmd->req,
+					      sizeof(struct scarlett2_usb_packet));
+
+			private->cmd_active = cmd;
+			cmd->submit_ns = ktime_get_ns();
+			err = private->transport->submit(private, cmd);
+			if (err < 0) {
+				private->cmd_active = NULL;
+				scarlett2_resync_done(private, err);
+				continue;
 			}
+
+			private->stat_cmd_sent++;
+			private->cmd_deadline = jiffies + msecs_to_jiffies(SCARLETT2_CMD_TIMEOUT);
+			mod_timer(&private->cmd_timer, private->cmd_deadline);
+			break;
 		}
 
-		/* Fill rest mux data with zeros */
-		for ( ; conn_id < info->mux_size[direction]; ++conn_id)
-			req.data[conn_id] = 0;
+		if (!list_empty(&private->cmd_queue))
+			cmd = list_first_entry(&private->cmd_queue, struct scarlett2_cmd, list);
+		else if (!list_empty(&private->cmd_queue_low))
+			cmd = list_first_entry(&private->cmd_queue_low, struct scarlett2_cmd, list);
+		else
+			break;
 
-		/* Send the SET_MUX notification */
-		err = scarlett2_usb(mixer, SCARLETT2_USB_SET_MUX,
-				    &req, 2 * sizeof(__le16) + conn_id * sizeof(__le32),
-				    NULL, 0);
-		if (err < 0)
-			return err;
-	}
+		if ((!private->cmd_shutdown) &&
+		    (!scarlett2_rate_allow(private, 2 * sizeof(struct scarlett2_usb_packet) +
+					   cmd->req_size + cmd->resp_size)))
+			break;
+		list_del(&cmd->list);
 
-	return err;
+		if (private->cmd_shutdown) {
+			scarlett2_cmd_finish(private, cmd, -ENODEV);
+			continue;
+		}
+
+		/* sequence numbers are assigned in the order of transmission */
+		scarlett2_fill_request_header(private, cmd->req, cmd->cmd, cmd->req_size);
+		scarlett2_pcap_record(private, SCARLETT2_PCAP_REQUEST, cmd->req,
+				      sizeof(struct scarlett2_usb_packet) + cmd->req_size);
+
+		private->cmd_active = cmd;
+		cmd->submit_ns = ktime_get_ns();
+		err = private->transport->submit(private, cmd);
+		if (err < 0) {
+			private->cmd_active = NULL;
+			scarlett2_cmd_finish(private, cmd, err);
+			continue;
+		}
+
+		private->stat_cmd_sent++;
+		private->cmd_deadline = jiffies + msecs_to_jiffies(SCARLETT2_CMD_TIMEOUT);
+		mod_timer(&private->cmd_timer, private->cmd_deadline);
+	}
 }
 
-/* Send USB message to get meter levels */
-static int scarlett2_usb_get_meter_levels(struct usb_mixer_interface *mixer,
-					  u16 *levels)
+/* Cancel the transfer which takes too long; the transport then
+ * finishes the command and moves on to the next one. The timer may
+ * fire for a transfer which has just finished, the deadline tells if
+ * the active one is late. The cancellation can not be requested under
+ * cmd_lock since the transport may complete the transfer at once, so
+ * no other transfer is started until it returns.
+ */
+static void scarlett2_cmd_timeout(struct timer_list *t)
 {
-	struct {
-		__le16 pad;
-		__le16 num_meters;
-		__le32 magic;
-	} __packed req;
-	u32 resp[SCARLETT2_NUM_METERS];
-	int i, err;
+	struct scarlett2_mixer_data *private = from_timer(private, t, cmd_timer);
+	unsigned long flags;
+	bool cancel = false;
+
+	spin_lock_irqsave(&private->cmd_lock, flags);
+	if ((private->cmd_active) && (!private->cmd_cancelling) &&
+	    (!time_before(jiffies, private->cmd_deadline))) {
+		private->cmd_timed_out = 1;
+		private->cmd_cancelling = 1;
+		cancel = true;
+	}
+	spin_unlock_irqrestore(&private->cmd_lock, flags);
 
-	req.pad = 0;
-	req.num_meters = cpu_to_le16(SCARLETT2_NUM_METERS);
-	req.magic = cpu_to_le32(SCARLETT2_USB_METER_LEVELS_GET_MAGIC);
-	err = scarlett2_usb(mixer, SCARLETT2_USB_GET_METER_LEVELS,
-			    &req, sizeof(req), resp, sizeof(resp));
-	if (err < 0)
-		return err;
+	if (!cancel)
+		return;
 
-	/* copy, convert to u16 */
-	for (i = 0; i < SCARLETT2_NUM_METERS; i++)
-		levels[i] = resp[i];
+	private->transport->cancel(private);
 
-	return 0;
+	spin_lock_irqsave(&private->cmd_lock, flags);
+	private->cmd_cancelling = 0;
+	scarlett2_cmd_submit_next(private);
+	spin_unlock_irqrestore(&private->cmd_lock, flags);
 }
 
-/*** Control Functions ***/
-static int scarlett2_bool_enum_ctl_info(struct snd_kcontrol *kctl,
-					 struct snd_ctl_elem_info *uinfo)
+/* The rate limiter has enough tokens again, continue the transfers */
+static void scarlett2_cmd_throttle_end(struct timer_list *t)
 {
-	static const char *const values[2] = {
-		"Off", "On"
-	};
+	struct scarlett2_mixer_data *private = from_timer(private, t, cmd_throttle_timer);
+	unsigned long flags;
 
-	return snd_ctl_enum_info(uinfo, 1, 2, values);
+	spin_lock_irqsave(&private->cmd_lock, flags);
+	private->cmd_throttled = 0;
+	scarlett2_cmd_submit_next(private);
+	spin_unlock_irqrestore(&private->cmd_lock, flags);
 }
 
-/* helper function to create a new control */
-static int scarlett2_add_new_ctl(struct usb_mixer_interface *mixer,
-				 const struct snd_kcontrol_new *ncontrol,
-				 int index, int channels, const char *name,
-				 struct snd_kcontrol **kctl_return)
+/* The retry delay has passed, continue the transfers */
+static void scarlett2_cmd_backoff_end(struct timer_list *t)
 {
-	struct snd_kcontrol *kctl;
-	struct usb_mixer_elem_info *elem;
-	int err;
+	struct scarlett2_mixer_data *private = from_timer(private, t, cmd_backoff_timer);
+	unsigned long flags;
 
-	elem = kzalloc(sizeof(*elem), GFP_KERNEL);
-	if (!elem)
-		return -ENOMEM;
+	spin_lock_irqsave(&private->cmd_lock, flags);
+	private->cmd_backoff = 0;
+	scarlett2_cmd_submit_next(private);
+	spin_unlock_irqrestore(&private->cmd_lock, flags);
+}
 
-	elem->head.mixer = mixer;
-	elem->control = index;
-	elem->head.id = index;
-	elem->channels = channels;
+/* Merge the SET_DATA command into the nearest pending SET_DATA command
+ * which is not being transferred yet if their ranges touch or overlap;
+ * only activations may lie between them. Called with cmd_lock held.
+ */
+static bool scarlett2_cmd_merge_set_data(struct scarlett2_mixer_data *private,
+					 struct scarlett2_cmd *cmd)
+{
+	struct scarlett2_usb_set_data *src = (void *)cmd->req->data;
+	struct scarlett2_usb_set_data *dst;
+	struct scarlett2_cmd *prev;
+	u32 src_off, src_end, dst_off, dst_end, off, end;
+
+	src_off = le32_to_cpu(src->offset);
+	src_end = src_off + le32_to_cpu(src->size);
+
+	list_for_each_entry_reverse(prev, &private->cmd_queue, list) {
+		/* Step over activations but never move data across the NVRAM save */
+		if (prev->cmd == SCARLETT2_USB_DATA_CMD) {
+			if (le32_to_cpu(*(__le32 *)prev->req->data) == SCARLETT2_USB_CONFIG_SAVE)
+				return false;
+			continue;
+		}
 
-	kctl = snd_ctl_new1(ncontrol, elem);
-	if (!kctl) {
-		kfree(elem);
-		return -ENOMEM;
+		if ((prev->cmd != SCARLETT2_USB_SET_DATA) || (prev->done))
+			return false;
+
+		dst = (void *)prev->req->data;
+		dst_off = le32_to_cpu(dst->offset);
+		dst_end = dst_off + le32_to_cpu(dst->size);
+		if ((src_off > dst_end) || (dst_off > src_end))
+			return false;
+
+		off = min(src_off, dst_off);
+		end = max(src_end, dst_end);
+		if ((end - off) > SCARLETT2_SW_CONFIG_PACKET_SIZE)
+			return false;
+
+		/* Newer data overrides the older one */
+		if (dst_off > off)
+			memmove(&dst->data[dst_off - off], dst->data, dst_end - dst_off);
+		memcpy(&dst->data[src_off - off], src->data, src_end - src_off);
+		dst->offset = cpu_to_le32(off);
+		dst->size = cpu_to_le32(end - off);
+		prev->req_size = sizeof(struct scarlett2_usb_set_data) + end - off;
+
+		private->stat_set_data_merged++;
+		private->stat_set_data_merged_bytes += src_end - src_off;
+		return true;
 	}
-	kctl->private_free = snd_usb_mixer_elem_free;
-
-	strlcpy(kctl->id.name, name, sizeof(kctl->id.name));
-
-	err = snd_usb_mixer_add_control(&elem->head, kctl);
-	if (err < 0)
-		return err;
-
-	if (kctl_return)
-		*kctl_return = kctl;
 
-	return 0;
+	return false;
 }
 
-/*** Analogue Line Out Volume Controls ***/
+static void scarlett2_activate_flush(struct usb_mixer_interface *mixer);
 
-/* Update hardware volume controls after receiving notification that
- * they have changed
- */
-static int scarlett2_update_volumes(struct usb_mixer_interface *mixer)
+/* Put the command built in place into the queue */
+static int scarlett2_cmd_queue(
+	struct usb_mixer_interface *mixer, struct scarlett2_cmd *cmd,
+	u32 code, u16 req_size, void *resp_data, u16 resp_size,
+	struct completion *done)
 {
 	struct scarlett2_mixer_data *private = mixer->private_data;
-	const struct scarlett2_device_info *info = private->info;
-	struct scarlett2_usb_volume_status volume_status;
-
-	int num_line_out  = info->ports[SCARLETT2_PORT_TYPE_ANALOGUE].num[SCARLETT2_PORT_OUT];
-	int err, i;
-	s16 volume;
+	unsigned long flags;
 
-	/* Check feature support */
-	if (!info->has_hw_volume) {
-		private->vol_updated = 0;
-		return 0;
+	if ((req_size > SCARLETT2_USB_MAX_PAYLOAD) || (resp_size > SCARLETT2_USB_MAX_PAYLOAD)) {
+		usb_audio_err(
+			mixer->chip,
+			"Scarlett Gen 2 USB request cmd %x too large: %d/%d\n",
+			code, req_size, resp_size);
+		scarlett2_cmd_release(private, cmd);
+		return -EINVAL;
 	}
 
-	/* Check re-entrance */
-	if (!private->vol_updated)
-		return 0;
+	/* Routing and mixer changes should see the activated configuration */
+	if ((code == SCARLETT2_USB_SET_MIX) || (code == SCARLETT2_USB_SET_MUX))
+		scarlett2_activate_flush(mixer);
 
-	/* Obtain actual volume status */
-	err = scarlett2_usb_get_volume_status(mixer, &volume_status);
-	if (err < 0)
-		return err;
+	cmd->cmd = code;
+	cmd->req_size = req_size;
+	cmd->resp_size = resp_size;
+	cmd->resp_data = resp_data;
+	cmd->done = done;
+	cmd->err = 0;
+	cmd->queue_ns = ktime_get_ns();
 
-	private->master_vol = clamp(
-		volume_status.master_vol + SCARLETT2_VOLUME_BIAS,
-		0, SCARLETT2_VOLUME_BIAS);
+	spin_lock_irqsave(&private->cmd_lock, flags);
 
-	/** Update volume settings for each analogue output */
-	for (i = 0; i < num_line_out; i++) {
-		/* Update software/hardware switch status */
-		private->vol_sw_hw_switch[i] = info->line_out_hw_vol && volume_status.sw_hw_switch[i];
-		private->mutes[i] = !! volume_status.mute[i];
+	if (code == SCARLETT2_USB_SET_DATA)
+		private->stat_set_data++;
 
-		/* If volume is software-controlled, try to read it's value from software configuration */
-		if (private->vol_sw_hw_switch[i]) {
-			/* Reset to master volume */
-			private->vol[i] = private->master_vol;
-		}
-		else if (private->sw_cfg) {
-			/* Read volume from software config */
-			volume = le16_to_cpu(private->sw_cfg->volume[i].volume);
-			private->vol[i] = clamp(volume + SCARLETT2_VOLUME_BIAS, 0, SCARLETT2_VOLUME_BIAS);
-		}
-		else {
-			/* Read volume from device volume status */
-			volume = le16_to_cpu(volume_status.sw_vol[i]);
-			private->vol[i] = clamp(volume + SCARLETT2_VOLUME_BIAS, 0, SCARLETT2_VOLUME_BIAS);
-		}
+	/* Asynchronous writes may be combined with the pending ones */
+	if ((code == SCARLETT2_USB_SET_DATA) && (!done) &&
+	    (scarlett2_cmd_merge_set_data(private, cmd))) {
+		list_add(&cmd->list, &private->cmd_free);
+		wake_up(&private->cmd_wait);
+	} else {
+		list_add_tail(&cmd->list, (cmd->low_prio) ? &private->cmd_queue_low : &private->cmd_queue);
+		scarlett2_cmd_submit_next(private);
 	}
 
-	/* Update Mute/Dim hardware buttons */
-	for (i = 0; i < private->info->button_count; i++)
-		private->buttons[i] = !!volume_status.buttons[i];
+	spin_unlock_irqrestore(&private->cmd_lock, flags);
 
-	/* Reset flag AFTER the data has been received */
-	private->vol_updated = 0;
 	return 0;
 }
 
-static int scarlett2_volume_ctl_info(struct snd_kcontrol *kctl,
-				     struct snd_ctl_elem_info *uinfo)
+/* Queue the command built in place and return immediately */
+static int scarlett2_usb_send(
+	struct usb_mixer_interface *mixer, struct scarlett2_cmd *cmd,
+	u32 code, u16 req_size)
 {
-	struct usb_mixer_elem_info *elem = kctl->private_data;
-
-	uinfo->type = SNDRV_CTL_ELEM_TYPE_INTEGER;
-	uinfo->count = elem->channels;
-	uinfo->value.integer.min = 0;
-	uinfo->value.integer.max = SCARLETT2_VOLUME_BIAS;
-	uinfo->value.integer.step = 1;
-	return 0;
+	return scarlett2_cmd_queue(mixer, cmd, code, req_size, NULL, 0, NULL);
 }
 
-static int scarlett2_master_volume_ctl_get(struct snd_kcontrol *kctl,
-					   struct snd_ctl_elem_value *ucontrol)
+/* Queue the command built in place and wait for the response; the
+ * slot stays with the caller unless the command could not be queued
+ */
+static int scarlett2_usb_wait(
+	struct usb_mixer_interface *mixer, struct scarlett2_cmd *cmd,
+	u32 code, u16 req_size, void *resp_data, u16 resp_size, bool *queued)
 {
-	struct usb_mixer_elem_info *elem = kctl->private_data;
-	struct usb_mixer_interface *mixer = elem->head.mixer;
-	struct scarlett2_mixer_data *private = mixer->private_data;
+	DECLARE_COMPLETION_ONSTACK(done);
+	int err;
 
-	if (private->vol_updated) {
-		mutex_lock(&private->data_mutex);
-		scarlett2_update_volumes(mixer);
-		mutex_unlock(&private->data_mutex);
-	}
+	err = scarlett2_cmd_queue(mixer, cmd, code, req_size, resp_data, resp_size, &done);
+	*queued = (err >= 0);
+	if (err < 0)
+		return err;
 
-	ucontrol->value.integer.value[0] = private->master_vol;
-	return 0;
+	wait_for_completion(&done);
+	return cmd->err;
 }
 
-static int scarlett2_volume_ctl_get(struct snd_kcontrol *kctl,
-				    struct snd_ctl_elem_value *ucontrol)
+/* Queue the command built in place and wait for the response */
+static int scarlett2_usb_exec(
+	struct usb_mixer_interface *mixer, struct scarlett2_cmd *cmd,
+	u32 code, u16 req_size, void *resp_data, u16 resp_size)
 {
-	struct usb_mixer_elem_info *elem = kctl->private_data;
-	struct usb_mixer_interface *mixer = elem->head.mixer;
 	struct scarlett2_mixer_data *private = mixer->private_data;
-	int index = elem->control;
+	bool queued;
+	int err;
 
-	if (private->vol_updated) {
-		mutex_lock(&private->data_mutex);
-		scarlett2_update_volumes(mixer);
-		mutex_unlock(&private->data_mutex);
-	}
+	err = scarlett2_usb_wait(mixer, cmd, code, req_size, resp_data, resp_size, &queued);
+	if (queued)
+		scarlett2_cmd_release(private, cmd);
 
-	ucontrol->value.integer.value[0] = private->vol[index];
-	return 0;
+	return err;
 }
 
-static int scarlett2_volume_ctl_put(struct snd_kcontrol *kctl,
-				    struct snd_ctl_elem_value *ucontrol)
+/*** USB transport ***/
+
+static int scarlett2_usb_transport_init(struct scarlett2_mixer_data *private)
 {
-	struct usb_mixer_elem_info *elem = kctl->private_data;
-	struct usb_mixer_interface *mixer = elem->head.mixer;
-	struct scarlett2_mixer_data *private = mixer->private_data;
-	struct scarlett2_sw_cfg_volume *sw_vol;
-	int index = elem->control;
-	int oval, val, err = 0;
-	u16 volume;
+	struct usb_device *dev = private->mixer->chip->dev;
 
-	mutex_lock(&private->data_mutex);
-	scarlett2_update_volumes(mixer);
+	if (snd_usb_pipe_sanity_check(dev, usb_sndctrlpipe(dev, 0)))
+		return -EINVAL;
 
-	oval = private->vol[index];
-	val = ucontrol->value.integer.value[0];
+	private->cmd_urb = usb_alloc_urb(0, GFP_KERNEL);
+	private->cmd_setup = kmalloc(sizeof(struct usb_ctrlrequest), GFP_KERNEL);
+	if ((!private->cmd_urb) || (!private->cmd_setup))
+		return -ENOMEM;
 
-	if (oval == val)
-		goto unlock;
+	return 0;
+}
 
-	private->vol[index] = val;
+static void scarlett2_usb_transport_free(struct scarlett2_mixer_data *private)
+{
+	if (private->cmd_urb) {
+		usb_kill_urb(private->cmd_urb);
+		usb_free_urb(private->cmd_urb);
+		private->cmd_urb = NULL;
+	}
+	kfree(private->cmd_setup);
+	private->cmd_setup = NULL;
+}
 
-	/* Update volume for the output */
-	err = scarlett2_usb_set_config(mixer, SCARLETT2_CONFIG_LINE_OUT_VOLUME,
-				       index, val - SCARLETT2_VOLUME_BIAS);
-	if (err != 0)
-		goto unlock;
+static int scarlett2_usb_transport_tx(struct scarlett2_mixer_data *private,
+				      u8 request, void *buf, u16 size)
+{
+	struct usb_device *dev = private->mixer->chip->dev;
 
-	/* Update software configuration if possible */
-	if ((private->sw_cfg) && (!private->vol_sw_hw_switch[index])) {
-		volume = val - SCARLETT2_VOLUME_BIAS;
-		sw_vol = &private->sw_cfg->volume[index];
-		sw_vol->volume  = cpu_to_le16(volume);
-		sw_vol->changed = 1;
+	return snd_usb_ctl_msg(dev, usb_sndctrlpipe(dev, 0),
+			request,
+			USB_RECIP_INTERFACE | USB_TYPE_CLASS | USB_DIR_OUT,
+			0, private->interface, buf, size);
+}
 
-		err = scarlett2_commit_software_config(mixer, sw_vol, sizeof(struct scarlett2_sw_cfg_volume));
-		if (err < 0)
-			goto unlock;
-	}
-	if (err == 0)
-		err = 1;
+static int scarlett2_usb_transport_rx(struct scarlett2_mixer_data *private,
+				      u8 request, void *buf, u16 size)
+{
+	struct usb_device *dev = private->mixer->chip->dev;
 
-unlock:
-	mutex_unlock(&private->data_mutex);
-	return err;
+	return snd_usb_ctl_msg(dev, usb_sndctrlpipe(dev, 0),
+			request,
+			USB_RECIP_INTERFACE | USB_TYPE_CLASS | USB_DIR_IN,
+			0, private->interface, buf, size);
 }
 
-static const DECLARE_TLV_DB_MINMAX(
-	db_scale_scarlett2_gain, -SCARLETT2_VOLUME_BIAS * 100, 0
-);
-
-static const struct snd_kcontrol_new scarlett2_master_volume_ctl = {
-	.iface = SNDRV_CTL_ELEM_IFACE_MIXER,
-	.access = SNDRV_CTL_ELEM_ACCESS_READ |
-		  SNDRV_CTL_ELEM_ACCESS_TLV_READ,
-	.name = "",
-	.info = scarlett2_volume_ctl_info,
-	.get  = scarlett2_master_volume_ctl_get,
-	.private_value = 0, /* max value */
-	.tlv = { .p = db_scale_scarlett2_gain }
-};
+/* Set up the control URB for one stage of the command */
+static void scarlett2_usb_transport_fill_urb(struct scarlett2_mixer_data *private,
+					     unsigned int pipe, u8 request, u8 dir,
+					     void *buf, u16 size, usb_complete_t complete_fn)
+{
+	struct usb_ctrlrequest *setup = private->cmd_setup;
 
-static const struct snd_kcontrol_new scarlett2_line_out_volume_ctl = {
-	.iface = SNDRV_CTL_ELEM_IFACE_MIXER,
-	.access = SNDRV_CTL_ELEM_ACCESS_READWRITE |
-		  SNDRV_CTL_ELEM_ACCESS_TLV_READ,
-	.name = "",
-	.info = scarlett2_volume_ctl_info,
-	.get  = scarlett2_volume_ctl_get,
-	.put  = scarlett2_volume_ctl_put,
-	.private_value = 0, /* max value */
-	.tlv = { .p = db_scale_scarlett2_gain }
-};
+	setup->bRequestType = USB_RECIP_INTERFACE | USB_TYPE_CLASS | dir;
+	setup->bRequest = request;
+	setup->wValue = 0;
+	setup->wIndex = cpu_to_le16(private->interface);
+	setup->wLength = cpu_to_le16(size);
 
-/*** HW/SW Volume Switch Controls ***/
+	usb_fill_control_urb(private->cmd_urb, private->mixer->chip->dev, pipe,
+			     (unsigned char *)setup, buf, size, complete_fn, private);
+}
 
-static int scarlett2_sw_hw_enum_ctl_info(struct snd_kcontrol *kctl,
-					 struct snd_ctl_elem_info *uinfo)
+/* The response has been received */
+static void scarlett2_usb_transport_rx_complete(struct urb *urb)
 {
-	static const char *const values[2] = {
-		"SW", "HW"
-	};
+	struct scarlett2_mixer_data *private = urb->context;
 
-	return snd_ctl_enum_info(uinfo, 1, 2, values);
+	scarlett2_cmd_xfer_done(private, urb->status, urb->actual_length);
 }
 
-static int scarlett2_sw_hw_enum_ctl_get(struct snd_kcontrol *kctl,
-					struct snd_ctl_elem_value *ucontrol)
+/* The request has been sent, ask for the response */
+static void scarlett2_usb_transport_tx_complete(struct urb *urb)
 {
-	struct usb_mixer_elem_info *elem = kctl->private_data;
-	struct scarlett2_mixer_data *private = elem->head.mixer->private_data;
+	struct scarlett2_mixer_data *private = urb->context;
+	struct usb_device *dev = private->mixer->chip->dev;
+	struct scarlett2_cmd *cmd;
+	unsigned long flags;
+	int err = urb->status;
+
+	if ((err == 0) && (urb->actual_length != urb->transfer_buffer_length))
+		err = -EPROTO;
+
+	if (err == 0) {
+		spin_lock_irqsave(&private->cmd_lock, flags);
+		cmd = private->cmd_active;
+		if (cmd) {
+			/* send a second message to get the response */
+			scarlett2_usb_transport_fill_urb(private, usb_rcvctrlpipe(dev, 0),
+					SCARLETT2_USB_CMD_RESP, USB_DIR_IN,
+					private->cmd_resp,
+					sizeof(struct scarlett2_usb_packet) + cmd->resp_size,
+					scarlett2_usb_transport_rx_complete);
+			err = usb_submit_urb(urb, GFP_ATOMIC);
+		}
+		spin_unlock_irqrestore(&private->cmd_lock, flags);
+		if (err == 0)
+			return;
+	}
 
-	ucontrol->value.enumerated.item[0] = private->vol_sw_hw_switch[elem->control];
-	return 0;
+	scarlett2_cmd_xfer_done(private, err, 0);
 }
 
-static int scarlett2_sw_hw_enum_ctl_put(struct snd_kcontrol *kctl,
-					struct snd_ctl_elem_value *ucontrol)
+static int scarlett2_usb_transport_submit(struct scarlett2_mixer_data *private,
+					  struct scarlett2_cmd *cmd)
 {
-	struct usb_mixer_elem_info *elem = kctl->private_data;
-	struct usb_mixer_interface *mixer = elem->head.mixer;
-	struct scarlett2_mixer_data *private = mixer->private_data;
+	struct usb_device *dev = private->mixer->chip->dev;
 
-	int index = elem->control;
-	int oval, val, err = 0;
-	s16 volume;
+	scarlett2_usb_transport_fill_urb(private, usb_sndctrlpipe(dev, 0),
+			SCARLETT2_USB_CMD_REQ, USB_DIR_OUT,
+			cmd->req,
+			sizeof(struct scarlett2_usb_packet) + cmd->req_size,
+			scarlett2_usb_transport_tx_complete);
 
-	mutex_lock(&private->data_mutex);
-	scarlett2_update_volumes(mixer);
+	return usb_submit_urb(private->cmd_urb, GFP_ATOMIC);
+}
 
-	oval = private->vol_sw_hw_switch[index];
-	val = !!ucontrol->value.integer.value[0];
+static void scarlett2_usb_transport_cancel(struct scarlett2_mixer_data *private)
+{
+	usb_unlink_urb(private->cmd_urb);
+}
 
-	if (oval == val)
-		goto unlock;
+static const struct scarlett2_transport_ops scarlett2_usb_transport = {
+	.name   = "usb",
+	.init   = scarlett2_usb_transport_init,
+	.free   = scarlett2_usb_transport_free,
+	.tx     = scarlett2_usb_transport_tx,
+	.rx     = scarlett2_usb_transport_rx,
+	.submit = scarlett2_usb_transport_submit,
+	.cancel = scarlett2_usb_transport_cancel,
+};
 
-	private->vol_sw_hw_switch[index] = val;
+/*** Synchronous transport helpers ***
+ *
+ * Transports which can only transfer packets synchronously perform the
+ * request and the response transfers from xfer_work.
+ */
 
-	/* Change access mode to RO (hardware controlled volume)
-	 * or RW (software controlled volume)
-	 */
-	if (val) {
-		private->vol_ctls[index]->vd[0].access &=
-			~SNDRV_CTL_ELEM_ACCESS_WRITE;
+static void scarlett2_transport_sync_work(struct work_struct *work)
+{
+	struct scarlett2_mixer_data *private =
+		container_of(work, struct scarlett2_mixer_data, xfer_work);
+	const struct scarlett2_transport_ops *ops = private->xfer_ops;
+	struct scarlett2_cmd *cmd;
+	unsigned long flags;
+	u16 req_len, resp_len;
+	int err;
 
-		/* Set volume to current HW volume */
-		err = scarlett2_usb_set_config(
-			mixer, SCARLETT2_CONFIG_LINE_OUT_VOLUME,
-			index, private->master_vol - SCARLETT2_VOLUME_BIAS);
-		if (err < 0)
-			goto unlock;
-	}
-	else {
-		private->vol_ctls[index]->vd[0].access |=
-			SNDRV_CTL_ELEM_ACCESS_WRITE;
+	spin_lock_irqsave(&private->cmd_lock, flags);
+	cmd = private->cmd_active;
+	spin_unlock_irqrestore(&private->cmd_lock, flags);
+	if (!cmd)
+		return;
 
-		if (private->sw_cfg) {
-			/* Reset volume to software config */
-			volume = le16_to_cpu(private->sw_cfg->volume[index].volume);
-			private->vol[index] = clamp(volume + SCARLETT2_VOLUME_BIAS, 0, SCARLETT2_VOLUME_BIAS);
-		}
+	/* The command stays active until scarlett2_cmd_xfer_done() */
+	req_len = sizeof(struct scarlett2_usb_packet) + cmd->req_size;
+	resp_len = sizeof(struct scarlett2_usb_packet) + cmd->resp_size;
 
-		/* Set volume to current SW volume */
-		err = scarlett2_usb_set_config(
-			mixer, SCARLETT2_CONFIG_LINE_OUT_VOLUME,
-			index, private->vol[index] - SCARLETT2_VOLUME_BIAS);
-		if (err < 0)
-			goto unlock;
-	}
+	err = ops->tx(private, SCARLETT2_USB_CMD_REQ, cmd->req, req_len);
+	if ((err >= 0) && (err != req_len))
+		err = -EPROTO;
+	if (err >= 0)
+		err = ops->rx(private, SCARLETT2_USB_CMD_RESP, private->cmd_resp, resp_len);
 
-	/* Notify of RO/RW change */
-	snd_ctl_notify(mixer->chip->card, SNDRV_CTL_EVENT_MASK_INFO | SNDRV_CTL_EVENT_MASK_VALUE,
-		       &private->vol_ctls[index]->id);
+	scarlett2_cmd_xfer_done(private, min(err, 0), max(err, 0));
+}
 
-	/* Send SW/HW switch change to the device */
-	err = scarlett2_usb_set_config(mixer, SCARLETT2_CONFIG_SW_HW_SWITCH, index, val);
-	if (err < 0)
-		goto unlock;
+static int scarlett2_transport_sync_submit(struct scarlett2_mixer_data *private,
+					   const struct scarlett2_transport_ops *ops)
+{
+	/* Not on the device queue: the deferred work there may wait for
+	 * free command slots, which only this work releases
+	 */
+	private->xfer_ops = ops;
+	schedule_work(&private->xfer_work);
+	return 0;
+}
 
-	/* Update volume settings */
-	scarlett2_update_volumes(mixer);
+/*** Loopback transport ***
+ *
+ * Emulates the configuration space, the routing tables and the replies
+ * of the device, so the whole control path can be exercised and
+ * benchmarked without any traffic reaching the hardware or a Scarlett
+ * being attached.
+ */
 
-unlock:
-	mutex_unlock(&private->data_mutex);
-	return err;
-}
+#define SCARLETT2_LOOPBACK_MEM_SIZE              0x2000   /* Emulated configuration space size */
+#define SCARLETT2_LOOPBACK_MUX_TABLES            (SCARLETT2_PORT_OUT_176 - SCARLETT2_PORT_OUT_44 + 1)
 
-static const struct snd_kcontrol_new scarlett2_sw_hw_enum_ctl = {
-	.iface = SNDRV_CTL_ELEM_IFACE_MIXER,
-	.name = "",
-	.info = scarlett2_sw_hw_enum_ctl_info,
-	.get  = scarlett2_sw_hw_enum_ctl_get,
-	.put  = scarlett2_sw_hw_enum_ctl_put,
+struct scarlett2_loopback {
+	u8 mem[SCARLETT2_LOOPBACK_MEM_SIZE];                              /* Configuration space */
+	__le32 mux[SCARLETT2_LOOPBACK_MUX_TABLES][SCARLETT2_MUX_MAX];     /* Routing tables for each sample rate */
+	u8 req[SCARLETT2_USB_MAX_PACKET];                                 /* Last received request */
+	u8 error;                                                         /* Last request was invalid */
 };
 
-/*** Gain Halos Switch Controls ***/
-static int scarlett2_ghalo_color_enum_ctl_info(struct snd_kcontrol *kctl,
-					 struct snd_ctl_elem_info *uinfo)
+static int scarlett2_loopback_init(struct scarlett2_mixer_data *private)
 {
-	static const char *const values[8] = {
-		"Off",
-		"Red",
-		"Green",
-		"Amber",
-		"Blue",
-		"Pink",
-		"Light Blue",
-		"Light Pink"
-	};
+	private->transport_data = kzalloc(sizeof(struct scarlett2_loopback), GFP_KERNEL);
+	return (private->transport_data) ? 0 : -ENOMEM;
+}
 
-	return snd_ctl_enum_info(uinfo, 1, 8, values);
+static void scarlett2_loopback_free(struct scarlett2_mixer_data *private)
+{
+	cancel_work_sync(&private->xfer_work);
+	kfree(private->transport_data);
+	private->transport_data = NULL;
 }
 
-static int scarlett2_ghalo_custom_ctl_get(struct snd_kcontrol *kctl,
-					struct snd_ctl_elem_value *ucontrol)
+/* Receive the request and apply the changes it carries */
+static int scarlett2_loopback_tx(struct scarlett2_mixer_data *private,
+				 u8 request, void *buf, u16 size)
 {
-	struct usb_mixer_elem_info *elem = kctl->private_data;
-	struct scarlett2_mixer_data *private = elem->head.mixer->private_data;
+	struct scarlett2_loopback *lb = private->transport_data;
+	struct scarlett2_usb_packet *req = (void *)lb->req;
+	struct scarlett2_usb_set_data *set_data;
+	struct {
+		__le16 pad;
+		__le16 num;
+		__le32 data[];
+	} __packed *set_mux;
+	u32 offset, bytes, payload;
 
-	ucontrol->value.enumerated.item[0] = private->ghalo_custom;
+	if ((request != SCARLETT2_USB_CMD_REQ) ||
+	    (size < sizeof(struct scarlett2_usb_packet)) || (size > sizeof(lb->req)))
+		return -EINVAL;
 
-	return 0;
+	memcpy(lb->req, buf, size);
+	payload = size - sizeof(struct scarlett2_usb_packet);
+	lb->error = 0;
+
+	switch (le32_to_cpu(req->cmd)) {
+	case SCARLETT2_USB_SET_DATA:
+		set_data = (void *)req->data;
+		offset = le32_to_cpu(set_data->offset);
+		bytes = le32_to_cpu(set_data->size);
+		if ((payload < sizeof(*set_data) + bytes) ||
+		    (offset + bytes > SCARLETT2_LOOPBACK_MEM_SIZE))
+			lb->error = 1;
+		else
+			memcpy(&lb->mem[offset], set_data->data, bytes);
+		break;
+
+	case SCARLETT2_USB_SET_MUX:
+		set_mux = (void *)req->data;
+		offset = le16_to_cpu(set_mux->num);
+		bytes = min_t(u32, payload - sizeof(*set_mux), sizeof(lb->mux[0]));
+		if ((payload < sizeof(*set_mux)) || (offset >= SCARLETT2_LOOPBACK_MUX_TABLES))
+			lb->error = 1;
+		else
+			memcpy(lb->mux[offset], set_mux->data, bytes);
+		break;
+
+	default:
+		break;
+	}
+
+	return size;
 }
 
-static int scarlett2_ghalo_level_ctl_get(struct snd_kcontrol *kctl,
-					struct snd_ctl_elem_value *ucontrol)
+/* Produce the response for the last request */
+static int scarlett2_loopback_rx(struct scarlett2_mixer_data *private,
+				 u8 request, void *buf, u16 size)
 {
-	struct usb_mixer_elem_info *elem = kctl->private_data;
-	struct scarlett2_mixer_data *private = elem->head.mixer->private_data;
+	struct scarlett2_loopback *lb = private->transport_data;
+	struct scarlett2_usb_packet *req = (void *)lb->req;
+	struct scarlett2_usb_packet *resp = buf;
+	struct {
+		__le32 offset;
+		__le32 size;
+	} __packed *get_data;
+	struct {
+		__le16 num;
+		__le16 count;
+	} __packed *get_mux;
+	u32 offset, bytes, payload;
 
-	ucontrol->value.enumerated.item[0] = private->ghalo_levels[elem->control];
-	return 0;
+	memset(buf, 0, size);
+	if (request == SCARLETT2_USB_CMD_INIT)
+		return size;
+	if ((request != SCARLETT2_USB_CMD_RESP) || (size < sizeof(struct scarlett2_usb_packet)))
+		return -EINVAL;
+
+	payload = size - sizeof(struct scarlett2_usb_packet);
+	resp->cmd = req->cmd;
+	resp->seq = req->seq;
+	resp->size = cpu_to_le16(payload);
+	resp->error = cpu_to_le32(lb->error);
+
+	switch (le32_to_cpu(req->cmd)) {
+	case SCARLETT2_USB_GET_DATA:
+		get_data = (void *)req->data;
+		offset = le32_to_cpu(get_data->offset);
+		bytes = min_t(u32, le32_to_cpu(get_data->size), payload);
+		if (offset + bytes > SCARLETT2_LOOPBACK_MEM_SIZE)
+			resp->error = cpu_to_le32(1);
+		else
+			memcpy(resp->data, &lb->mem[offset], bytes);
+		break;
+
+	case SCARLETT2_USB_GET_MUX:
+		get_mux = (void *)req->data;
+		offset = le16_to_cpu(get_mux->num);
+		bytes = min_t(u32, payload, sizeof(lb->mux[0]));
+		if (offset >= SCARLETT2_LOOPBACK_MUX_TABLES)
+			resp->error = cpu_to_le32(1);
+		else
+			memcpy(resp->data, lb->mux[offset], bytes);
+		break;
+
+	default:
+		/* INIT_2, GET_METER_LEVELS and others reply with zeros */
+		break;
+	}
+
+	return size;
 }
 
-static int scarlett2_ghalo_led_ctl_get(struct snd_kcontrol *kctl,
-					struct snd_ctl_elem_value *ucontrol)
-{
-	struct usb_mixer_elem_info *elem = kctl->private_data;
-	struct scarlett2_mixer_data *private = elem->head.mixer->private_data;
+static const struct scarlett2_transport_ops scarlett2_loopback_transport;
 
-	ucontrol->value.enumerated.item[0] = private->ghalo_leds[elem->control];
-	return 0;
+static int scarlett2_loopback_submit(struct scarlett2_mixer_data *private,
+				     struct scarlett2_cmd *cmd)
+{
+	return scarlett2_transport_sync_submit(private, &scarlett2_loopback_transport);
 }
 
-static int scarlett2_ghalo_custom_ctl_put(struct snd_kcontrol *kctl,
-					struct snd_ctl_elem_value *ucontrol)
+static void scarlett2_loopback_cancel(struct scarlett2_mixer_data *private)
 {
-	struct usb_mixer_elem_info *elem = kctl->private_data;
-	struct usb_mixer_interface *mixer = elem->head.mixer;
-	struct scarlett2_mixer_data *private = mixer->private_data;
+	/* Transfers are performed synchronously and always finish */
+}
 
-	int oval, val, err = 0;
-	int command;
+static const struct scarlett2_transport_ops scarlett2_loopback_transport = {
+	.name     = "loopback",
+	.emulated = true,
+	.init     = scarlett2_loopback_init,
+	.free     = scarlett2_loopback_free,
+	.tx       = scarlett2_loopback_tx,
+	.rx       = scarlett2_loopback_rx,
+	.submit   = scarlett2_loopback_submit,
+	.cancel   = scarlett2_loopback_cancel,
+};
 
-	mutex_lock(&private->data_mutex);
+/*** Recording transport ***
+ *
+ * Wraps the selected transport and counts transfers and bytes for each
+ * command. Writing the name of an operation to the debugfs "transport"
+ * file resets the counters and labels them, so the cost of a single
+ * user operation can be measured.
+ */
 
-	oval = private->ghalo_custom;
-	val = !!ucontrol->value.integer.value[0];
+#define SCARLETT2_RECORD_OP_LEN                  32       /* Longest operation label */
 
-	if (oval == val)
-		goto unlock;
-
-	private->ghalo_custom = val;
-	command = (val) ? 0x02 : 0;
+struct scarlett2_record_stats {
+	unsigned long commands;                                           /* Number of commands */
+	unsigned long transfers;                                          /* Number of packet transfers */
+	unsigned long bytes_out;                                          /* Bytes sent to the device */
+	unsigned long bytes_in;                                           /* Bytes received from the device */
+};
 
-	/* Set gain halo control */
-	err = scarlett2_usb_set_config(
-		mixer, SCARLETT2_CONFIG_GAIN_HALO_ENABLE,
-		0, command);
+struct scarlett2_record {
+	spinlock_t lock;                                                  /* Protects the statistics */
+	char op[SCARLETT2_RECORD_OP_LEN];                                 /* Operation measured since the last reset */
+	struct scarlett2_record_stats stats[SCARLETT2_CMD_ID_COUNT];      /* Statistics per command */
+};
 
-unlock:
-	mutex_unlock(&private->data_mutex);
-	return err;
+static void scarlett2_record_account(struct scarlett2_mixer_data *private, int id,
+				     int commands, int transfers, int bytes_out, int bytes_in)
+{
+	struct scarlett2_record *rec = private->record;
+	unsigned long flags;
+
+	spin_lock_irqsave(&rec->lock, flags);
+	rec->stats[id].commands += commands;
+	rec->stats[id].transfers += transfers;
+	rec->stats[id].bytes_out += bytes_out;
+	rec->stats[id].bytes_in += bytes_in;
+	spin_unlock_irqrestore(&rec->lock, flags);
 }
 
-static int scarlett2_ghalo_level_ctl_put(struct snd_kcontrol *kctl,
-					struct snd_ctl_elem_value *ucontrol)
+static int scarlett2_record_init(struct scarlett2_mixer_data *private)
 {
-	struct usb_mixer_elem_info *elem = kctl->private_data;
-	struct usb_mixer_interface *mixer = elem->head.mixer;
-	struct scarlett2_mixer_data *private = mixer->private_data;
-
-	int index = elem->control;
-	int oval, val, err = 0;
-
-	mutex_lock(&private->data_mutex);
-
-	oval = private->ghalo_levels[index];
-	val = ucontrol->value.integer.value[0];
-	val = clamp(val, 0, 7);
-
-	if (oval == val)
-		goto unlock;
-
-	private->ghalo_levels[index] = val;
-
-	/* Set gain halo control */
-	err = scarlett2_usb_set_config(mixer, SCARLETT2_CONFIG_GAIN_HALO_LEVELS, index, val);
+	private->record = kzalloc(sizeof(struct scarlett2_record), GFP_KERNEL);
+	if (!private->record)
+		return -ENOMEM;
+	spin_lock_init(&private->record->lock);
 
-unlock:
-	mutex_unlock(&private->data_mutex);
-	return err;
+	return private->transport_lower->init(private);
 }
 
-static int scarlett2_ghalo_led_ctl_put(struct snd_kcontrol *kctl,
-					struct snd_ctl_elem_value *ucontrol)
+static void scarlett2_record_free(struct scarlett2_mixer_data *private)
 {
-	struct usb_mixer_elem_info *elem = kctl->private_data;
-	struct usb_mixer_interface *mixer = elem->head.mixer;
-	struct scarlett2_mixer_data *private = mixer->private_data;
+	private->transport_lower->free(private);
+	kfree(private->record);
+	private->record = NULL;
+}
 
-	int index = elem->control;
-	int oval, val, err = 0;
+static int scarlett2_record_tx(struct scarlett2_mixer_data *private,
+			       u8 request, void *buf, u16 size)
+{
+	struct scarlett2_usb_packet *req = buf;
+	int id = SCARLETT2_CMD_ID_OTHER;
 
-	mutex_lock(&private->data_mutex);
+	if ((request == SCARLETT2_USB_CMD_REQ) && (size >= sizeof(*req)))
+		id = scarlett2_cmd_id(le32_to_cpu(req->cmd));
+	scarlett2_record_account(private, id, 0, 1, size, 0);
 
-	oval = private->ghalo_leds[index];
-	val = ucontrol->value.integer.value[0];
-	val = clamp(val, 0, 7);
+	return private->transport_lower->tx(private, request, buf, size);
+}
 
-	if (oval == val)
-		goto unlock;
+static int scarlett2_record_rx(struct scarlett2_mixer_data *private,
+			       u8 request, void *buf, u16 size)
+{
+	scarlett2_record_account(private, SCARLETT2_CMD_ID_OTHER, 0, 1, 0, size);
 
-	private->ghalo_leds[index] = val;
+	return private->transport_lower->rx(private, request, buf, size);
+}
 
-	/* Set gain halo control */
-	err = scarlett2_usb_set_config(mixer, SCARLETT2_CONFIG_GAIN_HALO_LEDS, index, val);
+static int scarlett2_record_submit(struct scarlett2_mixer_data *private,
+				   struct scarlett2_cmd *cmd)
+{
+	scarlett2_record_account(private, scarlett2_cmd_id(cmd->cmd), 1, 2,
+				 sizeof(struct scarlett2_usb_packet) + cmd->req_size,
+				 sizeof(struct scarlett2_usb_packet) + cmd->resp_size);
 
-unlock:
-	mutex_unlock(&private->data_mutex);
-	return err;
+	return private->transport_lower->submit(private, cmd);
 }
 
-static const struct snd_kcontrol_new scarlett2_ghalo_custom_ctl = {
-	.iface = SNDRV_CTL_ELEM_IFACE_MIXER,
-	.name = "",
-	.info = scarlett2_bool_enum_ctl_info,
-	.get  = scarlett2_ghalo_custom_ctl_get,
-	.put  = scarlett2_ghalo_custom_ctl_put,
-};
+static void scarlett2_record_cancel(struct scarlett2_mixer_data *private)
+{
+	private->transport_lower->cancel(private);
+}
 
-static const struct snd_kcontrol_new scarlett2_ghalo_level_ctl = {
-	.iface = SNDRV_CTL_ELEM_IFACE_MIXER,
-	.name = "",
-	.info = scarlett2_ghalo_color_enum_ctl_info,
-	.get  = scarlett2_ghalo_level_ctl_get,
-	.put  = scarlett2_ghalo_level_ctl_put,
+static const struct scarlett2_transport_ops scarlett2_record_transport = {
+	.name   = "record",
+	.init   = scarlett2_record_init,
+	.free   = scarlett2_record_free,
+	.tx     = scarlett2_record_tx,
+	.rx     = scarlett2_record_rx,
+	.submit = scarlett2_record_submit,
+	.cancel = scarlett2_record_cancel,
 };
 
-static const struct snd_kcontrol_new scarlett2_ghalo_led_ctl = {
-	.iface = SNDRV_CTL_ELEM_IFACE_MIXER,
-	.name = "",
-	.info = scarlett2_ghalo_color_enum_ctl_info,
-	.get  = scarlett2_ghalo_led_ctl_get,
-	.put  = scarlett2_ghalo_led_ctl_put,
-};
+/* Check if the selected transport replies without the device */
+static bool scarlett2_transport_emulated(struct scarlett2_mixer_data *private)
+{
+	if (private->transport_lower)
+		return private->transport_lower->emulated;
+	return private->transport->emulated;
+}
 
-/*** Line Level/Instrument Level Switch Controls ***/
-static int scarlett2_update_line_ctl_switches(struct usb_mixer_interface *mixer)
+/* Select the transport according to the module parameters */
+static int scarlett2_transport_init(struct usb_mixer_interface *mixer)
 {
 	struct scarlett2_mixer_data *private = mixer->private_data;
-	const struct scarlett2_device_info *info = private->info;
-	u8 pad_switches[SCARLETT2_PAD_SWITCH_MAX];
-	u8 air_switches[SCARLETT2_AIR_SWITCH_MAX];
-	u8 level_switches[SCARLETT2_LEVEL_SWITCH_MAX];
-	u8 pow_switch, retain48v;
-	int i, index, err = 0;
-
-	/* Check for re-entrance */
-	if (!private->line_ctl_updated)
-		return 0;
+	const struct scarlett2_transport_ops *ops = &scarlett2_usb_transport;
 
-	/* Update PAD settings */
-	if (info->pad_input_count) {
-		err = scarlett2_usb_get_config(
-			mixer,
-			SCARLETT2_CONFIG_PAD_SWITCH,
-			info->pad_input_count,
-			pad_switches);
-		if (err < 0)
-			return err;
+	if ((scarlett2_transport) && (!strcmp(scarlett2_transport, "loopback")))
+		ops = &scarlett2_loopback_transport;
+	else if ((scarlett2_transport) && (strcmp(scarlett2_transport, "usb")))
+		usb_audio_warn(mixer->chip, "Unknown transport '%s', using usb", scarlett2_transport);
 
-		for (i = 0; i < info->pad_input_count; i++)
-			private->pad_switch[i] = !!pad_switches[i];
-	}
+	if (ops != &scarlett2_usb_transport)
+		usb_audio_info(mixer->chip, "Using %s transport for the proprietary protocol", ops->name);
 
-	/* Update AIR input settings */
-	if (info->air_input_count) {
-		err = scarlett2_usb_get_config(
-			mixer,
-			SCARLETT2_CONFIG_AIR_SWITCH,
-			(info->air_input_bitmask) ? 1 : info->air_input_count,
-			air_switches);
-		if (err < 0)
-			return err;
-		for (i = 0; i < info->air_input_count; i++)
-			private->air_switch[i] = !! ((info->air_input_bitmask) ? air_switches[0] & (1 << i) : air_switches[i]);
+	if (scarlett2_record) {
+		private->transport_lower = ops;
+		ops = &scarlett2_record_transport;
 	}
 
-	/* Update LINE/INST settings */
-	if (info->level_input_count) {
-		err = scarlett2_usb_get_config(
-			mixer,
-			SCARLETT2_CONFIG_LEVEL_SWITCH,
-			(info->level_input_bitmask) ? 1 : info->level_input_count,
-			level_switches);
-		if (err < 0)
-			return err;
+	private->transport = ops;
+	return ops->init(private);
+}
 
-		for (i = 0; i < info->level_input_count; i++) {
-			index = i + info->level_input_offset;
-			private->level_switch[i] = !! ((info->level_input_bitmask) ? level_switches[0] & (1 << index) : level_switches[index]);
-		}
-	}
+/* Allocate the command engine resources */
+static int scarlett2_cmd_init(struct usb_mixer_interface *mixer)
+{
+	struct scarlett2_mixer_data *private = mixer->private_data;
+	int i;
 
-	/* Update phantom power settings */
-	if (info->power_48v_count) {
-		err = scarlett2_usb_get_config(
-			mixer,
-			SCARLETT2_CONFIG_48V_SWITCH,
-			1, &pow_switch);
-		if (err < 0)
-			return err;
+	spin_lock_init(&private->cmd_lock);
+	INIT_LIST_HEAD(&private->cmd_queue);
+	INIT_LIST_HEAD(&private->cmd_queue_low);
+	INIT_LIST_HEAD(&private->cmd_free);
+	init_waitqueue_head(&private->cmd_wait);
+	timer_setup(&private->cmd_timer, scarlett2_cmd_timeout, 0);
+	timer_setup(&private->cmd_backoff_timer, scarlett2_cmd_backoff_end, 0);
+	timer_setup(&private->cmd_throttle_timer, scarlett2_cmd_throttle_end, 0);
+	INIT_WORK(&private->xfer_work, scarlett2_transport_sync_work);
+	private->chunk_size = SCARLETT2_SW_CONFIG_PACKET_SIZE;
+
+	private->cmd_resp = kmalloc(SCARLETT2_USB_MAX_PACKET, GFP_KERNEL);
+	private->cmd_slots = kcalloc(SCARLETT2_CMD_SLOTS, sizeof(struct scarlett2_cmd), GFP_KERNEL);
+	private->cmd_stats = kcalloc(SCARLETT2_CMD_ID_COUNT, sizeof(struct scarlett2_cmd_stats), GFP_KERNEL);
+	private->resync_cmd.req = kmalloc(SCARLETT2_USB_MAX_PACKET, GFP_KERNEL);
+	if ((!private->cmd_resp) || (!private->cmd_slots) || (!private->cmd_stats) ||
+	    (!private->resync_cmd.req))
+		return -ENOMEM;
 
-		for (i = 0; i < info->power_48v_count; i++)
-			private->pow_switch[i] = !! (pow_switch & (1 << i));
+	for (i = 0; i < SCARLETT2_CMD_SLOTS; ++i) {
+		private->cmd_slots[i].req = kmalloc(SCARLETT2_USB_MAX_PACKET, GFP_KERNEL);
+		if (!private->cmd_slots[i].req)
+			return -ENOMEM;
+		list_add_tail(&private->cmd_slots[i].list, &private->cmd_free);
 	}
 
-	/* 'Retain 48V' switch */
-	if (info->has_retain48v) {
-		err = scarlett2_usb_get_config(
-			mixer,
-			SCARLETT2_CONFIG_RETAIN_48V,
-			1, &retain48v);
-		if (err < 0)
-			return err;
+	return scarlett2_transport_init(mixer);
+}
 
-		private->retain48v_switch = !! retain48v;
-	}
+/* Stop the command engine and free its resources */
+static void scarlett2_cmd_free(struct scarlett2_mixer_data *private)
+{
+	unsigned long flags;
+	int i;
 
-	/* Reset the update flag AFTER the data has been retrieved */
-	private->line_ctl_updated = 0;
+	spin_lock_irqsave(&private->cmd_lock, flags);
+	private->cmd_shutdown = 1;
+	spin_unlock_irqrestore(&private->cmd_lock, flags);
 
-	return 0;
+	/* The timers are not armed again once the engine is shut down;
+	 * the watchdog may cancel the transfer, so it goes before the
+	 * transport resources
+	 */
+	del_timer_sync(&private->cmd_timer);
+	del_timer_sync(&private->cmd_backoff_timer);
+	del_timer_sync(&private->cmd_throttle_timer);
+	if (private->transport)
+		private->transport->free(private);
+
+	/* Fail the commands held back by the retry delay or the rate limiter */
+	spin_lock_irqsave(&private->cmd_lock, flags);
+	private->cmd_backoff = 0;
+	private->cmd_throttled = 0;
+	if (private->transport)
+		scarlett2_cmd_submit_next(private);
+	spin_unlock_irqrestore(&private->cmd_lock, flags);
+
+	if (private->cmd_slots) {
+		for (i = 0; i < SCARLETT2_CMD_SLOTS; ++i)
+			kfree(private->cmd_slots[i].req);
+		kfree(private->cmd_slots);
+	}
+	kfree(private->cmd_resp);
+	kfree(private->cmd_stats);
+	kfree(private->resync_cmd.req);
 }
 
-static int scarlett2_level_enum_ctl_info(struct snd_kcontrol *kctl,
-					 struct snd_ctl_elem_info *uinfo)
-{
-	static const char *const values[2] = {
-		"Line", "Inst"
-	};
+static int scarlett2_usb(
+	struct usb_mixer_interface *mixer, u32 cmd,
+	void *req_data, u16 req_size, void *resp_data, u16 resp_size);
 
-	return snd_ctl_enum_info(uinfo, 1, 2, values);
-}
+static int scarlett2_commit_software_config(
+	struct usb_mixer_interface *mixer,
+	void *ptr, /* the pointer of the first changed byte in the configuration */
+	int bytes /* the actual number of bytes changed in the configuration */
+);
+static int scarlett2_sw_cfg_flush(struct usb_mixer_interface *mixer);
+static void scarlett2_config_save_schedule(struct usb_mixer_interface *mixer);
+static void scarlett2_sw_cfg_txn_begin(struct usb_mixer_interface *mixer);
+static int scarlett2_sw_cfg_txn_commit(struct usb_mixer_interface *mixer);
+static void scarlett2_sw_cfg_txn_abort(struct usb_mixer_interface *mixer);
+static void scarlett2_sw_cfg_flush_work(struct work_struct *work);
+static int scarlett2_update_volumes(struct usb_mixer_interface *mixer);
+static void scarlett2_mixer_interrupt_vol_change(struct usb_mixer_interface *mixer);
 
-static int scarlett2_level_enum_ctl_get(struct snd_kcontrol *kctl,
-					struct snd_ctl_elem_value *ucontrol)
+/* Cargo cult proprietary initialisation sequence */
+static int scarlett2_usb_init(struct usb_mixer_interface *mixer)
 {
-	struct usb_mixer_elem_info *elem = kctl->private_data;
-	struct usb_mixer_interface *mixer = elem->head.mixer;
 	struct scarlett2_mixer_data *private = mixer->private_data;
+	u16 buf_size = sizeof(struct scarlett2_usb_packet) + 8;
+	unsigned long flags;
+	void *buf;
+	int err;
 
-	if (private->line_ctl_updated) {
-		mutex_lock(&private->data_mutex);
-		scarlett2_update_line_ctl_switches(mixer);
-		mutex_unlock(&private->data_mutex);
-	}
+	buf = kmalloc(buf_size, GFP_KERNEL);
+	if (!buf)
+		return -ENOMEM;
 
-	ucontrol->value.enumerated.item[0] = private->level_switch[elem->control];
-	return 0;
+	scarlett2_usb_lock(private);
+
+	// step 0
+	err = private->transport->rx(private, SCARLETT2_USB_CMD_INIT, buf, buf_size);
+	if (err < 0)
+		goto unlock;
+
+	// step 1
+	spin_lock_irqsave(&private->cmd_lock, flags);
+	private->scarlett2_seq = 1;
+	spin_unlock_irqrestore(&private->cmd_lock, flags);
+	err = scarlett2_usb(mixer, SCARLETT2_USB_INIT_1, NULL, 0, NULL, 0);
+	if (err < 0)
+		goto unlock;
+
+	// step 2
+	spin_lock_irqsave(&private->cmd_lock, flags);
+	private->scarlett2_seq = 1;
+	spin_unlock_irqrestore(&private->cmd_lock, flags);
+	err = scarlett2_usb(mixer, SCARLETT2_USB_INIT_2, NULL, 0, NULL, 84);
+
+unlock:
+	scarlett2_usb_unlock(private);
+	kfree(buf);
+	return (err < 0) ? err : 0;
 }
 
-static int scarlett2_level_enum_ctl_put(struct snd_kcontrol *kctl,
-					struct snd_ctl_elem_value *ucontrol)
+/* Send a proprietary format request to the Scarlett interface and
+ * wait for the response
+ */
+static int scarlett2_usb(
+	struct usb_mixer_interface *mixer, u32 cmd,
+	void *req_data, u16 req_size, void *resp_data, u16 resp_size)
 {
-	struct usb_mixer_elem_info *elem = kctl->private_data;
-	struct usb_mixer_interface *mixer = elem->head.mixer;
 	struct scarlett2_mixer_data *private = mixer->private_data;
-	const struct scarlett2_device_info *info = private->info;
-
-	int index = elem->control;
-	int oval, val, err = 0;
-
-	mutex_lock(&private->data_mutex);
-	scarlett2_update_line_ctl_switches(mixer);
-	oval = private->level_switch[index];
-	val = !!ucontrol->value.integer.value[0];
+	struct scarlett2_cmd *c;
+	u64 start, queued_at;
+	bool queued;
+	int err;
 
-	if (oval == val)
-		goto unlock;
+	start = ktime_get_ns();
+	c = scarlett2_cmd_alloc(private);
+	if (!c)
+		return -ENODEV;
 
-	private->level_switch[index] = val;
+	if (req_size)
+		memcpy(c->req->data, req_data, min_t(u16, req_size, SCARLETT2_USB_MAX_PAYLOAD));
 
-	if (info->level_input_bitmask) {
-		val = 0;
-		for (index = 0; index < info->level_input_count; ++index)
-			val |= private->level_switch[index] << (index + info->level_input_offset);
-		index = 0;
-	}
+	queued_at = ktime_get_ns();
+	err = scarlett2_usb_wait(mixer, c, cmd, req_size, resp_data, resp_size, &queued);
+	if (!queued)
+		return err;
 
-	/* Send inst change to the device */
-	err = scarlett2_usb_set_config(mixer, SCARLETT2_CONFIG_LEVEL_SWITCH,
-				       index, val);
+	trace_scarlett2_usb(cmd, le16_to_cpu(c->req->seq), req_size, resp_size, err,
+			    queued_at - start, ktime_get_ns() - queued_at);
+	scarlett2_cmd_release(private, c);
 
-unlock:
-	mutex_unlock(&private->data_mutex);
 	return err;
 }
 
-static const struct snd_kcontrol_new scarlett2_level_enum_ctl = {
-	.iface = SNDRV_CTL_ELEM_IFACE_MIXER,
-	.name = "",
-	.info = scarlett2_level_enum_ctl_info,
-	.get  = scarlett2_level_enum_ctl_get,
-	.put  = scarlett2_level_enum_ctl_put,
-};
-
-/*** Pad Switch Controls ***/
-static int scarlett2_pad_ctl_get(struct snd_kcontrol *kctl,
-				 struct snd_ctl_elem_value *ucontrol)
+/* Send SCARLETT2_USB_DATA_CMD activations collected so far; returns
+ * when all of them are queued, waiting for free slots if needed
+ */
+static void scarlett2_activate_flush(struct usb_mixer_interface *mixer)
 {
-	struct usb_mixer_elem_info *elem = kctl->private_data;
-	struct usb_mixer_interface *mixer = elem->head.mixer;
 	struct scarlett2_mixer_data *private = mixer->private_data;
+	unsigned long flags;
+	bool queued;
 
-	if (private->line_ctl_updated) {
-		mutex_lock(&private->data_mutex);
-		scarlett2_update_line_ctl_switches(mixer);
-		mutex_unlock(&private->data_mutex);
-	}
+	for (;;) {
+		spin_lock_irqsave(&private->cmd_lock, flags);
+		queued = scarlett2_activate_queue(private);
+		scarlett2_cmd_submit_next(private);
+		spin_unlock_irqrestore(&private->cmd_lock, flags);
 
-	ucontrol->value.enumerated.item[0] =
-		private->pad_switch[elem->control];
-	return 0;
+		if (queued)
+			break;
+		wait_event(private->cmd_wait, scarlett2_cmd_slot_ready(private));
+	}
 }
 
-static int scarlett2_pad_ctl_put(struct snd_kcontrol *kctl,
-				 struct snd_ctl_elem_value *ucontrol)
+/* Request the activation; activations with the same id requested within
+ * SCARLETT2_ACTIVATE_DELAY are sent as a single DATA_CMD
+ */
+static void scarlett2_activate(struct usb_mixer_interface *mixer, int id)
 {
-	struct usb_mixer_elem_info *elem = kctl->private_data;
-	struct usb_mixer_interface *mixer = elem->head.mixer;
 	struct scarlett2_mixer_data *private = mixer->private_data;
+	unsigned long flags;
 
-	int index = elem->control;
-	int oval, val, err = 0;
+	spin_lock_irqsave(&private->cmd_lock, flags);
+	private->activate_pending |= BIT(id);
+	private->stat_activate_requested++;
+	spin_unlock_irqrestore(&private->cmd_lock, flags);
 
-	mutex_lock(&private->data_mutex);
-	scarlett2_update_line_ctl_switches(mixer);
+	queue_delayed_work(private->wq, &private->activate_work, msecs_to_jiffies(SCARLETT2_ACTIVATE_DELAY));
+}
 
-	oval = private->pad_switch[index];
-	val = !!ucontrol->value.integer.value[0];
-
-	if (oval == val)
-		goto unlock;
-
-	private->pad_switch[index] = val;
-
-	/* Send pad change to the device */
-	err = scarlett2_usb_set_config(mixer, SCARLETT2_CONFIG_PAD_SWITCH, index, val);
+/* Delayed work to send activations */
+static void scarlett2_activate_work(struct work_struct *work)
+{
+	struct scarlett2_mixer_data *private =
+		container_of(work, struct scarlett2_mixer_data, activate_work.work);
 
-unlock:
-	mutex_unlock(&private->data_mutex);
-	return err;
+	scarlett2_activate_flush(private->mixer);
 }
 
-static const struct snd_kcontrol_new scarlett2_pad_ctl = {
-	.iface = SNDRV_CTL_ELEM_IFACE_MIXER,
-	.name = "",
-	.info = scarlett2_bool_enum_ctl_info,
-	.get  = scarlett2_pad_ctl_get,
-	.put  = scarlett2_pad_ctl_put,
-};
-
-/*** Air Switch Controls ***/
-static int scarlett2_air_ctl_get(struct snd_kcontrol *kctl,
-				 struct snd_ctl_elem_value *ucontrol)
+/* Send SCARLETT2_USB_DATA_CMD SCARLETT2_USB_CONFIG_SAVE */
+static void scarlett2_config_save(struct usb_mixer_interface *mixer)
 {
-	struct usb_mixer_elem_info *elem = kctl->private_data;
-	struct usb_mixer_interface *mixer = elem->head.mixer;
-	struct scarlett2_mixer_data *private = elem->head.mixer->private_data;
+	struct scarlett2_mixer_data *private = mixer->private_data;
+	struct scarlett2_cmd *cmd;
+	unsigned long flags;
+	__le32 *req;
+	int err;
 
-	if (private->line_ctl_updated) {
-		mutex_lock(&private->data_mutex);
-		scarlett2_update_line_ctl_switches(mixer);
-		mutex_unlock(&private->data_mutex);
+	spin_lock_irqsave(&private->cmd_lock, flags);
+	private->save_pending = 0;
+	private->stat_save_issued++;
+	spin_unlock_irqrestore(&private->cmd_lock, flags);
+
+	/* The software configuration changes should reach the device; an
+	 * area with a stale checksum is not written to NVRAM, the save is
+	 * tried again instead
+	 */
+	err = scarlett2_sw_cfg_flush(mixer);
+	if (err < 0) {
+		if ((err != -ENODEV) && (err != -ESHUTDOWN))
+			scarlett2_config_save_schedule(mixer);
+		return;
 	}
 
-	ucontrol->value.enumerated.item[0] = private->air_switch[elem->control];
-	return 0;
+	/* The changes should be activated before they are saved */
+	scarlett2_activate_flush(mixer);
+
+	cmd = scarlett2_cmd_alloc(mixer->private_data);
+	if (!cmd)
+		return;
+
+	req = (__le32 *)cmd->req->data;
+	*req = cpu_to_le32(SCARLETT2_USB_CONFIG_SAVE);
+	scarlett2_usb_send(mixer, cmd, SCARLETT2_USB_DATA_CMD, sizeof(u32));
 }
 
-static int scarlett2_air_ctl_put(struct snd_kcontrol *kctl,
-				 struct snd_ctl_elem_value *ucontrol)
+/* Schedule the NVRAM save without waiting for the running one; every
+ * change restarts the quiet period until the maximum delay is reached
+ */
+static void scarlett2_config_save_schedule(struct usb_mixer_interface *mixer)
 {
-	struct usb_mixer_elem_info *elem = kctl->private_data;
-	struct usb_mixer_interface *mixer = elem->head.mixer;
 	struct scarlett2_mixer_data *private = mixer->private_data;
-	const struct scarlett2_device_info *info = private->info;
+	unsigned long flags, now = jiffies, deadline, delay;
 
-	int index = elem->control;
-	int oval, val, err = 0;
+	spin_lock_irqsave(&private->cmd_lock, flags);
 
-	mutex_lock(&private->data_mutex);
-	scarlett2_update_line_ctl_switches(mixer);
+	if (private->save_pending)
+		private->stat_save_coalesced++;
+	else {
+		private->save_pending = 1;
+		private->save_first = now;
+	}
 
-	oval = private->air_switch[index];
-	val = !!ucontrol->value.integer.value[0];
+	delay = msecs_to_jiffies(scarlett2_save_quiet_ms);
+	deadline = private->save_first + msecs_to_jiffies(scarlett2_save_max_delay_ms);
+	if (time_after(now + delay, deadline))
+		delay = (time_after(deadline, now)) ? deadline - now : 0;
 
-	if (oval == val)
-		goto unlock;
+	spin_unlock_irqrestore(&private->cmd_lock, flags);
 
-	private->air_switch[index] = val;
+	mod_delayed_work(private->wq, &private->work, delay);
+}
 
-	/* Air switches are present as bitmask? */
-	if (info->air_input_bitmask) {
-		val = 0;
-		for (index = 0; index < info->air_input_count; ++index)
-			val |= private->air_switch[index] << index;
-		index = 0;
-	}
+/* Delayed work to save config */
+static void scarlett2_config_save_work(struct work_struct *work)
+{
+	struct scarlett2_mixer_data *private =
+		container_of(work, struct scarlett2_mixer_data, work.work);
 
-	/* Send switch change to the device */
-	err = scarlett2_usb_set_config(mixer, SCARLETT2_CONFIG_AIR_SWITCH, index, val);
+	/* Rescheduled when the deferred commit mode is turned off */
+	if (READ_ONCE(private->deferred))
+		return;
 
-unlock:
-	mutex_unlock(&private->data_mutex);
-	return err;
+	scarlett2_config_save(private->mixer);
 }
 
-static const struct snd_kcontrol_new scarlett2_air_ctl = {
-	.iface = SNDRV_CTL_ELEM_IFACE_MIXER,
-	.name = "",
-	.info = scarlett2_bool_enum_ctl_info,
-	.get  = scarlett2_air_ctl_get,
-	.put  = scarlett2_air_ctl_put,
-};
+static void scarlett2_config_mirror_update(struct scarlett2_mixer_data *private,
+					  int offset, const void *data, int bytes);
+static int scarlett2_config_mirror_copy(struct scarlett2_mixer_data *private,
+					int offset, void *buf, int bytes);
+static int scarlett2_config_mirror_defer(struct scarlett2_mixer_data *private,
+					 int offset, const void *data, int bytes);
 
-/*** 48V Switch Controls ***/
-static int scarlett2_48v_ctl_get(struct snd_kcontrol *kctl,
-				 struct snd_ctl_elem_value *ucontrol)
+/* Send a set of USB messages to get configuration data; result placed in *data.
+ * Low priority reads are sent only when no other command is waiting.
+ */
+static int scarlett2_usb_get_prio(
+	struct usb_mixer_interface *mixer,
+	int offset, void *data, int bytes, bool low_prio)
 {
-	struct usb_mixer_elem_info *elem = kctl->private_data;
-	struct usb_mixer_interface *mixer = elem->head.mixer;
 	struct scarlett2_mixer_data *private = mixer->private_data;
+	struct {
+		__le32 offset;
+		__le32 size;
+	} __packed *req;
+	struct scarlett2_cmd *cmd;
+	u64 start, queued_at;
+	bool queued;
 
-	if (private->line_ctl_updated) {
-		mutex_lock(&private->data_mutex);
-		scarlett2_update_line_ctl_switches(mixer);
-		mutex_unlock(&private->data_mutex);
-	}
+	int i, chunk, err = 0;
+	u8 *buf = (u8 *)data;
 
-	ucontrol->value.enumerated.item[0] = private->pow_switch[elem->control];
-	return 0;
-}
+	/* Do not let other readers interleave with the chunks */
+	start = ktime_get_ns();
+	scarlett2_usb_lock(private);
 
-static int scarlett2_48v_ctl_put(struct snd_kcontrol *kctl,
-				 struct snd_ctl_elem_value *ucontrol)
-{
-	struct usb_mixer_elem_info *elem = kctl->private_data;
-	struct usb_mixer_interface *mixer = elem->head.mixer;
-	struct scarlett2_mixer_data *private = mixer->private_data;
-	const struct scarlett2_device_info *info = private->info;
+	/* Request the config space with fixed-size data chunks */
+	for (i=0; i<bytes; i += chunk) {
+		/* Compute the chunk size */
+		chunk = (bytes - i);
+		if (chunk > private->chunk_size)
+			chunk = private->chunk_size;
 
-	int index = elem->control;
-	int i, oval, val, err = 0;
+		/* Request yet another chunk, the response is copied directly to the destination */
+		cmd = scarlett2_cmd_alloc(private);
+		if (!cmd) {
+			err = -ENODEV;
+			break;
+		}
 
-	mutex_lock(&private->data_mutex);
-	scarlett2_update_line_ctl_switches(mixer);
-	oval = private->pow_switch[index];
-	val = !!ucontrol->value.integer.value[0];
+		req = (void *)cmd->req->data;
+		req->offset = cpu_to_le32(offset + i);
+		req->size   = cpu_to_le32(chunk);
+		cmd->low_prio = low_prio;
 
-	if (oval == val)
-		goto unlock;
+		queued_at = ktime_get_ns();
+		err = scarlett2_usb_wait(mixer, cmd, SCARLETT2_USB_GET_DATA, sizeof(*req), &buf[i], chunk, &queued);
+		if (!queued)
+			break;
 
-	private->pow_switch[index] = val;
+		trace_scarlett2_usb_get_chunk(le16_to_cpu(cmd->req->seq), offset + i, chunk, err,
+					      queued_at - start, ktime_get_ns() - queued_at);
+		scarlett2_cmd_release(private, cmd);
+		if (err < 0)
+			break;
 
-	val = 0;
-	for (i = 0; i < info->power_48v_count; ++i)
-		val |= (private->pow_switch[i] << i);
+		start = ktime_get_ns();
+	}
 
-	/* Send switch change to the device */
-	err = scarlett2_usb_set_config(mixer, SCARLETT2_CONFIG_48V_SWITCH, 0, val);
+	scarlett2_usb_unlock(private);
 
-unlock:
-	mutex_unlock(&private->data_mutex);
-	return err;
+	return (err < 0) ? err : 0;
 }
 
-static const struct snd_kcontrol_new scarlett2_48v_ctl = {
-	.iface = SNDRV_CTL_ELEM_IFACE_MIXER,
-	.name = "",
-	.info = scarlett2_bool_enum_ctl_info,
-	.get  = scarlett2_48v_ctl_get,
-	.put  = scarlett2_48v_ctl_put
-};
-
-/* Retain 48V Switch Control */
-static int scarlett2_retain48v_ctl_get(struct snd_kcontrol *kctl,
-				 struct snd_ctl_elem_value *ucontrol)
+/* Send a set of USB messages to get configuration data; result placed in *data */
+static int scarlett2_usb_get(
+	struct usb_mixer_interface *mixer,
+	int offset, void *data, int bytes)
 {
-	struct usb_mixer_elem_info *elem = kctl->private_data;
-	struct usb_mixer_interface *mixer = elem->head.mixer;
-	struct scarlett2_mixer_data *private = mixer->private_data;
-
-	ucontrol->value.enumerated.item[0] = private->retain48v_switch;
-	return 0;
+	return scarlett2_usb_get_prio(mixer, offset, data, bytes, false);
 }
 
-
-static int scarlett2_retain48v_ctl_put(struct snd_kcontrol *kctl,
-				 struct snd_ctl_elem_value *ucontrol)
+/* Send a set of USB messages to set configuration data */
+static int scarlett2_usb_set(
+	struct usb_mixer_interface *mixer,
+	int offset, const void *data, int bytes)
 {
-	struct usb_mixer_elem_info *elem = kctl->private_data;
-	struct usb_mixer_interface *mixer = elem->head.mixer;
 	struct scarlett2_mixer_data *private = mixer->private_data;
+	struct scarlett2_usb_set_data *req;
+	struct scarlett2_cmd *cmd;
+	int i, chunk, err = 0;
+	const u8 *buf = (const u8 *)data;
 
-	int oval, val, err = 0;
-
-	mutex_lock(&private->data_mutex);
-	scarlett2_update_line_ctl_switches(mixer);
-	oval = private->retain48v_switch;
-	val = !!ucontrol->value.integer.value[0];
+	/* Transfer the configuration with fixed-size data chunks; the larger
+	 * chunks probed with GET_DATA are not known to work for SET_DATA
+	 */
+	for (i=0; i<bytes; i += chunk) {
+		/* Compute the chunk size */
+		chunk = (bytes - i);
+		if (chunk > SCARLETT2_SW_CONFIG_PACKET_SIZE)
+			chunk = SCARLETT2_SW_CONFIG_PACKET_SIZE;
 
-	if (oval == val)
-		goto unlock;
+		/* Send yet another chunk of data, the data is copied directly into the packet */
+		cmd = scarlett2_cmd_alloc(private);
+		if (!cmd)
+			return -ENODEV;
 
-	private->retain48v_switch = val;
+		req = (void *)cmd->req->data;
+		req->offset = cpu_to_le32(offset + i);
+		req->size   = cpu_to_le32(chunk);
+		memcpy(req->data, &buf[i], chunk);
 
-	/* Send switch change to the device */
-	err = scarlett2_usb_set_config(mixer, SCARLETT2_CONFIG_RETAIN_48V, 0, val);
+		/* The chunk is traced on completion, see scarlett2_cmd_complete */
+		err = scarlett2_usb_send(mixer, cmd, SCARLETT2_USB_SET_DATA, chunk + sizeof(__le32)*2);
+		if (err < 0)
+			break;
+	}
 
-unlock:
-	mutex_unlock(&private->data_mutex);
 	return err;
 }
 
-static const struct snd_kcontrol_new scarlett2_retain48v_ctl = {
-	.iface = SNDRV_CTL_ELEM_IFACE_MIXER,
-	.name = "",
-	.info = scarlett2_bool_enum_ctl_info,
-	.get  = scarlett2_retain48v_ctl_get,
-	.put  = scarlett2_retain48v_ctl_put
+/* One item of the batched configuration write */
+struct scarlett2_config_write {
+	int item;                                                         /* SCARLETT2_CONFIG_* item */
+	int index;                                                        /* Index of the element */
+	int value;                                                        /* New value of the element */
 };
 
-/*** Mute/Dim Controls ***/
-
-static int scarlett2_button_ctl_get(struct snd_kcontrol *kctl,
-				    struct snd_ctl_elem_value *ucontrol)
+/* Config items holding the bytes of the range: a byte belongs to the
+ * item with the nearest offset at or below it, so the elements of the
+ * arrays and the padding behind an item go with the item; the bytes in
+ * front of all items need the whole mirror
+ */
+static u32 scarlett2_config_items_in(const struct scarlett2_device_info *info,
+				     int start, int end)
 {
-	struct usb_mixer_elem_info *elem = kctl->private_data;
-	struct usb_mixer_interface *mixer = elem->head.mixer;
-	struct scarlett2_mixer_data *private = mixer->private_data;
-
-	if (private->vol_updated) {
-		mutex_lock(&private->data_mutex);
-		scarlett2_update_volumes(mixer);
-		mutex_unlock(&private->data_mutex);
+	u32 items = 0;
+	int i, j, owner;
+
+	for (i = start; i < end; ++i) {
+		owner = -1;
+		for (j = 0; j < SCARLETT2_CONFIG_COUNT; ++j)
+			if ((info->config[j].size > 0) && (info->config[j].offset <= i) &&
+			    ((owner < 0) || (info->config[j].offset > info->config[owner].offset)))
+				owner = j;
+		items |= (owner < 0) ? SCARLETT2_CONFIG_ALL : BIT(owner);
 	}
 
-	ucontrol->value.enumerated.item[0] = private->buttons[elem->control];
-	return 0;
+	return items;
 }
 
-static int scarlett2_button_ctl_put(struct snd_kcontrol *kctl,
-				    struct snd_ctl_elem_value *ucontrol)
+/* Send USB messages to set several configuration parameters: the items
+ * are laid out in an image of the configuration space, each run of
+ * contiguous bytes goes with one SET_DATA and each distinct activation
+ * is sent once. Small gaps between the runs are filled with the mirrored
+ * contents when the items holding the gap are valid in the mirror, so
+ * they are rewritten with the same values.
+ */
+static int scarlett2_usb_set_config_multi(
+	struct usb_mixer_interface *mixer,
+	const struct scarlett2_config_write *writes, int num)
 {
-	struct usb_mixer_elem_info *elem = kctl->private_data;
-	struct usb_mixer_interface *mixer = elem->head.mixer;
 	struct scarlett2_mixer_data *private = mixer->private_data;
+	const struct scarlett2_device_info *info = private->info;
+	const struct scarlett2_config *config_item;
+	DECLARE_BITMAP(dirty, SCARLETT2_CONFIG_SPACE_MAX);
+	u8 image[SCARLETT2_CONFIG_SPACE_MAX];
+	unsigned long flags;
+	u32 activate = 0, valid, gap_items;
+	int i, offset, end, next, err;
+	__le32 data;
+
+	bitmap_zero(dirty, SCARLETT2_CONFIG_SPACE_MAX);
+
+	spin_lock_irqsave(&private->cfg_lock, flags);
+	valid = private->cfg_valid;
+	spin_unlock_irqrestore(&private->cfg_lock, flags);
+
+	for (i = 0; i < num; ++i) {
+		config_item = &info->config[writes[i].item];
+		offset = config_item->offset + writes[i].index * config_item->size;
+
+		if ((config_item->size <= 0) ||
+		    (offset + config_item->size > SCARLETT2_CONFIG_SPACE_MAX)) {
+			usb_audio_warn(mixer->chip, "There is no existing config item %d\n", writes[i].item);
+			return -EINVAL;
+		}
 
-	int index = elem->control;
-	int oval, val, err = 0;
-
-	mutex_lock(&private->data_mutex);
-	scarlett2_update_volumes(mixer);
+		data = cpu_to_le32(writes[i].value);
+		memcpy(&image[offset], &data, config_item->size);
+		bitmap_set(dirty, offset, config_item->size);
+		if (config_item->activate > 0)
+			activate |= BIT(config_item->activate);
+	}
 
-	oval = private->buttons[index];
-	val = !!ucontrol->value.integer.value[0];
+	/* Join the runs separated by small gaps */
+	for (offset = find_first_bit(dirty, SCARLETT2_CONFIG_SPACE_MAX);
+	     offset < SCARLETT2_CONFIG_SPACE_MAX;
+	     offset = next) {
+		end = find_next_zero_bit(dirty, SCARLETT2_CONFIG_SPACE_MAX, offset);
+		next = find_next_bit(dirty, SCARLETT2_CONFIG_SPACE_MAX, end);
+		if ((next >= SCARLETT2_CONFIG_SPACE_MAX) || (next - end > SCARLETT2_CONFIG_WRITE_GAP))
+			continue;
 
-	if (oval == val)
-		goto unlock;
+		gap_items = scarlett2_config_items_in(info, end, next);
+		if (((valid & gap_items) == gap_items) &&
+		    (scarlett2_config_mirror_copy(private, end, &image[end], next - end) >= 0))
+			bitmap_set(dirty, end, next - end);
+	}
 
-	private->buttons[index] = val;
+	/* In the deferred commit mode the data is kept in the mirror */
+	if (private->deferred) {
+		for (offset = find_first_bit(dirty, SCARLETT2_CONFIG_SPACE_MAX);
+		     offset < SCARLETT2_CONFIG_SPACE_MAX;
+		     offset = find_next_bit(dirty, SCARLETT2_CONFIG_SPACE_MAX, end)) {
+			end = find_next_zero_bit(dirty, SCARLETT2_CONFIG_SPACE_MAX, offset);
+			if (scarlett2_config_mirror_defer(private, offset, &image[offset], end - offset) >= 0)
+				continue;
 
-	/* Send switch change to the device */
-	err = scarlett2_usb_set_config(mixer, SCARLETT2_CONFIG_BUTTONS,
-				       index, val);
+			/* Not covered by the mirror, send it now */
+			err = scarlett2_usb_set(mixer, offset, &image[offset], end - offset);
+			if (err < 0)
+				return err;
+		}
 
-unlock:
-	mutex_unlock(&private->data_mutex);
-	return err;
-}
+		spin_lock_irqsave(&private->cfg_lock, flags);
+		private->cfg_deferred_activate |= activate;
+		spin_unlock_irqrestore(&private->cfg_lock, flags);
 
-static const struct snd_kcontrol_new scarlett2_button_ctl = {
-	.iface = SNDRV_CTL_ELEM_IFACE_MIXER,
-	.name = "",
-	.info = scarlett2_bool_enum_ctl_info,
-	.get  = scarlett2_button_ctl_get,
-	.put  = scarlett2_button_ctl_put
-};
+		/* The save work waits for the end of the mode, see
+		 * scarlett2_deferred_commit
+		 */
+		scarlett2_config_save_schedule(mixer);
+		return 0;
+	}
 
-/*** Mute for each output ***/
-static int scarlett2_mute_ctl_get(struct snd_kcontrol *kctl,
-				    struct snd_ctl_elem_value *ucontrol)
-{
-	struct usb_mixer_elem_info *elem = kctl->private_data;
-	struct usb_mixer_interface *mixer = elem->head.mixer;
-	struct scarlett2_mixer_data *private = mixer->private_data;
+	/* Send the configuration parameter data */
+	for (offset = find_first_bit(dirty, SCARLETT2_CONFIG_SPACE_MAX);
+	     offset < SCARLETT2_CONFIG_SPACE_MAX;
+	     offset = find_next_bit(dirty, SCARLETT2_CONFIG_SPACE_MAX, end)) {
+		end = find_next_zero_bit(dirty, SCARLETT2_CONFIG_SPACE_MAX, offset);
+		err = scarlett2_usb_set(mixer, offset, &image[offset], end - offset);
+		if (err < 0)
+			return err;
 
-	if (private->vol_updated) {
-		mutex_lock(&private->data_mutex);
-		scarlett2_update_volumes(mixer);
-		mutex_unlock(&private->data_mutex);
+		/* The mirror holds what has been written */
+		scarlett2_config_mirror_update(private, offset, &image[offset], end - offset);
 	}
 
-	ucontrol->value.enumerated.item[0] = ! private->mutes[elem->control];
+	/* Activate the changes */
+	for (i = 0; activate; ++i, activate >>= 1)
+		if (activate & 1)
+			scarlett2_activate(mixer, i);
+
+	/* Schedule the changes to be written to NVRAM */
+	scarlett2_config_save_schedule(mixer);
+
 	return 0;
 }
 
-static int scarlett2_mute_ctl_put(struct snd_kcontrol *kctl,
-				    struct snd_ctl_elem_value *ucontrol)
+/* Send a USB message to set a configuration parameter (volume level,
+ * sw/hw volume switch, line/inst level switch, pad, or air switch)
+ */
+static int scarlett2_usb_set_config(
+	struct usb_mixer_interface *mixer,
+	int config_item_num, int index, int value)
 {
-	struct usb_mixer_elem_info *elem = kctl->private_data;
-	struct usb_mixer_interface *mixer = elem->head.mixer;
+	struct scarlett2_config_write write = {
+		.item = config_item_num, .index = index, .value = value
+	};
+
+	return scarlett2_usb_set_config_multi(mixer, &write, 1);
+}
+
+/* Find the largest GET_DATA chunk the device accepts by reading from
+ * the start of the configuration space, present on every model, with
+ * decreasing sizes. Writes can not be probed safely, so SET_DATA keeps
+ * the packet size known to work for all devices.
+ */
+static void scarlett2_usb_probe_chunk_size(struct usb_mixer_interface *mixer)
+{
+	static const u16 sizes[] = {
+		SCARLETT2_USB_MAX_CHUNK, SCARLETT2_SW_CONFIG_PACKET_SIZE, 512, 256
+	};
 	struct scarlett2_mixer_data *private = mixer->private_data;
-	const struct scarlett2_device_info *info = private->info;
+	struct {
+		__le32 offset;
+		__le32 size;
+	} __packed *req;
+	struct scarlett2_cmd *cmd;
+	int i, err = -EINVAL;
+	u8 *buf;
 
-	int analog_outs = info->ports[SCARLETT2_PORT_TYPE_ANALOGUE].num[SCARLETT2_PORT_OUT];
-	int index = elem->control;
-	int oval, val, err = 0;
-	u32 mutes;
+	private->chunk_size = SCARLETT2_SW_CONFIG_PACKET_SIZE;
 
-	mutex_lock(&private->data_mutex);
-	scarlett2_update_volumes(mixer);
+	buf = kmalloc(SCARLETT2_USB_MAX_CHUNK, GFP_KERNEL);
+	if (!buf)
+		return;
 
-	oval = private->mutes[index];
-	val = !ucontrol->value.integer.value[0];
-	if (oval == val)
-		goto unlock;
+	for (i = 0; i < ARRAY_SIZE(sizes); ++i) {
+		cmd = scarlett2_cmd_alloc(private);
+		if (!cmd)
+			break;
 
-	private->mutes[index] = val;
+		req = (void *)cmd->req->data;
+		req->offset = cpu_to_le32(0);
+		req->size   = cpu_to_le32(sizes[i]);
 
-	/* Update mute controls */
-	if ((info->has_hw_volume) && (index < analog_outs)) {
-		/* Update state of hardware configuration */
-		err = scarlett2_usb_set_config(mixer, SCARLETT2_CONFIG_MUTES, index, val);
+		err = scarlett2_usb_exec(mixer, cmd, SCARLETT2_USB_GET_DATA, sizeof(*req), buf, sizes[i]);
+		if (err >= 0) {
+			private->chunk_size = sizes[i];
+			break;
+		}
 	}
-	else if ((info->has_mux) && (private->sw_cfg != NULL)) {
-		/* Set mute bit for the corresponding output */
-		mutes = le32_to_cpu(private->sw_cfg->mute_sw);
-		index = 1 << index;
-		mutes = (val) ? (mutes | index) : (mutes & (~index));
-		private->sw_cfg->mute_sw = cpu_to_le32(mutes);
 
-		/* Update software configuration */
-		err = scarlett2_commit_software_config(mixer, &private->sw_cfg->mute_sw, sizeof(__le32));
-		if (err < 0)
-			goto unlock;
+	kfree(buf);
 
-		/* Update MUX settings as it does the original software */
-		err = scarlett2_usb_set_mux(mixer);
-	}
-	else
-		err = -EINVAL;
+	if (err < 0)
+		usb_audio_warn(mixer->chip, "Failed to probe the data chunk size, using %d bytes\n",
+			       private->chunk_size);
+}
 
-unlock:
-	mutex_unlock(&private->data_mutex);
-	return err;
+/*** Config space mirror ***
+ *
+ * The hardware configuration area (0x00..0xb2 for the pro devices,
+ * the configuration space of the home devices) is read at once and
+ * kept in memory. Items which the device may change on its own are
+ * invalidated by the interrupt bits reporting the change and are read
+ * again on the next access; writes go through the mirror.
+ */
+
+/* Config items changed by the device, for each interrupt bit */
+#define SCARLETT2_VOL_CHANGE_ITEMS \
+	(SCARLETT2_CONFIG_BIT(LINE_OUT_VOLUME) | SCARLETT2_CONFIG_BIT(SW_HW_SWITCH) | \
+	 SCARLETT2_CONFIG_BIT(MUTES))
+#define SCARLETT2_LINE_CTL_CHANGE_ITEMS \
+	(SCARLETT2_CONFIG_BIT(LEVEL_SWITCH) | SCARLETT2_CONFIG_BIT(PAD_SWITCH) | \
+	 SCARLETT2_CONFIG_BIT(AIR_SWITCH) | SCARLETT2_CONFIG_BIT(48V_SWITCH) | \
+	 SCARLETT2_CONFIG_BIT(RETAIN_48V) | SCARLETT2_CONFIG_BIT(DIRECT_MONITOR_SWITCH))
+#define SCARLETT2_BUTTON_CHANGE_ITEMS \
+	(SCARLETT2_CONFIG_BIT(BUTTONS) | SCARLETT2_CONFIG_BIT(MUTES))
+#define SCARLETT2_SPEAKER_CHANGE_ITEMS \
+	(SCARLETT2_CONFIG_BIT(MAIN_ALT_SPEAKER_SWITCH) | \
+	 SCARLETT2_CONFIG_BIT(SPEAKER_SWITCHING_SWITCH) | \
+	 SCARLETT2_CONFIG_BIT(MIX_TALKBACK) | \
+	 SCARLETT2_VOL_CHANGE_ITEMS | SCARLETT2_BUTTON_CHANGE_ITEMS)
+
+/* Interrupt bits which do not change the configuration */
+#define SCARLETT2_INTERRUPT_NO_CONFIG \
+	(SCARLETT2_USB_INTERRUPT_ACK | SCARLETT2_USB_INTERRUPT_SYNC_CHANGE)
+
+/* The shared copies are being changed; called with cfg_lock held */
+static void scarlett2_shm_begin(struct scarlett2_mixer_data *private)
+{
+	WRITE_ONCE(private->shm->seq, private->shm->seq + 1);
+	smp_wmb();
 }
 
-static const struct snd_kcontrol_new scarlett2_mute_ctl = {
-	.iface = SNDRV_CTL_ELEM_IFACE_MIXER,
-	.name = "",
-	.info = snd_ctl_boolean_mono_info,
-	.get  = scarlett2_mute_ctl_get,
-	.put  = scarlett2_mute_ctl_put
-};
+/* The shared copies have been changed; called with cfg_lock held */
+static void scarlett2_shm_end(struct scarlett2_mixer_data *private)
+{
+	smp_wmb();
+	WRITE_ONCE(private->shm->seq, private->shm->seq + 1);
+}
 
-static int scarlett2_add_mute_ctls(struct usb_mixer_interface *mixer)
+/* Publish whether the copy misses changes made by the device; called
+ * with cfg_lock held between scarlett2_shm_begin() and scarlett2_shm_end()
+ */
+static void scarlett2_shm_cfg_state(struct scarlett2_mixer_data *private)
+{
+	private->shm->cfg_stale = (private->cfg_valid != SCARLETT2_CONFIG_ALL) ? 1 : 0;
+}
+
+/* Compute the size of the configuration area of the device */
+static void scarlett2_config_mirror_init(struct scarlett2_mixer_data *private)
 {
-	struct scarlett2_mixer_data *private = mixer->private_data;
 	const struct scarlett2_device_info *info = private->info;
-	char s[SNDRV_CTL_ELEM_ID_NAME_MAXLEN];
-	u8 hw_mutes[SCARLETT2_ANALOGUE_OUT_MAX];
-	u32 sw_mutes;
+	int i, end = info->config_size;
 
-	int num_line_out  = info->ports[SCARLETT2_PORT_TYPE_ANALOGUE].num[SCARLETT2_PORT_OUT];
-	int num_spdif_out = info->ports[SCARLETT2_PORT_TYPE_SPDIF].num[SCARLETT2_PORT_OUT];
-	int num_adat_out  = info->ports[SCARLETT2_PORT_TYPE_ADAT].num[SCARLETT2_PORT_OUT];
-	int err, i, port, index = 0;
+	for (i = 0; i < SCARLETT2_CONFIG_COUNT; ++i)
+		if (info->config[i].size > 0)
+			end = max(end, info->config[i].offset + info->config[i].size);
 
-	/* Add mutes for line outputs */
-	if (info->has_hw_volume) {
-		/* Read hardware state of mutes */
-		err = scarlett2_usb_get_config(mixer, SCARLETT2_CONFIG_MUTES, num_line_out, hw_mutes);
-		if (err < 0)
-			return err;
+	spin_lock_init(&private->cfg_lock);
+	private->cfg_mirror_size = min(end, SCARLETT2_CONFIG_MIRROR_MAX);
+	private->cfg_valid = 0;
+	scarlett2_shm_cfg_state(private);
+}
 
-		for (i=0; i<num_line_out; ++i, ++index) {
-			/* Read hardware mute settings */
-			private->mutes[index] = !! hw_mutes[i];
+/* Mark the items changed by the device as invalid and schedule reading
+ * them again; may be called from the interrupt handler
+ */
+static void scarlett2_config_mirror_invalidate(struct scarlett2_mixer_data *private, u32 data)
+{
+	unsigned long flags;
+	u32 items = 0;
+
+	if (data & SCARLETT2_USB_INTERRUPT_VOL_CHANGE)
+		items |= SCARLETT2_VOL_CHANGE_ITEMS;
+	if (data & SCARLETT2_USB_INTERRUPT_LINE_CTL_CHANGE)
+		items |= SCARLETT2_LINE_CTL_CHANGE_ITEMS;
+	if (data & SCARLETT2_USB_INTERRUPT_BUTTON_CHANGE)
+		items |= SCARLETT2_BUTTON_CHANGE_ITEMS;
+	if (data & SCARLETT2_USB_INTERRUPT_SPEAKER_CHANGE)
+		items |= SCARLETT2_SPEAKER_CHANGE_ITEMS;
+
+	/* Nobody knows what the other bits change */
+	if (data & ~(SCARLETT2_INTERRUPT_NO_CONFIG | SCARLETT2_USB_INTERRUPT_VOL_CHANGE |
+		     SCARLETT2_USB_INTERRUPT_LINE_CTL_CHANGE | SCARLETT2_USB_INTERRUPT_BUTTON_CHANGE |
+		     SCARLETT2_USB_INTERRUPT_SPEAKER_CHANGE))
+		items = SCARLETT2_CONFIG_ALL;
 
-			/* Format the mute switch name */
-			port = scarlett2_get_port_num(info->ports, SCARLETT2_PORT_OUT, SCARLETT2_PORT_TYPE_ANALOGUE, i);
-			scarlett2_fmt_port_name(s, SNDRV_CTL_ELEM_ID_NAME_MAXLEN, "%s Mute", info, SCARLETT2_PORT_OUT, port);
+	if (!items)
+		return;
 
-			/* Add port to list */
-			err = scarlett2_add_new_ctl(mixer,
-					    &scarlett2_mute_ctl,
-					    index, 1, s, &private->mute_ctls[index]);
-			if (err < 0)
-				return err;
-		}
-	}
+	spin_lock_irqsave(&private->cfg_lock, flags);
+	scarlett2_shm_begin(private);
+	private->cfg_valid &= ~items;
+	private->cfg_inval_count++;
+	scarlett2_shm_cfg_state(private);
+	scarlett2_shm_end(private);
+	spin_unlock_irqrestore(&private->cfg_lock, flags);
 
-	/* Software mutes */
-	if (info->has_mux && private->sw_cfg) {
-		/* Read state of mutes from software config */
-		sw_mutes = le32_to_cpu(private->sw_cfg->mute_sw);
+	queue_work(private->wq, &private->cfg_refresh_work);
+}
 
-		/* Add mutes for S/PDIF outputs */
-		for (i=0; i<num_spdif_out; ++i, ++index) {
-			/* Read software mute settings */
-			private->mutes[index] = !! (sw_mutes & (1 << index));
+/* Store the data written to the device */
+static void scarlett2_config_mirror_update(struct scarlett2_mixer_data *private,
+					  int offset, const void *data, int bytes)
+{
+	unsigned long flags;
 
-			/* Format the mute switch name */
-			port = scarlett2_get_port_num(info->ports, SCARLETT2_PORT_OUT, SCARLETT2_PORT_TYPE_SPDIF, i);
-			scarlett2_fmt_port_name(s, SNDRV_CTL_ELEM_ID_NAME_MAXLEN, "%s Mute", info, SCARLETT2_PORT_OUT, port);
+	if (offset + bytes > private->cfg_mirror_size)
+		return;
 
-			/* Add port to list */
-			err = scarlett2_add_new_ctl(mixer,
-					    &scarlett2_mute_ctl,
-					    index, 1, s, &private->mute_ctls[index]);
-			if (err < 0)
-				return err;
-		}
+	spin_lock_irqsave(&private->cfg_lock, flags);
+	scarlett2_shm_begin(private);
+	memcpy(&private->cfg_mirror[offset], data, bytes);
+	scarlett2_shm_end(private);
+	spin_unlock_irqrestore(&private->cfg_lock, flags);
+}
 
-		/* Add mutes for ADAT outputs */
-		for (i=0; i<num_adat_out; ++i, ++index) {
-			/* Read software mute settings */
-			private->mutes[index] = !! (sw_mutes & (1 << index));
+/* Read the range into the mirror and mark the items as valid unless
+ * the device has reported a change meanwhile
+ */
+static int scarlett2_config_mirror_read(struct usb_mixer_interface *mixer,
+					int offset, int bytes, u32 items, bool low_prio)
+{
+	struct scarlett2_mixer_data *private = mixer->private_data;
+	u8 buf[SCARLETT2_CONFIG_MIRROR_MAX];
+	unsigned long flags;
+	u32 inval_count;
+	int i, err;
 
-			/* Format the mute switch name */
-			port = scarlett2_get_port_num(info->ports, SCARLETT2_PORT_OUT, SCARLETT2_PORT_TYPE_ADAT, i);
-			scarlett2_fmt_port_name(s, SNDRV_CTL_ELEM_ID_NAME_MAXLEN, "%s Mute", info, SCARLETT2_PORT_OUT, port);
+	spin_lock_irqsave(&private->cfg_lock, flags);
+	inval_count = private->cfg_inval_count;
+	spin_unlock_irqrestore(&private->cfg_lock, flags);
 
-			/* Add port to list */
-			err = scarlett2_add_new_ctl(mixer,
-						    &scarlett2_mute_ctl,
-						    index, 1, s, &private->mute_ctls[index]);
-			if (err < 0)
-				return err;
-		}
+	err = scarlett2_usb_get_prio(mixer, offset, buf, bytes, low_prio);
+	if (err < 0)
+		return err;
+
+	spin_lock_irqsave(&private->cfg_lock, flags);
+	scarlett2_shm_begin(private);
+	if (bitmap_empty(private->cfg_deferred, SCARLETT2_CONFIG_MIRROR_MAX))
+		memcpy(&private->cfg_mirror[offset], buf, bytes);
+	else {
+		/* The bytes held back by the deferred commit are newer */
+		for (i = 0; i < bytes; ++i)
+			if (!test_bit(offset + i, private->cfg_deferred))
+				private->cfg_mirror[offset + i] = buf[i];
 	}
+	if (private->cfg_inval_count == inval_count)
+		private->cfg_valid |= items;
+	scarlett2_shm_cfg_state(private);
+	scarlett2_shm_end(private);
+	spin_unlock_irqrestore(&private->cfg_lock, flags);
 
 	return 0;
 }
 
-/*** Create the analogue output controls ***/
-static int scarlett2_add_line_out_ctls(struct usb_mixer_interface *mixer)
+/* Fill the whole mirror with one read */
+static int scarlett2_config_mirror_fill(struct usb_mixer_interface *mixer)
+{
+	struct scarlett2_mixer_data *private = mixer->private_data;
+
+	return scarlett2_config_mirror_read(mixer, 0, private->cfg_mirror_size,
+					    SCARLETT2_CONFIG_ALL, false);
+}
+
+/* Read the mirror again after the device has changed it, so the shared
+ * copy follows the device without waiting for a control to be read;
+ * interrupts arriving before the work runs are served by one read
+ */
+static void scarlett2_config_refresh_work(struct work_struct *work)
+{
+	struct scarlett2_mixer_data *private =
+		container_of(work, struct scarlett2_mixer_data, cfg_refresh_work);
+	unsigned long flags;
+	u32 valid;
+	int err;
+
+	spin_lock_irqsave(&private->cfg_lock, flags);
+	valid = private->cfg_valid;
+	spin_unlock_irqrestore(&private->cfg_lock, flags);
+	if (valid == SCARLETT2_CONFIG_ALL)
+		return;
+
+	err = scarlett2_config_mirror_fill(private->mixer);
+	if (err < 0)
+		usb_audio_warn(private->mixer->chip, "Failed to refresh the configuration copy: %d", err);
+}
+
+/* Keep the data written in the deferred commit mode in the mirror */
+static int scarlett2_config_mirror_defer(struct scarlett2_mixer_data *private,
+					 int offset, const void *data, int bytes)
+{
+	unsigned long flags;
+
+	if (offset + bytes > private->cfg_mirror_size)
+		return -ERANGE;
+
+	spin_lock_irqsave(&private->cfg_lock, flags);
+	scarlett2_shm_begin(private);
+	memcpy(&private->cfg_mirror[offset], data, bytes);
+	bitmap_set(private->cfg_deferred, offset, bytes);
+	scarlett2_shm_end(private);
+	spin_unlock_irqrestore(&private->cfg_lock, flags);
+
+	return 0;
+}
+
+/* Copy the range of the mirror; fails if the mirror does not cover it */
+static int scarlett2_config_mirror_copy(struct scarlett2_mixer_data *private,
+					int offset, void *buf, int bytes)
+{
+	unsigned long flags;
+
+	if (offset + bytes > private->cfg_mirror_size)
+		return -ERANGE;
+
+	spin_lock_irqsave(&private->cfg_lock, flags);
+	memcpy(buf, &private->cfg_mirror[offset], bytes);
+	spin_unlock_irqrestore(&private->cfg_lock, flags);
+
+	return 0;
+}
+
+/* One item of the batched configuration read */
+struct scarlett2_config_req {
+	int item;                                                         /* SCARLETT2_CONFIG_* item */
+	int count;                                                        /* Number of elements to read */
+	void *buf;                                                        /* Where to store the elements */
+};
+
+/* Range of the configuration area read with one request */
+struct scarlett2_config_range {
+	int start;                                                        /* Offset of the first byte */
+	int end;                                                          /* Offset after the last byte */
+	u32 items;                                                        /* Config items covered by the range */
+};
+
+/* Send USB messages to get several configuration items. Items missing
+ * in the mirror are sorted by offset and joined into as few ranged
+ * reads as the chunk size allows, then all items are copied from the
+ * mirror.
+ */
+static int scarlett2_usb_get_config_multi(
+	struct usb_mixer_interface *mixer,
+	const struct scarlett2_config_req *reqs, int num)
 {
 	struct scarlett2_mixer_data *private = mixer->private_data;
 	const struct scarlett2_device_info *info = private->info;
-	const struct scarlett2_ports *ports = info->ports;
-	int num_line_out = ports[SCARLETT2_PORT_TYPE_ANALOGUE].num[SCARLETT2_PORT_OUT];
-	int err, i, port;
-	s16 level;
-	char s[SNDRV_CTL_ELEM_ID_NAME_MAXLEN];
+	struct scarlett2_config_range ranges[SCARLETT2_CONFIG_COUNT], r;
+	const struct scarlett2_config *config_item;
+	int i, j, offset, bytes, nranges = 0, hits = 0, err;
+	unsigned long flags;
+	u32 valid;
 
-	/* Add R/O HW volume control */
-	if (info->line_out_hw_vol) {
-		snprintf(s, sizeof(s), "Master Playback Volume");
-		err = scarlett2_add_new_ctl(mixer,
-					    &scarlett2_master_volume_ctl,
-					    0, 1, s, &private->master_vol_ctl);
-		if (err < 0)
-			return err;
-	}
+	if (num > SCARLETT2_CONFIG_COUNT)
+		return -EINVAL;
 
-	/* Add volume controls */
-	if (info->has_hw_volume) {
-		for (i = 0; i < num_line_out; i++) {
-			/* Volume Fader */
-			port = scarlett2_get_port_num(info->ports, SCARLETT2_PORT_OUT, SCARLETT2_PORT_TYPE_ANALOGUE, i);
-			scarlett2_fmt_port_name(s, SNDRV_CTL_ELEM_ID_NAME_MAXLEN, "%s Volume", info, SCARLETT2_PORT_OUT, port);
-			err = scarlett2_add_new_ctl(mixer,
-					    &scarlett2_line_out_volume_ctl,
-					    i, 1, s, &private->vol_ctls[i]);
+	spin_lock_irqsave(&private->cfg_lock, flags);
+	valid = private->cfg_valid;
+	spin_unlock_irqrestore(&private->cfg_lock, flags);
+
+	/* Collect the ranges which have to be read, sorted by offset */
+	for (i = 0; i < num; ++i) {
+		config_item = &info->config[reqs[i].item];
+
+		/* No such configuration entry? */
+		if (config_item->size <= 0) {
+			usb_audio_warn(mixer->chip, "Configuration item #%d was not found\n", reqs[i].item);
+			return -EINVAL;
+		}
+
+		offset = config_item->offset;
+		bytes = config_item->size * reqs[i].count;
+		if (offset + bytes > private->cfg_mirror_size) {
+			err = scarlett2_usb_get(mixer, offset, reqs[i].buf, bytes);
 			if (err < 0)
 				return err;
+			continue;
+		}
 
-			/* Initialize the value with software configuration
-			 * Make the fader read-only if the SW/HW switch is set to HW
-			 */
-			if ((private->sw_cfg) && (!private->vol_sw_hw_switch[i])) {
-				level  = le16_to_cpu(private->sw_cfg->volume[i].volume);
-				private->vol[i] = clamp(level + SCARLETT2_VOLUME_BIAS, 0, SCARLETT2_VOLUME_BIAS);
-				private->vol_ctls[i]->vd[0].access |= SNDRV_CTL_ELEM_ACCESS_WRITE;
-			}
-			else {
-				private->vol[i] = private->master_vol;
-				private->vol_ctls[i]->vd[0].access &= ~SNDRV_CTL_ELEM_ACCESS_WRITE;
-			}
-
-			/* SW/HW Switch */
-			if (info->line_out_hw_vol) {
-				scarlett2_fmt_port_name(s, SNDRV_CTL_ELEM_ID_NAME_MAXLEN, "%s Control", info, SCARLETT2_PORT_OUT, port);
-				err = scarlett2_add_new_ctl(mixer,
-							    &scarlett2_sw_hw_enum_ctl,
-							    i, 1, s, NULL);
-				if (err < 0)
-					return err;
-			}
+		if (valid & BIT(reqs[i].item)) {
+			hits++;
+			continue;
 		}
+
+		r.start = offset;
+		r.end = offset + bytes;
+		r.items = BIT(reqs[i].item);
+		for (j = nranges++; (j > 0) && (ranges[j-1].start > r.start); --j)
+			ranges[j] = ranges[j-1];
+		ranges[j] = r;
 	}
 
-	/* Add HW button controls */
-	for (i = 0; i < private->info->button_count; i++) {
-		err = scarlett2_add_new_ctl(mixer, &scarlett2_button_ctl,
-					    i, 1, scarlett2_button_names[i],
-					    &private->button_ctls[i]);
+	/* Join the neighbour ranges while they fit into one request */
+	for (i = 0, j = 0; i < nranges; ++i) {
+		if ((j > 0) && (max(ranges[j-1].end, ranges[i].end) - ranges[j-1].start <= private->chunk_size)) {
+			ranges[j-1].end = max(ranges[j-1].end, ranges[i].end);
+			ranges[j-1].items |= ranges[i].items;
+		} else
+			ranges[j++] = ranges[i];
+	}
+	nranges = j;
+
+	for (i = 0; i < nranges; ++i) {
+		err = scarlett2_config_mirror_read(mixer, ranges[i].start,
+						   ranges[i].end - ranges[i].start, ranges[i].items, false);
 		if (err < 0)
 			return err;
 	}
 
-	/* Commit actual volumes */
-	if (private->sw_cfg) {
-		for (i = 0; i < num_line_out; i++) {
-			err = scarlett2_usb_set_config(mixer, SCARLETT2_CONFIG_LINE_OUT_VOLUME,
-			                               i, private->vol[i] - SCARLETT2_VOLUME_BIAS);
-			if (err < 0)
-				return err;
-		}
+	/* Decode the items from the mirror */
+	spin_lock_irqsave(&private->cfg_lock, flags);
+	private->stat_cfg_hits += hits;
+	private->stat_cfg_misses += num - hits;
+	for (i = 0; i < num; ++i) {
+		config_item = &info->config[reqs[i].item];
+		offset = config_item->offset;
+		bytes = config_item->size * reqs[i].count;
+		if (offset + bytes <= private->cfg_mirror_size)
+			memcpy(reqs[i].buf, &private->cfg_mirror[offset], bytes);
 	}
+	spin_unlock_irqrestore(&private->cfg_lock, flags);
 
-	return err;
+	return 0;
 }
 
-/*** Create the analogue input controls ***/
-static int scarlett2_add_line_in_ctls(struct usb_mixer_interface *mixer)
+/* Send a USB message to get configuration parameters; result placed in *buf */
+static int scarlett2_usb_get_config(
+	struct usb_mixer_interface *mixer,
+	int config_item_num, int count, void *buf)
+{
+	struct scarlett2_config_req req = {
+		.item = config_item_num, .count = count, .buf = buf
+	};
+
+	return scarlett2_usb_get_config_multi(mixer, &req, 1);
+}
+
+/* Get the volume status; result placed in *buf. The status is decoded
+ * from the mirror, which keeps the values held back by the deferred
+ * commit mode, and the mirror is read again only after the device has
+ * reported a change.
+ */
+static int scarlett2_usb_get_volume_status(
+	struct usb_mixer_interface *mixer,
+	struct scarlett2_usb_volume_status *buf)
 {
 	struct scarlett2_mixer_data *private = mixer->private_data;
-	const struct scarlett2_device_info *info = private->info;
-	int err, i, port;
-	char s[SNDRV_CTL_ELEM_ID_NAME_MAXLEN];
+	const int bytes = offsetof(struct scarlett2_usb_volume_status, pad4);
+	const u32 items = SCARLETT2_VOL_CHANGE_ITEMS | SCARLETT2_BUTTON_CHANGE_ITEMS;
+	unsigned long flags;
+	u32 valid;
+	int err;
 
-	/* Add input level (line/inst) controls */
-	for (i = 0; i < info->level_input_count; i++) {
-		port = scarlett2_get_port_num(info->ports, SCARLETT2_PORT_OUT, SCARLETT2_PORT_TYPE_ANALOGUE, i + info->level_input_offset);
-		scarlett2_fmt_port_name(s, SNDRV_CTL_ELEM_ID_NAME_MAXLEN, "%s Mode Switch", info, SCARLETT2_PORT_IN, port);
-		err = scarlett2_add_new_ctl(mixer, &scarlett2_level_enum_ctl,
-					    i, 1, s, &private->level_ctls[i]);
-		if (err < 0)
-			return err;
-	}
+	if (bytes > private->cfg_mirror_size)
+		return scarlett2_usb_get_prio(mixer, 0, buf, sizeof(*buf), true);
 
-	/* Add input pad controls */
-	for (i = 0; i < info->pad_input_count; i++) {
-		port = scarlett2_get_port_num(info->ports, SCARLETT2_PORT_OUT, SCARLETT2_PORT_TYPE_ANALOGUE, i);
-		scarlett2_fmt_port_name(s, SNDRV_CTL_ELEM_ID_NAME_MAXLEN, "%s Pad Switch", info, SCARLETT2_PORT_IN, port);
+	spin_lock_irqsave(&private->cfg_lock, flags);
+	valid = private->cfg_valid;
+	spin_unlock_irqrestore(&private->cfg_lock, flags);
 
-		err = scarlett2_add_new_ctl(mixer, &scarlett2_pad_ctl,
-					    i, 1, s, &private->pad_ctls[i]);
+	if ((valid & items) != items) {
+		err = scarlett2_config_mirror_read(mixer, 0, bytes, items, true);
 		if (err < 0)
 			return err;
 	}
 
-	/* Add input air controls */
-	for (i = 0; i < info->air_input_count; i++) {
-		port = scarlett2_get_port_num(info->ports, SCARLETT2_PORT_OUT, SCARLETT2_PORT_TYPE_ANALOGUE, i);
-		scarlett2_fmt_port_name(s, SNDRV_CTL_ELEM_ID_NAME_MAXLEN, "%s Air Switch", info, SCARLETT2_PORT_IN, port);
+	memset(buf, 0, sizeof(*buf));
+	return scarlett2_config_mirror_copy(private, 0, buf, bytes);
+}
 
-		err = scarlett2_add_new_ctl(mixer, &scarlett2_air_ctl,
-					    i, 1, s, &private->air_ctls[i]);
-		if (err < 0)
-			return err;
-	}
+/* Send a USB message to set the volumes for all inputs of one mix
+ * (values obtained from private->mix[])
+ */
+static int scarlett2_usb_set_mix(struct usb_mixer_interface *mixer,
+				     int mix_num)
+{
+	struct scarlett2_mixer_data *private = mixer->private_data;
+	const struct scarlett2_device_info *info = private->info;
 
-	/* Add input 48v controls */
-	for (i = 0; i < info->power_48v_count; i++) {
-		if (info->power_48v_count > 1)
-			snprintf(s, sizeof(s), "Analogue In 48V Switch %d", i + 1);
-		else
-			snprintf(s, sizeof(s), "Analogue In 48V Switch");
-		err = scarlett2_add_new_ctl(mixer, &scarlett2_48v_ctl,
-					    i, 1, s, &private->pow_ctls[i]);
-		if (err < 0)
-			return err;
+	struct {
+		__le16 mix_num;
+		__le16 data[SCARLETT2_INPUT_MIX_MAX + 1]; /* 1 additional output for talkback */
+	} __packed *req;
+	struct scarlett2_cmd *cmd;
+
+	int i, j;
+	int num_mixer_in = info->ports[SCARLETT2_PORT_TYPE_MIX].num[SCARLETT2_PORT_OUT];
+	int volume;
+
+	/* Sent when the deferred commit mode is turned off */
+	if (private->deferred) {
+		private->deferred_mix |= BIT(mix_num);
+		return 0;
 	}
 
-	/* Add 'Retain 48v' control */
-	if (info->has_retain48v) {
-		err = scarlett2_add_new_ctl(mixer, &scarlett2_retain48v_ctl,
-					    0, 1, "Analogue In 48V Retain", NULL);
-		if (err < 0)
-			return err;
+	cmd = scarlett2_cmd_alloc(private);
+	if (!cmd)
+		return -ENODEV;
+
+	req = (void *)cmd->req->data;
+	req->mix_num = cpu_to_le16(mix_num);
+
+	for (i = 0, j = mix_num * num_mixer_in; i < num_mixer_in; i++, j++) {
+		volume = (private->mix_mutes[j]) ? 0 : private->mix[j]; /* Apply mute control */
+		req->data[i] = cpu_to_le16(scarlett2_mixer_values[volume]);
 	}
 
-	return 0;
+	if (info->has_talkback)
+		req->data[num_mixer_in++] = cpu_to_le16(0x2000);
+
+	return scarlett2_usb_send(mixer, cmd, SCARLETT2_USB_SET_MIX,
+				  num_mixer_in * sizeof(__le16) + sizeof(__le16));
 }
 
-/*** Create the Gain Halo controls ***/
-static int scarlett2_add_ghalo_ctls(struct usb_mixer_interface *mixer)
+/* Send USB messages to get mux inputs */
+static int scarlett2_usb_get_mux(struct usb_mixer_interface *mixer)
 {
 	struct scarlett2_mixer_data *private = mixer->private_data;
 	const struct scarlett2_device_info *info = private->info;
-	int err, i, val;
-	char s[SNDRV_CTL_ELEM_ID_NAME_MAXLEN];
-	u8 ghalo_flag, ghalo_leds[SCARLETT2_GAIN_HALO_LEDS_MAX], ghalo_levels[SCARLETT2_GAIN_HALO_LEVELS];
-	static const char * const level_names[SCARLETT2_GAIN_HALO_LEVELS] = {
-		"LED Clip Color",
-		"LED Pre-Clip Color",
-		"LED Good Color"
-	};
+	const struct scarlett2_ports *ports = info->ports;
+	int mux_size, i, src_port, dst_port, err;
+	u32 mux_id;
+	struct {
+		__le16 num;
+		__le16 count;
+	} __packed req;
 
-	/* Check that device supports gain halos */
-	if (info->gain_halos_count <= 0)
-		return 0;
+	__le32 data[SCARLETT2_MUX_MAX];
 
-	/* Read custom color settings and add control */
-	err = scarlett2_usb_get_config(mixer, SCARLETT2_CONFIG_GAIN_HALO_ENABLE, 1, &ghalo_flag);
-	if (err < 0)
-		return err;
+	mux_size  = info->mux_size[SCARLETT2_PORT_OUT];
 
-	private->ghalo_custom = (ghalo_flag == 0x02);
-	err = scarlett2_add_new_ctl(mixer, &scarlett2_ghalo_custom_ctl, 0, 1, "LED Custom Colors", NULL);
+	/* Send the request */
+	req.num   = 0;
+	req.count = cpu_to_le16(mux_size);
+	err = scarlett2_usb(mixer, SCARLETT2_USB_GET_MUX, &req, 2 * sizeof(__le16), data, sizeof(__le32) * mux_size);
 	if (err < 0)
 		return err;
 
-	/* Read state of level colors and add controls */
-	err = scarlett2_usb_get_config(mixer, SCARLETT2_CONFIG_GAIN_HALO_LEVELS, SCARLETT2_GAIN_HALO_LEVELS, ghalo_levels);
-	if (err < 0)
-		return err;
+	/* Clear mux state */
+	for (i=0 ; i < SCARLETT2_MUX_MAX; ++i)
+		private->mux[i] = 0;
 
-	for (i = 0; i < SCARLETT2_GAIN_HALO_LEVELS; i++) {
-		val = ghalo_levels[i];
-		private->ghalo_levels[i] = clamp(val, 0, 7);
-		err = scarlett2_add_new_ctl(mixer, &scarlett2_ghalo_level_ctl, i, 1, level_names[i], NULL);
-		if (err < 0)
-			return err;
+	for (i=0; i<mux_size; ++i) {
+		/* Decode input and output port indexes, remember mux state for the port */
+		mux_id = le32_to_cpu(data[i]);
+		src_port = scarlett2_mux_to_id(ports, SCARLETT2_PORT_IN, mux_id >> 12);
+		dst_port = scarlett2_mux_to_id(ports, SCARLETT2_PORT_OUT, mux_id);
+		if ((dst_port >= 0) && (dst_port < SCARLETT2_MUX_MAX))
+			private->mux[dst_port] = src_port;
 	}
 
-	/* Read state of custom colors and add controls */
-	err = scarlett2_usb_get_config(mixer, SCARLETT2_CONFIG_GAIN_HALO_LEDS, info->gain_halos_count, ghalo_leds);
-	if (err < 0)
-		return err;
+	return err;
+}
 
-	for (i = 0; i<info->gain_halos_count; ++i) {
-		val = ghalo_leds[i];
-		private->ghalo_leds[i] = clamp(val, 0, 7);
+/* Send USB messages to set mux inputs */
+static int scarlett2_usb_set_mux(struct usb_mixer_interface *mixer)
+{
+	struct scarlett2_mixer_data *private = mixer->private_data;
+	const struct scarlett2_device_info *info = private->info;
+	const struct scarlett2_ports *ports = info->ports;
+	int direction, conn_id, order, port, port_idx, err = 0;
+	int mute_idx;
+	u32 src_mux, dst_mux;
 
-		snprintf(s, SNDRV_CTL_ELEM_ID_NAME_MAXLEN, "LED %d Custom Color", i);
-		err = scarlett2_add_new_ctl(mixer, &scarlett2_ghalo_led_ctl, i, 1, s, NULL);
-		if (err < 0)
-			return err;
+	static const int assignment_order[] = {
+		SCARLETT2_PORT_TYPE_PCM,
+		SCARLETT2_PORT_TYPE_ANALOGUE,
+		SCARLETT2_PORT_TYPE_SPDIF,
+		SCARLETT2_PORT_TYPE_ADAT,
+		SCARLETT2_PORT_TYPE_MIX,
+		SCARLETT2_PORT_TYPE_TALKBACK
+	};
+
+	struct {
+		__le16 pad;
+		__le16 num;
+		__le32 data[SCARLETT2_MUX_MAX];
+	} __packed *req;
+	struct scarlett2_cmd *cmd;
+
+	/* Sent when the deferred commit mode is turned off */
+	if (private->deferred) {
+		private->deferred_mux = 1;
+		return 0;
 	}
 
-	return 0;
-}
+	/* Sync mutes if required */
+	scarlett2_update_volumes(mixer);
 
-/*** Mixer Volume Controls ***/
-static int scarlett2_mixer_ctl_info(struct snd_kcontrol *kctl,
-				    struct snd_ctl_elem_info *uinfo)
-{
-	struct usb_mixer_elem_info *elem = kctl->private_data;
+	/* mux settings for each rate */
+	for (direction = SCARLETT2_PORT_OUT_44; direction <= SCARLETT2_PORT_OUT_176; ++direction) {
+		cmd = scarlett2_cmd_alloc(private);
+		if (!cmd)
+			return -ENODEV;
 
-	uinfo->type = SNDRV_CTL_ELEM_TYPE_INTEGER;
-	uinfo->count = elem->channels;
-	uinfo->value.integer.min = 0;
-	uinfo->value.integer.max = SCARLETT2_MIXER_MAX_VALUE;
-	uinfo->value.integer.step = 1;
-	return 0;
-}
+		/* init request */
+		req = (void *)cmd->req->data;
+		req->pad = 0;
+		req->num = cpu_to_le16(direction - SCARLETT2_PORT_OUT_44);
 
-static int scarlett2_mixer_ctl_get(struct snd_kcontrol *kctl,
-				   struct snd_ctl_elem_value *ucontrol)
-{
-	struct usb_mixer_elem_info *elem = kctl->private_data;
-	struct scarlett2_mixer_data *private = elem->head.mixer->private_data;
+		/* form the request data */
+		conn_id = 0;
+		for (order = 0; order < sizeof(assignment_order)/sizeof(int); ++order) {
+			int port_type = assignment_order[order];
 
-	ucontrol->value.integer.value[0] = private->mix[elem->control];
-	return 0;
+			for (port = 0; port < ports[port_type].num[direction]; ++port) {
+				port_idx = scarlett2_get_port_num(ports, SCARLETT2_PORT_OUT, port_type, port);
+
+				/* Lower 12 bits for destination, next 12 bits for source */
+				mute_idx= scarlett2_output_index(mixer, port_type, port);
+				src_mux = ((mute_idx >= 0) && (private->mutes[mute_idx])) ? 0 :
+				          scarlett2_id_to_mux(ports, SCARLETT2_PORT_IN, private->mux[port_idx]);
+				dst_mux = scarlett2_id_to_mux(ports, SCARLETT2_PORT_OUT, port_idx);
+
+				req->data[conn_id++] = cpu_to_le32((src_mux << 12) | dst_mux);
+			}
+		}
+
+		/* Fill rest mux data with zeros */
+		for ( ; conn_id < info->mux_size[direction]; ++conn_id)
+			req->data[conn_id] = 0;
+
+		/* Send the SET_MUX notification */
+		err = scarlett2_usb_send(mixer, cmd, SCARLETT2_USB_SET_MUX,
+					 2 * sizeof(__le16) + conn_id * sizeof(__le32));
+		if (err < 0)
+			break;
+	}
+
+	return err;
 }
 
-static int scarlett2_mixer_ctl_put(struct snd_kcontrol *kctl,
-				   struct snd_ctl_elem_value *ucontrol)
+/* Send USB message to get meter levels; the poll goes after all other
+ * commands, and readers arriving while a poll is in flight share its result
+ */
+static int scarlett2_usb_get_meter_levels(struct usb_mixer_interface *mixer,
+					  u16 *levels)
 {
-	struct usb_mixer_elem_info *elem = kctl->private_data;
-	struct usb_mixer_interface *mixer = elem->head.mixer;
 	struct scarlett2_mixer_data *private = mixer->private_data;
-	int oval, val, mix_num, input_num, err = 0;
-	int index = elem->control;
-	u32 level;
-	__le32 *gain;
-
-	mutex_lock(&private->data_mutex);
-
-	oval      = private->mix[index];
-	val       = ucontrol->value.integer.value[0];
-	mix_num   = index / SCARLETT2_INPUT_MIX_MAX;
-	input_num = index % SCARLETT2_INPUT_MIX_MAX;
+	struct {
+		__le16 pad;
+		__le16 num_meters;
+		__le32 magic;
+	} __packed *req;
+	__le32 resp[SCARLETT2_NUM_METERS];
+	struct scarlett2_cmd *cmd;
+	unsigned long flags;
+	u64 start;
+	int i, err = 0;
+
+	start = ktime_get_ns();
+	mutex_lock(&private->meter_mutex);
+
+	/* Merge with the poll which has finished while we were waiting */
+	if (private->meter_time > start) {
+		spin_lock_irqsave(&private->cmd_lock, flags);
+		private->stat_meter_merged++;
+		spin_unlock_irqrestore(&private->cmd_lock, flags);
+		goto done;
+	}
 
-	if (oval == val)
+	cmd = scarlett2_cmd_alloc(private);
+	if (!cmd) {
+		err = -ENODEV;
 		goto unlock;
+	}
 
-	private->mix[index] = val;
-	err = scarlett2_usb_set_mix(mixer, mix_num);
+	req = (void *)cmd->req->data;
+	req->pad = 0;
+	req->num_meters = cpu_to_le16(SCARLETT2_NUM_METERS);
+	req->magic = cpu_to_le32(SCARLETT2_USB_METER_LEVELS_GET_MAGIC);
+	cmd->low_prio = 1;
+	err = scarlett2_usb_exec(mixer, cmd, SCARLETT2_USB_GET_METER_LEVELS,
+				 sizeof(*req), resp, sizeof(resp));
 	if (err < 0)
 		goto unlock;
 
-	/* Update software configuration data */
-	level = scarlett2_sw_config_mixer_values[val];
-	gain  = &private->sw_cfg->mixer[mix_num][input_num];
-	*gain = cpu_to_le32(level << 16); /* Convert to F32LE */
+	/* copy, convert to u16 */
+	for (i = 0; i < SCARLETT2_NUM_METERS; i++)
+		private->meter_levels[i] = le32_to_cpu(resp[i]);
+	private->meter_time = ktime_get_ns();
 
-	scarlett2_commit_software_config(mixer, gain, sizeof(__le32));
+	spin_lock_irqsave(&private->cmd_lock, flags);
+	private->stat_meter_polls++;
+	spin_unlock_irqrestore(&private->cmd_lock, flags);
 
-	if (err == 0)
-		err = 1;
+done:
+	memcpy(levels, private->meter_levels, sizeof(private->meter_levels));
 
 unlock:
-	mutex_unlock(&private->data_mutex);
+	mutex_unlock(&private->meter_mutex);
 	return err;
 }
 
-static const DECLARE_TLV_DB_MINMAX(
-	db_scale_scarlett2_mixer,
-	SCARLETT2_MIXER_MIN_DB * 100,
-	SCARLETT2_MIXER_MAX_DB * 100
-);
+/*** Control Functions ***/
+static int scarlett2_bool_enum_ctl_info(struct snd_kcontrol *kctl,
+					 struct snd_ctl_elem_info *uinfo)
+{
+	static const char *const values[2] = {
+		"Off", "On"
+	};
 
-static const struct snd_kcontrol_new scarlett2_mixer_ctl = {
-	.iface = SNDRV_CTL_ELEM_IFACE_MIXER,
-	.access = SNDRV_CTL_ELEM_ACCESS_READWRITE |
-		  SNDRV_CTL_ELEM_ACCESS_TLV_READ,
-	.name = "",
-	.info = scarlett2_mixer_ctl_info,
-	.get  = scarlett2_mixer_ctl_get,
-	.put  = scarlett2_mixer_ctl_put,
-	.private_value = SCARLETT2_MIXER_MAX_DB, /* max value */
-	.tlv = { .p = db_scale_scarlett2_mixer }
-};
+	return snd_ctl_enum_info(uinfo, 1, 2, values);
+}
 
-/*** Mixer Mute Controls ***/
-static int scarlett2_mixer_mute_ctl_get(struct snd_kcontrol *kctl,
-				    struct snd_ctl_elem_value *ucontrol)
+/* helper function to create a new control */
+static int scarlett2_add_new_ctl(struct usb_mixer_interface *mixer,
+				 const struct snd_kcontrol_new *ncontrol,
+				 int index, int channels, const char *name,
+				 struct snd_kcontrol **kctl_return)
 {
-	struct usb_mixer_elem_info *elem = kctl->private_data;
-	struct usb_mixer_interface *mixer = elem->head.mixer;
-	struct scarlett2_mixer_data *private = mixer->private_data;
+	struct snd_kcontrol *kctl;
+	struct usb_mixer_elem_info *elem;
+	int err;
+
+	elem = kzalloc(sizeof(*elem), GFP_KERNEL);
+	if (!elem)
+		return -ENOMEM;
+
+	elem->head.mixer = mixer;
+	elem->control = index;
+	elem->head.id = index;
+	elem->channels = channels;
+
+	kctl = snd_ctl_new1(ncontrol, elem);
+	if (!kctl) {
+		kfree(elem);
+		return -ENOMEM;
+	}
+	kctl->private_free = snd_usb_mixer_elem_free;
+
+	strlcpy(kctl->id.name, name, sizeof(kctl->id.name));
+
+	err = snd_usb_mixer_add_control(&elem->head, kctl);
+	if (err < 0)
+		return err;
+
+	if (kctl_return)
+		*kctl_return = kctl;
 
-	ucontrol->value.enumerated.item[0] = !private->mix_mutes[elem->control];
 	return 0;
 }
 
-static int scarlett2_mixer_mute_ctl_put(struct snd_kcontrol *kctl,
-				    struct snd_ctl_elem_value *ucontrol)
+/*** Analogue Line Out Volume Controls ***/
+
+/* Decode the volumes, mutes, SW/HW switches and buttons from the
+ * volume status
+ */
+static void scarlett2_decode_volumes(struct usb_mixer_interface *mixer,
+				     const struct scarlett2_usb_volume_status *volume_status)
 {
-	struct usb_mixer_elem_info *elem = kctl->private_data;
-	struct usb_mixer_interface *mixer = elem->head.mixer;
 	struct scarlett2_mixer_data *private = mixer->private_data;
 	const struct scarlett2_device_info *info = private->info;
-	struct scarlett2_sw_cfg *sw_cfg = private->sw_cfg;
-
-	int num_inputs = info->ports[SCARLETT2_PORT_TYPE_MIX].num[SCARLETT2_PORT_OUT];
-	int index = elem->control;
-	int i, oval, val, err = 0;
-	int mix_num;
-	u8 *mutes;
-	u32 mask;
 
-	mutex_lock(&private->data_mutex);
-
-	oval = private->mix_mutes[index];
-	val = !ucontrol->value.integer.value[0];
-	if (oval == val)
-		goto unlock;
-
-	private->mix_mutes[index] = val;
+	int num_line_out  = info->ports[SCARLETT2_PORT_TYPE_ANALOGUE].num[SCARLETT2_PORT_OUT];
+	int i;
+	s16 volume;
 
-	/* Compute the mixer to update */
-	mix_num   = index / SCARLETT2_INPUT_MIX_MAX;
+	private->master_vol = clamp(
+		volume_status->master_vol + SCARLETT2_VOLUME_BIAS,
+		0, SCARLETT2_VOLUME_BIAS);
 
-	if (sw_cfg != NULL) {
-		/* Build the mute mask */
-		mutes = &private->mix_mutes[mix_num * SCARLETT2_INPUT_MIX_MAX];
-		mask = 0;
-		for (i = 0; i < num_inputs; ++i)
-			mask |= mutes[i] << i;
+	/** Update volume settings for each analogue output */
+	for (i = 0; i < num_line_out; i++) {
+		/* Update software/hardware switch status */
+		private->vol_sw_hw_switch[i] = info->line_out_hw_vol && volume_status->sw_hw_switch[i];
+		private->mutes[i] = !! volume_status->mute[i];
 
-		/* Update software config for corresponding mixer */
-		sw_cfg->mixer_mute[mix_num] = cpu_to_le32(mask);
-		err = scarlett2_commit_software_config(mixer, &sw_cfg->mixer_mute[mix_num], sizeof(__le32));
-		if (err < 0)
-			goto unlock;
+		/* If volume is software-controlled, try to read it's value from software configuration */
+		if (private->vol_sw_hw_switch[i]) {
+			/* Reset to master volume */
+			private->vol[i] = private->master_vol;
+		}
+		else if (private->sw_cfg) {
+			/* Read volume from software config */
+			volume = le16_to_cpu(private->sw_cfg->volume[i].volume);
+			private->vol[i] = clamp(volume + SCARLETT2_VOLUME_BIAS, 0, SCARLETT2_VOLUME_BIAS);
+		}
+		else {
+			/* Read volume from device volume status */
+			volume = le16_to_cpu(volume_status->sw_vol[i]);
+			private->vol[i] = clamp(volume + SCARLETT2_VOLUME_BIAS, 0, SCARLETT2_VOLUME_BIAS);
+		}
 	}
 
-	/* Update MIX settings as it does the original software */
-	err = scarlett2_usb_set_mix(mixer, mix_num);
-
-unlock:
-	mutex_unlock(&private->data_mutex);
-	return err;
+	/* Update Mute/Dim hardware buttons */
+	for (i = 0; i < private->info->button_count; i++)
+		private->buttons[i] = !!volume_status->buttons[i];
 }
 
-static const struct snd_kcontrol_new scarlett2_mixer_mute_ctl = {
-	.iface = SNDRV_CTL_ELEM_IFACE_MIXER,
-	.name = "",
-	.info = snd_ctl_boolean_mono_info,
-	.get  = scarlett2_mixer_mute_ctl_get,
-	.put  = scarlett2_mixer_mute_ctl_put
-};
-
-static int scarlett2_add_mixer_ctls(struct usb_mixer_interface *mixer)
+/* Update hardware volume controls after receiving notification that
+ * they have changed
+ */
+static int scarlett2_update_volumes(struct usb_mixer_interface *mixer)
 {
 	struct scarlett2_mixer_data *private = mixer->private_data;
-	const struct scarlett2_ports *ports = private->info->ports;
-	struct scarlett2_sw_cfg *sw_cfg = private->sw_cfg;
+	const struct scarlett2_device_info *info = private->info;
+	struct scarlett2_usb_volume_status volume_status;
+	int err;
 
-	int err, i, j;
-	int mix_idx, num_inputs, num_outputs;
-	char s[SNDRV_CTL_ELEM_ID_NAME_MAXLEN];
-	u32 level, mask;
+	/* Check feature support */
+	if (!info->has_hw_volume) {
+		private->vol_updated = 0;
+		return 0;
+	}
 
-	/* Check that device has mixer */
-	if (!private->info->has_mixer)
+	/* Check re-entrance */
+	if (!private->vol_updated)
 		return 0;
 
-	num_inputs  = ports[SCARLETT2_PORT_TYPE_MIX].num[SCARLETT2_PORT_OUT];
-	num_outputs = ports[SCARLETT2_PORT_TYPE_MIX].num[SCARLETT2_PORT_IN];
+	/* Obtain actual volume status */
+	err = scarlett2_usb_get_volume_status(mixer, &volume_status);
+	if (err < 0)
+		return err;
 
-	/* For each mixer */
-	for (i=0; i<num_outputs; ++i) {
-		mix_idx   = i * SCARLETT2_INPUT_MIX_MAX;
+	scarlett2_decode_volumes(mixer, &volume_status);
 
-		/* Decode software config for mixer channel */
-		mask = (sw_cfg) ? le32_to_cpu(sw_cfg->mixer_mute[i]) : 0;
+	/* Reset flag AFTER the data has been received */
+	private->vol_updated = 0;
+	return 0;
+}
 
-		/* Add Mix control */
-		for (j = 0; j < num_inputs; ++j, ++mix_idx) {
-			level = le32_to_cpu(private->sw_cfg->mixer[i][j]);
-			private->mix[mix_idx] = scarlett2_float_to_mixer_level(level) - (SCARLETT2_MIXER_MIN_DB * 2);
-			private->mix_mutes[mix_idx] = !!(mask & (1 << j));
+static int scarlett2_volume_ctl_info(struct snd_kcontrol *kctl,
+				     struct snd_ctl_elem_info *uinfo)
+{
+	struct usb_mixer_elem_info *elem = kctl->private_data;
 
-			/* Add Mixer volume control */
-			snprintf(s, sizeof(s), "Mix %c In %02d Volume", 'A' + i, j + 1);
-			err = scarlett2_add_new_ctl(mixer, &scarlett2_mixer_ctl, mix_idx, 1, s, NULL);
-			if (err < 0)
-				return err;
+	uinfo->type = SNDRV_CTL_ELEM_TYPE_INTEGER;
+	uinfo->count = elem->channels;
+	uinfo->value.integer.min = 0;
+	uinfo->value.integer.max = SCARLETT2_VOLUME_BIAS;
+	uinfo->value.integer.step = 1;
+	return 0;
+}
 
-			/* Add Mixer mute control */
-			snprintf(s, sizeof(s), "Mix %c In %02d Switch", 'A' + i, j + 1);
-			err = scarlett2_add_new_ctl(mixer, &scarlett2_mixer_mute_ctl, mix_idx, 1, s, NULL);
-			if (err < 0)
-				return err;
-		}
+static int scarlett2_master_volume_ctl_get(struct snd_kcontrol *kctl,
+					   struct snd_ctl_elem_value *ucontrol)
+{
+	struct usb_mixer_elem_info *elem = kctl->private_data;
+	struct usb_mixer_interface *mixer = elem->head.mixer;
+	struct scarlett2_mixer_data *private = mixer->private_data;
 
-		/* Commit the actual mix state at startup */
-		err = scarlett2_usb_set_mix(mixer, i);
-		if (err < 0)
-			return err;
+	if (private->vol_updated) {
+		scarlett2_data_lock(private);
+		scarlett2_update_volumes(mixer);
+		scarlett2_data_unlock(private);
 	}
 
+	ucontrol->value.integer.value[0] = private->master_vol;
 	return 0;
 }
 
-/*** Mux Source Selection Controls ***/
-static int scarlett2_mux_src_enum_ctl_info(struct snd_kcontrol *kctl,
-					   struct snd_ctl_elem_info *uinfo)
+static int scarlett2_volume_ctl_get(struct snd_kcontrol *kctl,
+				    struct snd_ctl_elem_value *ucontrol)
 {
 	struct usb_mixer_elem_info *elem = kctl->private_data;
 	struct usb_mixer_interface *mixer = elem->head.mixer;
 	struct scarlett2_mixer_data *private = mixer->private_data;
-	int item = uinfo->value.enumerated.item;
-	int items = private->num_inputs + 1;
-	int port = clamp(item, 0, private->num_inputs) - 1;
-
-	uinfo->type  = SNDRV_CTL_ELEM_TYPE_ENUMERATED;
-	uinfo->count = elem->channels;
-	uinfo->value.enumerated.items = items;
-	if (!items)
-		return 0;
-	if (item >= items)
-		item = uinfo->value.enumerated.item = items - 1;
+	int index = elem->control;
 
-	scarlett2_fmt_port_name(uinfo->value.enumerated.name,
-	                        sizeof(uinfo->value.enumerated.name),
-	                        "%s",
-	                        private->info,
-	                        SCARLETT2_PORT_IN, port);
+	if (private->vol_updated) {
+		scarlett2_data_lock(private);
+		scarlett2_update_volumes(mixer);
+		scarlett2_data_unlock(private);
+	}
 
+	ucontrol->value.integer.value[0] = private->vol[index];
 	return 0;
 }
 
-static int scarlett2_mux_src_enum_ctl_get(struct snd_kcontrol *kctl,
-					  struct snd_ctl_elem_value *ucontrol)
+static int scarlett2_volume_ctl_put(struct snd_kcontrol *kctl,
+				    struct snd_ctl_elem_value *ucontrol)
 {
 	struct usb_mixer_elem_info *elem = kctl->private_data;
-	struct scarlett2_mixer_data *private = elem->head.mixer->private_data;
+	struct usb_mixer_interface *mixer = elem->head.mixer;
+	struct scarlett2_mixer_data *private = mixer->private_data;
+	struct scarlett2_sw_cfg_volume *sw_vol;
+	int index = elem->control;
+	int oval, val, err = 0;
+	u16 volume;
 
-	ucontrol->value.enumerated.item[0] = private->mux[elem->control] + 1; /* Element 0 is always 'Off' */
-	return 0;
-}
+	scarlett2_data_lock(private);
+	scarlett2_update_volumes(mixer);
 
-static int scarlett2_commit_sw_routing(struct usb_mixer_interface *mixer, int src_port, int dst_port) {
-	struct scarlett2_mixer_data *private = mixer->private_data;
-	const struct scarlett2_device_info *info = private->info;
-	struct scarlett2_sw_cfg *sw_cfg = private->sw_cfg;
-	int err, i;
-	int num_mixer_ins;
-	int dst_port_type, dst_port_num;
-	int src_port_type, src_port_num;
-	int in_idx, out_idx, op_idx;
-	char src[SNDRV_CTL_ELEM_ID_NAME_MAXLEN], dst[SNDRV_CTL_ELEM_ID_NAME_MAXLEN];
-	u32 mask;
+	oval = private->vol[index];
+	val = ucontrol->value.integer.value[0];
 
-	/* Nothing to do if there is no software config */
-	if ((!sw_cfg) || (!info->sw_port_mapping))
-		return 0;
+	if (oval == val)
+		goto unlock;
 
-	/* Decoded port OK? */
-	err = scarlett2_decode_port(&dst_port_type, &dst_port_num, info->ports, SCARLETT2_PORT_OUT, dst_port);
-	if (err < 0)
-		return 0;
-
-	/* DEBUG: output routing information */
-	scarlett2_fmt_port_name(src, SNDRV_CTL_ELEM_ID_NAME_MAXLEN, "%s", info, SCARLETT2_PORT_IN, src_port);
-	scarlett2_fmt_port_name(dst, SNDRV_CTL_ELEM_ID_NAME_MAXLEN, "%s", info, SCARLETT2_PORT_OUT, dst_port);
-
-	if (dst_port_type == SCARLETT2_PORT_TYPE_MIX) {
-		/* Decode input port index */
-		in_idx  = scarlett2_drv2sw_port_num(info->ports, info->sw_port_mapping, SCARLETT2_PORT_IN, src_port);
-		if (in_idx < 0)
-			return 0;
-
-		/* If output is working in stereo mode - switch it into mono mode */
-		if (sw_cfg->mixer_in_map[dst_port_num] & 0x80) {
-			/* Eliminate the 'FAT'-style allocation table for mixer lines */
-			num_mixer_ins = info->ports[SCARLETT2_PORT_TYPE_MIX].num[SCARLETT2_PORT_OUT];
-			for (i = 0; i < num_mixer_ins; ++i) {
-				/* The stereo pair should have bit 7 set */
-				op_idx = sw_cfg->mixer_in_map[i];
-				if (!(op_idx & 0x80))
-					continue;
+	private->vol[index] = val;
 
-				/* The beginning of stereo pair should refer next channel (non-zero value) */
-				op_idx &= 0x7f;
-				if ((!op_idx) || (op_idx >= num_mixer_ins))
-					continue;
+	/* Update volume for the output */
+	err = scarlett2_usb_set_config(mixer, SCARLETT2_CONFIG_LINE_OUT_VOLUME,
+				       index, val - SCARLETT2_VOLUME_BIAS);
+	if (err != 0)
+		goto unlock;
 
-				/* The current channel or referenced channel should match mixer index */
-				if ((i == dst_port_num) || (op_idx == dst_port_num)) {
-					sw_cfg->mixer_in_map[i]      = 0;
-					sw_cfg->mixer_in_map[op_idx] = 0;
-					err = scarlett2_commit_software_config(mixer, &sw_cfg->mixer_in_map, sizeof(u8) * num_mixer_ins);
-					if (err < 0)
-						return err;
-					break;
-				}
-			}
-		}
+	/* Update software configuration if possible */
+	if ((private->sw_cfg) && (!private->vol_sw_hw_switch[index])) {
+		volume = val - SCARLETT2_VOLUME_BIAS;
+		sw_vol = &private->sw_cfg->volume[index];
+		sw_vol->volume  = cpu_to_le16(volume);
+		sw_vol->changed = 1;
 
-		/* Now we can update software configuration to set up proper routing */
-		sw_cfg->mixer_in_mux[dst_port_num] = in_idx + 1;
-		err = scarlett2_commit_software_config(mixer, &sw_cfg->mixer_in_mux[dst_port_num], sizeof(u8));
+		err = scarlett2_commit_software_config(mixer, sw_vol, sizeof(struct scarlett2_sw_cfg_volume));
 		if (err < 0)
-			return err;
+			goto unlock;
 	}
-	else {
-		/* Decode source port type */
-		err = scarlett2_decode_port(&src_port_type, &src_port_num, info->ports, SCARLETT2_PORT_IN, src_port);
-		if (err < 0)
-			return 0;
+	if (err == 0)
+		err = 1;
 
-		/* Check that output is valid */
-		out_idx = scarlett2_get_sw_port_num(info->sw_port_mapping, SCARLETT2_PORT_OUT, dst_port_type, dst_port_num);
-		if (out_idx < 0)
-			return 0;
-		op_idx  = out_idx & (~1);
+unlock:
+	scarlett2_data_unlock(private);
+	return err;
+}
 
-		/* If output is working in stereo mode - switch it into mono mode */
-		mask    = le32_to_cpu(sw_cfg->stereo_sw);
-		if (mask & (3 << op_idx)) {
-			mask &= ~(3 << op_idx);
+static const DECLARE_TLV_DB_MINMAX(
+	db_scale_scarlett2_gain, -SCARLETT2_VOLUME_BIAS * 100, 0
+);
 
-			/* Reset stereo mask for output channel */
-			sw_cfg->stereo_sw = cpu_to_le32(mask);
-			err = scarlett2_commit_software_config(mixer, &sw_cfg->stereo_sw, sizeof(__le32));
-			if (err < 0)
-				return err;
+static const struct snd_kcontrol_new scarlett2_master_volume_ctl = {
+	.iface = SNDRV_CTL_ELEM_IFACE_MIXER,
+	.access = SNDRV_CTL_ELEM_ACCESS_READ |
+		  SNDRV_CTL_ELEM_ACCESS_TLV_READ,
+	.name = "",
+	.info = scarlett2_volume_ctl_info,
+	.get  = scarlett2_master_volume_ctl_get,
+	.private_value = 0, /* max value */
+	.tlv = { .p = db_scale_scarlett2_gain }
+};
 
-			/* Update routing for odd output channel if it is required */
-			if (sw_cfg->out_mux[op_idx+1] != (sw_cfg->out_mux[op_idx]+1)) {
-				sw_cfg->out_mux[op_idx+1] = sw_cfg->out_mux[op_idx] + 1;
-				err = scarlett2_commit_software_config(mixer, &sw_cfg->mixer_in_map[op_idx], sizeof(u8) * 2);
-				if (err < 0)
-					return err;
-			}
+static const struct snd_kcontrol_new scarlett2_line_out_volume_ctl = {
+	.iface = SNDRV_CTL_ELEM_IFACE_MIXER,
+	.access = SNDRV_CTL_ELEM_ACCESS_READWRITE |
+		  SNDRV_CTL_ELEM_ACCESS_TLV_READ,
+	.name = "",
+	.info = scarlett2_volume_ctl_info,
+	.get  = scarlett2_volume_ctl_get,
+	.put  = scarlett2_volume_ctl_put,
+	.private_value = 0, /* max value */
+	.tlv = { .p = db_scale_scarlett2_gain }
+};
 
-			/* Update mixer usage mask if mixer is enabled */
-			mask = le32_to_cpu(sw_cfg->mixer_bind);
-			if ((mask >> op_idx) & 3) { /* For mixer enabled for channels both bits should be 0 */
-				mask &= ~(3 << op_idx);
-				sw_cfg->mixer_bind = cpu_to_le32(mask);
-				err = scarlett2_commit_software_config(mixer, &sw_cfg->mixer_bind, sizeof(__le32));
-				if (err < 0)
-					return err;
-			}
-		}
+/*** HW/SW Volume Switch Controls ***/
 
-		/* Perform routing depending on the source port type */
-		mask = le32_to_cpu(sw_cfg->mixer_bind);
-		if (src_port_type == SCARLETT2_PORT_TYPE_MIX) {
-			in_idx = src_port_num;
-			/* Reset the mixer usage mask */
-			mask  &= ~(1 << out_idx);
-		} else {
-			in_idx = scarlett2_get_sw_port_num(info->sw_port_mapping, SCARLETT2_PORT_IN, src_port_type, src_port_num);
-			mask  |= (1 << out_idx);
-		}
+static int scarlett2_sw_hw_enum_ctl_info(struct snd_kcontrol *kctl,
+					 struct snd_ctl_elem_info *uinfo)
+{
+	static const char *const values[2] = {
+		"SW", "HW"
+	};
 
-		/* Update mixer settings */
-		sw_cfg->mixer_bind = cpu_to_le32(mask);
-		err = scarlett2_commit_software_config(mixer, &sw_cfg->mixer_bind, sizeof(__le32));
-		if (err < 0)
-			return err;
+	return snd_ctl_enum_info(uinfo, 1, 2, values);
+}
 
-		/* Now we can update software configuration to set up proper routing */
-		sw_cfg->out_mux[out_idx] = in_idx + 1;
-		err = scarlett2_commit_software_config(mixer, &sw_cfg->out_mux[out_idx], sizeof(u8));
-		if (err < 0)
-			return err;
-	}
+static int scarlett2_sw_hw_enum_ctl_get(struct snd_kcontrol *kctl,
+					struct snd_ctl_elem_value *ucontrol)
+{
+	struct usb_mixer_elem_info *elem = kctl->private_data;
+	struct scarlett2_mixer_data *private = elem->head.mixer->private_data;
 
+	ucontrol->value.enumerated.item[0] = private->vol_sw_hw_switch[elem->control];
 	return 0;
 }
 
-static int scarlett2_mux_src_enum_ctl_put(struct snd_kcontrol *kctl,
-					  struct snd_ctl_elem_value *ucontrol)
+static int scarlett2_sw_hw_enum_ctl_put(struct snd_kcontrol *kctl,
+					struct snd_ctl_elem_value *ucontrol)
 {
 	struct usb_mixer_elem_info *elem = kctl->private_data;
 	struct usb_mixer_interface *mixer = elem->head.mixer;
 	struct scarlett2_mixer_data *private = mixer->private_data;
+
+	struct scarlett2_config_write writes[2];
 	int index = elem->control;
 	int oval, val, err = 0;
+	s16 volume;
 
-	mutex_lock(&private->data_mutex);
+	scarlett2_data_lock(private);
+	scarlett2_update_volumes(mixer);
 
-	oval = private->mux[index];
-	val  = ucontrol->value.integer.value[0];
-	val  = clamp(val, 0, private->num_inputs) - 1;
+	oval = private->vol_sw_hw_switch[index];
+	val = !!ucontrol->value.integer.value[0];
 
 	if (oval == val)
 		goto unlock;
 
-	/* Update routing for software configuration */
-	err = scarlett2_commit_sw_routing(mixer, val, index);
+	private->vol_sw_hw_switch[index] = val;
+
+	/* Change access mode to RO (hardware controlled volume)
+	 * or RW (software controlled volume)
+	 */
+	if (val) {
+		private->vol_ctls[index]->vd[0].access &=
+			~SNDRV_CTL_ELEM_ACCESS_WRITE;
+
+		/* Set volume to current HW volume */
+		writes[0].value = private->master_vol - SCARLETT2_VOLUME_BIAS;
+	}
+	else {
+		private->vol_ctls[index]->vd[0].access |=
+			SNDRV_CTL_ELEM_ACCESS_WRITE;
+
+		if (private->sw_cfg) {
+			/* Reset volume to software config */
+			volume = le16_to_cpu(private->sw_cfg->volume[index].volume);
+			private->vol[index] = clamp(volume + SCARLETT2_VOLUME_BIAS, 0, SCARLETT2_VOLUME_BIAS);
+		}
+
+		/* Set volume to current SW volume */
+		writes[0].value = private->vol[index] - SCARLETT2_VOLUME_BIAS;
+	}
+
+	/* Send the volume and SW/HW switch change to the device */
+	writes[0].item = SCARLETT2_CONFIG_LINE_OUT_VOLUME;
+	writes[0].index = index;
+	writes[1] = (struct scarlett2_config_write) {
+		SCARLETT2_CONFIG_SW_HW_SWITCH, index, val
+	};
+	err = scarlett2_usb_set_config_multi(mixer, writes, 2);
 	if (err < 0)
 		goto unlock;
 
-	/* Commit routing settings */
-	private->mux[index] = val;
-	err = scarlett2_usb_set_mux(mixer);
-	if (err == 0)
-		err = 1;
+	/* Notify of RO/RW change */
+	snd_ctl_notify(mixer->chip->card, SNDRV_CTL_EVENT_MASK_INFO | SNDRV_CTL_EVENT_MASK_VALUE,
+		       &private->vol_ctls[index]->id);
+
+	/* Update volume settings */
+	scarlett2_update_volumes(mixer);
 
 unlock:
-	mutex_unlock(&private->data_mutex);
+	scarlett2_data_unlock(private);
 	return err;
 }
 
-static const struct snd_kcontrol_new scarlett2_mux_src_enum_ctl = {
+static const struct snd_kcontrol_new scarlett2_sw_hw_enum_ctl = {
 	.iface = SNDRV_CTL_ELEM_IFACE_MIXER,
 	.name = "",
-	.info = scarlett2_mux_src_enum_ctl_info,
-	.get  = scarlett2_mux_src_enum_ctl_get,
-	.put  = scarlett2_mux_src_enum_ctl_put,
+	.info = scarlett2_sw_hw_enum_ctl_info,
+	.get  = scarlett2_sw_hw_enum_ctl_get,
+	.put  = scarlett2_sw_hw_enum_ctl_put,
 };
 
-static int scarlett2_parse_sw_mux(struct usb_mixer_interface *mixer)
+/*** Gain Halos Switch Controls ***/
+static int scarlett2_ghalo_color_enum_ctl_info(struct snd_kcontrol *kctl,
+					 struct snd_ctl_elem_info *uinfo)
 {
-	struct scarlett2_mixer_data *private = mixer->private_data;
-	const struct scarlett2_device_info *info = private->info;
-	struct scarlett2_sw_cfg *sw_cfg = private->sw_cfg;
-	char src[SNDRV_CTL_ELEM_ID_NAME_MAXLEN], dst[SNDRV_CTL_ELEM_ID_NAME_MAXLEN];
+	static const char *const values[8] = {
+		"Off",
+		"Red",
+		"Green",
+		"Amber",
+		"Blue",
+		"Pink",
+		"Light Blue",
+		"Light Pink"
+	};
 
-	int port_type, port_count, num_mix_in;
-	int dst_port, src_port, mix_bit;
-	int sw_idx, sp_idx;
-	u32 st_map, mix_map;
-	int i, j;
+	return snd_ctl_enum_info(uinfo, 1, 8, values);
+}
 
-	static const int sw_list[] = {
-		SCARLETT2_PORT_TYPE_ANALOGUE,
-		SCARLETT2_PORT_TYPE_SPDIF,
-		SCARLETT2_PORT_TYPE_ADAT,
-		SCARLETT2_PORT_TYPE_PCM
-	};
+static int scarlett2_ghalo_custom_ctl_get(struct snd_kcontrol *kctl,
+					struct snd_ctl_elem_value *ucontrol)
+{
+	struct usb_mixer_elem_info *elem = kctl->private_data;
+	struct scarlett2_mixer_data *private = elem->head.mixer->private_data;
 
-	/* If we have software configuration and port mapping - apply them */
-	if ((sw_cfg == NULL) || (info->sw_port_mapping == NULL))
-		return 0;
+	ucontrol->value.enumerated.item[0] = private->ghalo_custom;
 
-	/* Apply physical output routing */
-	st_map = le32_to_cpu(sw_cfg->stereo_sw);
-	mix_map = le32_to_cpu(sw_cfg->mixer_bind);
+	return 0;
+}
 
-	for (i=0; i < sizeof(sw_list)/sizeof(int); ++i) {
-		port_type = sw_list[i];
-		port_count = info->ports[port_type].num[SCARLETT2_PORT_OUT];
+static int scarlett2_ghalo_level_ctl_get(struct snd_kcontrol *kctl,
+					struct snd_ctl_elem_value *ucontrol)
+{
+	struct usb_mixer_elem_info *elem = kctl->private_data;
+	struct scarlett2_mixer_data *private = elem->head.mixer->private_data;
 
-		for (j=0; j<port_count; ++j) {
-			sw_idx = scarlett2_get_sw_port_num(info->sw_port_mapping, SCARLETT2_PORT_OUT, port_type, j);
-			if (sw_idx < 0) /* Skip port if it is not mapped in software configuration */
-				continue;
+	ucontrol->value.enumerated.item[0] = private->ghalo_levels[elem->control];
+	return 0;
+}
 
-			/* Check that destination port is valid */
-			dst_port = scarlett2_get_port_num(info->ports, SCARLETT2_PORT_OUT, port_type, j);
-			if ((dst_port < 0) || (dst_port >= SCARLETT2_MUX_MAX))
-				continue;
+static int scarlett2_ghalo_led_ctl_get(struct snd_kcontrol *kctl,
+					struct snd_ctl_elem_value *ucontrol)
+{
+	struct usb_mixer_elem_info *elem = kctl->private_data;
+	struct scarlett2_mixer_data *private = elem->head.mixer->private_data;
 
-			/* Check whether output is in stereo or mono mode and fetch the source port number */
-			sp_idx = sw_idx & (~1); /* Index of byte for the corresponding stereo (even) channel */
+	ucontrol->value.enumerated.item[0] = private->ghalo_leds[elem->control];
+	return 0;
+}
 
-			if (st_map & ((1 << sw_idx) | (1 << sp_idx))) {
-				src_port = (sw_idx & 1) ? sw_cfg->out_mux[sp_idx]+1 : sw_cfg->out_mux[sp_idx];
-				mix_bit  = 1 << sp_idx;
-			}
-			else {
-				src_port = sw_cfg->out_mux[sw_idx];
-				mix_bit  = 1 << sw_idx;
-			}
+static int scarlett2_ghalo_custom_ctl_put(struct snd_kcontrol *kctl,
+					struct snd_ctl_elem_value *ucontrol)
+{
+	struct usb_mixer_elem_info *elem = kctl->private_data;
+	struct usb_mixer_interface *mixer = elem->head.mixer;
+	struct scarlett2_mixer_data *private = mixer->private_data;
 
-			/* Check that channel is routed to mixer */
-			if (mix_map & mix_bit) /* Bit is set - not routed to mixer, it is a physical port number */
-				src_port = scarlett2_sw2drv_port_num(info->ports, info->sw_port_mapping, SCARLETT2_PORT_IN, src_port);
-			else if (src_port > 0) /* Bit not set and source number is greater than zero - routed via mixer */
-				src_port = scarlett2_get_port_num(info->ports, SCARLETT2_PORT_IN, SCARLETT2_PORT_TYPE_MIX, src_port - 1);
+	int oval, val, err = 0;
+	int command;
 
-			/* Write the actual mux configuration */
-			private->mux[dst_port] = src_port;
+	scarlett2_data_lock(private);
+
+	oval = private->ghalo_custom;
+	val = !!ucontrol->value.integer.value[0];
+
+	if (oval == val)
+		goto unlock;
+
+	private->ghalo_custom = val;
+	command = (val) ? 0x02 : 0;
+
+	/* Set gain halo control */
+	err = scarlett2_usb_set_config(
+		mixer, SCARLETT2_CONFIG_GAIN_HALO_ENABLE,
+		0, command);
+	if (err >= 0)
+		snd_ctl_notify(mixer->chip->card, SNDRV_CTL_EVENT_MASK_VALUE,
+			       &private->ghalo_scheme_ctl->id);
+
+unlock:
+	scarlett2_data_unlock(private);
+	return err;
+}
+
+static int scarlett2_ghalo_level_ctl_put(struct snd_kcontrol *kctl,
+					struct snd_ctl_elem_value *ucontrol)
+{
+	struct usb_mixer_elem_info *elem = kctl->private_data;
+	struct usb_mixer_interface *mixer = elem->head.mixer;
+	struct scarlett2_mixer_data *private = mixer->private_data;
+
+	int index = elem->control;
+	int oval, val, err = 0;
+
+	scarlett2_data_lock(private);
+
+	oval = private->ghalo_levels[index];
+	val = ucontrol->value.integer.value[0];
+	val = clamp(val, 0, 7);
+
+	if (oval == val)
+		goto unlock;
+
+	private->ghalo_levels[index] = val;
+
+	/* Set gain halo control */
+	err = scarlett2_usb_set_config(mixer, SCARLETT2_CONFIG_GAIN_HALO_LEVELS, index, val);
+	if (err >= 0)
+		snd_ctl_notify(mixer->chip->card, SNDRV_CTL_EVENT_MASK_VALUE,
+			       &private->ghalo_scheme_ctl->id);
+
+unlock:
+	scarlett2_data_unlock(private);
+	return err;
+}
+
+static int scarlett2_ghalo_led_ctl_put(struct snd_kcontrol *kctl,
+					struct snd_ctl_elem_value *ucontrol)
+{
+	struct usb_mixer_elem_info *elem = kctl->private_data;
+	struct usb_mixer_interface *mixer = elem->head.mixer;
+	struct scarlett2_mixer_data *private = mixer->private_data;
+
+	int index = elem->control;
+	int oval, val, err = 0;
+
+	scarlett2_data_lock(private);
+
+	oval = private->ghalo_leds[index];
+	val = ucontrol->value.integer.value[0];
+	val = clamp(val, 0, 7);
+
+	if (oval == val)
+		goto unlock;
+
+	private->ghalo_leds[index] = val;
+
+	/* Set gain halo control */
+	err = scarlett2_usb_set_config(mixer, SCARLETT2_CONFIG_GAIN_HALO_LEDS, index, val);
+	if (err >= 0)
+		snd_ctl_notify(mixer->chip->card, SNDRV_CTL_EVENT_MASK_VALUE,
+			       &private->ghalo_scheme_ctl->id);
+
+unlock:
+	scarlett2_data_unlock(private);
+	return err;
+}
+
+static const struct snd_kcontrol_new scarlett2_ghalo_custom_ctl = {
+	.iface = SNDRV_CTL_ELEM_IFACE_MIXER,
+	.name = "",
+	.info = scarlett2_bool_enum_ctl_info,
+	.get  = scarlett2_ghalo_custom_ctl_get,
+	.put  = scarlett2_ghalo_custom_ctl_put,
+};
+
+static const struct snd_kcontrol_new scarlett2_ghalo_level_ctl = {
+	.iface = SNDRV_CTL_ELEM_IFACE_MIXER,
+	.name = "",
+	.info = scarlett2_ghalo_color_enum_ctl_info,
+	.get  = scarlett2_ghalo_level_ctl_get,
+	.put  = scarlett2_ghalo_level_ctl_put,
+};
+
+static const struct snd_kcontrol_new scarlett2_ghalo_led_ctl = {
+	.iface = SNDRV_CTL_ELEM_IFACE_MIXER,
+	.name = "",
+	.info = scarlett2_ghalo_color_enum_ctl_info,
+	.get  = scarlett2_ghalo_led_ctl_get,
+	.put  = scarlett2_ghalo_led_ctl_put,
+};
+
+/* The whole color scheme: custom flag, level colors, then LED colors */
+static int scarlett2_ghalo_scheme_ctl_info(struct snd_kcontrol *kctl,
+					   struct snd_ctl_elem_info *uinfo)
+{
+	struct usb_mixer_elem_info *elem = kctl->private_data;
+
+	uinfo->type = SNDRV_CTL_ELEM_TYPE_INTEGER;
+	uinfo->count = elem->channels;
+	uinfo->value.integer.min = 0;
+	uinfo->value.integer.max = 7;
+	uinfo->value.integer.step = 1;
+	return 0;
+}
+
+static int scarlett2_ghalo_scheme_ctl_get(struct snd_kcontrol *kctl,
+					  struct snd_ctl_elem_value *ucontrol)
+{
+	struct usb_mixer_elem_info *elem = kctl->private_data;
+	struct scarlett2_mixer_data *private = elem->head.mixer->private_data;
+	long *value = ucontrol->value.integer.value;
+	int i;
+
+	*(value++) = private->ghalo_custom;
+	for (i = 0; i < SCARLETT2_GAIN_HALO_LEVELS; i++)
+		*(value++) = private->ghalo_levels[i];
+	for (i = 0; i < private->info->gain_halos_count; i++)
+		*(value++) = private->ghalo_leds[i];
+
+	return 0;
+}
+
+static int scarlett2_ghalo_scheme_ctl_put(struct snd_kcontrol *kctl,
+					  struct snd_ctl_elem_value *ucontrol)
+{
+	struct usb_mixer_elem_info *elem = kctl->private_data;
+	struct usb_mixer_interface *mixer = elem->head.mixer;
+	struct scarlett2_mixer_data *private = mixer->private_data;
+	const struct scarlett2_device_info *info = private->info;
+	struct scarlett2_config_write writes[1 + SCARLETT2_GAIN_HALO_LEVELS + SCARLETT2_GAIN_HALO_LEDS_MAX];
+	struct snd_kcontrol *changed[ARRAY_SIZE(writes)];
+	const long *value = ucontrol->value.integer.value;
+	int i, val, num = 0, nchanged = 0, err = 0;
+
+	scarlett2_data_lock(private);
+
+	/* Custom colors flag */
+	val = !!*(value++);
+	writes[num++] = (struct scarlett2_config_write) {
+		SCARLETT2_CONFIG_GAIN_HALO_ENABLE, 0, (val) ? 0x02 : 0
+	};
+	if (private->ghalo_custom != val) {
+		private->ghalo_custom = val;
+		changed[nchanged++] = private->ghalo_custom_ctl;
+	}
+
+	/* Colors of levels */
+	for (i = 0; i < SCARLETT2_GAIN_HALO_LEVELS; i++) {
+		val = *(value++);
+		val = clamp(val, 0, 7);
+		writes[num++] = (struct scarlett2_config_write) {
+			SCARLETT2_CONFIG_GAIN_HALO_LEVELS, i, val
+		};
+		if (private->ghalo_levels[i] != val) {
+			private->ghalo_levels[i] = val;
+			changed[nchanged++] = private->ghalo_level_ctls[i];
+		}
+	}
+
+	/* Colors of LEDs */
+	for (i = 0; i < info->gain_halos_count; i++) {
+		val = *(value++);
+		val = clamp(val, 0, 7);
+		writes[num++] = (struct scarlett2_config_write) {
+			SCARLETT2_CONFIG_GAIN_HALO_LEDS, i, val
+		};
+		if (private->ghalo_leds[i] != val) {
+			private->ghalo_leds[i] = val;
+			changed[nchanged++] = private->ghalo_led_ctls[i];
+		}
+	}
+
+	if (!nchanged)
+		goto unlock;
+
+	/* The whole scheme is contiguous: one SET_DATA, activates 9 and 11 once */
+	err = scarlett2_usb_set_config_multi(mixer, writes, num);
+	if (err < 0)
+		goto unlock;
+
+	for (i = 0; i < nchanged; i++)
+		snd_ctl_notify(mixer->chip->card, SNDRV_CTL_EVENT_MASK_VALUE,
+			       &changed[i]->id);
+	err = 1;
+
+unlock:
+	scarlett2_data_unlock(private);
+	return err;
+}
+
+static const struct snd_kcontrol_new scarlett2_ghalo_scheme_ctl = {
+	.iface = SNDRV_CTL_ELEM_IFACE_MIXER,
+	.name = "",
+	.info = scarlett2_ghalo_scheme_ctl_info,
+	.get  = scarlett2_ghalo_scheme_ctl_get,
+	.put  = scarlett2_ghalo_scheme_ctl_put,
+};
+
+/*** Line Level/Instrument Level Switch Controls ***/
+static int scarlett2_update_line_ctl_switches(struct usb_mixer_interface *mixer)
+{
+	struct scarlett2_mixer_data *private = mixer->private_data;
+	const struct scarlett2_device_info *info = private->info;
+	u8 pad_switches[SCARLETT2_PAD_SWITCH_MAX];
+	u8 air_switches[SCARLETT2_AIR_SWITCH_MAX];
+	u8 level_switches[SCARLETT2_LEVEL_SWITCH_MAX];
+	u8 pow_switch, retain48v;
+	struct scarlett2_config_req reqs[5];
+	int i, index, num = 0, err = 0;
+
+	/* Check for re-entrance */
+	if (!private->line_ctl_updated)
+		return 0;
+
+	/* Fetch all switches at once */
+	if (info->pad_input_count)
+		reqs[num++] = (struct scarlett2_config_req) {
+			SCARLETT2_CONFIG_PAD_SWITCH, info->pad_input_count, pad_switches
+		};
+	if (info->air_input_count)
+		reqs[num++] = (struct scarlett2_config_req) {
+			SCARLETT2_CONFIG_AIR_SWITCH,
+			(info->air_input_bitmask) ? 1 : info->air_input_count, air_switches
+		};
+	if (info->level_input_count)
+		reqs[num++] = (struct scarlett2_config_req) {
+			SCARLETT2_CONFIG_LEVEL_SWITCH,
+			(info->level_input_bitmask) ? 1 : info->level_input_count, level_switches
+		};
+	if (info->power_48v_count)
+		reqs[num++] = (struct scarlett2_config_req) {
+			SCARLETT2_CONFIG_48V_SWITCH, 1, &pow_switch
+		};
+	if (info->has_retain48v)
+		reqs[num++] = (struct scarlett2_config_req) {
+			SCARLETT2_CONFIG_RETAIN_48V, 1, &retain48v
+		};
+
+	err = scarlett2_usb_get_config_multi(mixer, reqs, num);
+	if (err < 0)
+		return err;
+
+	/* Update PAD settings */
+	if (info->pad_input_count) {
+		for (i = 0; i < info->pad_input_count; i++)
+			private->pad_switch[i] = !!pad_switches[i];
+	}
+
+	/* Update AIR input settings */
+	if (info->air_input_count) {
+		for (i = 0; i < info->air_input_count; i++)
+			private->air_switch[i] = !! ((info->air_input_bitmask) ? air_switches[0] & (1 << i) : air_switches[i]);
+	}
+
+	/* Update LINE/INST settings */
+	if (info->level_input_count) {
+		for (i = 0; i < info->level_input_count; i++) {
+			index = i + info->level_input_offset;
+			private->level_switch[i] = !! ((info->level_input_bitmask) ? level_switches[0] & (1 << index) : level_switches[index]);
 		}
 	}
 
-	/* Apply mixer routing */
-	num_mix_in = (info->has_mixer) ? info->ports[SCARLETT2_PORT_TYPE_MIX].num[SCARLETT2_PORT_OUT] : 0;
-	for (i=0; i < num_mix_in; ++i) {
-		sw_idx = i;
-		src_port = sw_cfg->mixer_in_mux[sw_idx];
+	/* Update phantom power settings */
+	if (info->power_48v_count) {
+		for (i = 0; i < info->power_48v_count; i++)
+			private->pow_switch[i] = !! (pow_switch & (1 << i));
+	}
+
+	/* 'Retain 48V' switch */
+	if (info->has_retain48v)
+		private->retain48v_switch = !! retain48v;
+
+	/* Reset the update flag AFTER the data has been retrieved */
+	private->line_ctl_updated = 0;
+
+	return 0;
+}
+
+static int scarlett2_level_enum_ctl_info(struct snd_kcontrol *kctl,
+					 struct snd_ctl_elem_info *uinfo)
+{
+	static const char *const values[2] = {
+		"Line", "Inst"
+	};
+
+	return snd_ctl_enum_info(uinfo, 1, 2, values);
+}
+
+static int scarlett2_level_enum_ctl_get(struct snd_kcontrol *kctl,
+					struct snd_ctl_elem_value *ucontrol)
+{
+	struct usb_mixer_elem_info *elem = kctl->private_data;
+	struct usb_mixer_interface *mixer = elem->head.mixer;
+	struct scarlett2_mixer_data *private = mixer->private_data;
+
+	if (private->line_ctl_updated) {
+		scarlett2_data_lock(private);
+		scarlett2_update_line_ctl_switches(mixer);
+		scarlett2_data_unlock(private);
+	}
+
+	ucontrol->value.enumerated.item[0] = private->level_switch[elem->control];
+	return 0;
+}
+
+static int scarlett2_level_enum_ctl_put(struct snd_kcontrol *kctl,
+					struct snd_ctl_elem_value *ucontrol)
+{
+	struct usb_mixer_elem_info *elem = kctl->private_data;
+	struct usb_mixer_interface *mixer = elem->head.mixer;
+	struct scarlett2_mixer_data *private = mixer->private_data;
+	const struct scarlett2_device_info *info = private->info;
+
+	int index = elem->control;
+	int oval, val, err = 0;
+
+	scarlett2_data_lock(private);
+	scarlett2_update_line_ctl_switches(mixer);
+	oval = private->level_switch[index];
+	val = !!ucontrol->value.integer.value[0];
+
+	if (oval == val)
+		goto unlock;
+
+	private->level_switch[index] = val;
+
+	if (info->level_input_bitmask) {
+		val = 0;
+		for (index = 0; index < info->level_input_count; ++index)
+			val |= private->level_switch[index] << (index + info->level_input_offset);
+		index = 0;
+	}
+
+	/* Send inst change to the device */
+	err = scarlett2_usb_set_config(mixer, SCARLETT2_CONFIG_LEVEL_SWITCH,
+				       index, val);
+
+unlock:
+	scarlett2_data_unlock(private);
+	return err;
+}
+
+static const struct snd_kcontrol_new scarlett2_level_enum_ctl = {
+	.iface = SNDRV_CTL_ELEM_IFACE_MIXER,
+	.name = "",
+	.info = scarlett2_level_enum_ctl_info,
+	.get  = scarlett2_level_enum_ctl_get,
+	.put  = scarlett2_level_enum_ctl_put,
+};
+
+/*** Pad Switch Controls ***/
+static int scarlett2_pad_ctl_get(struct snd_kcontrol *kctl,
+				 struct snd_ctl_elem_value *ucontrol)
+{
+	struct usb_mixer_elem_info *elem = kctl->private_data;
+	struct usb_mixer_interface *mixer = elem->head.mixer;
+	struct scarlett2_mixer_data *private = mixer->private_data;
+
+	if (private->line_ctl_updated) {
+		scarlett2_data_lock(private);
+		scarlett2_update_line_ctl_switches(mixer);
+		scarlett2_data_unlock(private);
+	}
+
+	ucontrol->value.enumerated.item[0] =
+		private->pad_switch[elem->control];
+	return 0;
+}
+
+static int scarlett2_pad_ctl_put(struct snd_kcontrol *kctl,
+				 struct snd_ctl_elem_value *ucontrol)
+{
+	struct usb_mixer_elem_info *elem = kctl->private_data;
+	struct usb_mixer_interface *mixer = elem->head.mixer;
+	struct scarlett2_mixer_data *private = mixer->private_data;
+
+	int index = elem->control;
+	int oval, val, err = 0;
+
+	scarlett2_data_lock(private);
+	scarlett2_update_line_ctl_switches(mixer);
+
+	oval = private->pad_switch[index];
+	val = !!ucontrol->value.integer.value[0];
+
+	if (oval == val)
+		goto unlock;
+
+	private->pad_switch[index] = val;
+
+	/* Send pad change to the device */
+	err = scarlett2_usb_set_config(mixer, SCARLETT2_CONFIG_PAD_SWITCH, index, val);
+
+unlock:
+	scarlett2_data_unlock(private);
+	return err;
+}
+
+static const struct snd_kcontrol_new scarlett2_pad_ctl = {
+	.iface = SNDRV_CTL_ELEM_IFACE_MIXER,
+	.name = "",
+	.info = scarlett2_bool_enum_ctl_info,
+	.get  = scarlett2_pad_ctl_get,
+	.put  = scarlett2_pad_ctl_put,
+};
+
+/*** Air Switch Controls ***/
+static int scarlett2_air_ctl_get(struct snd_kcontrol *kctl,
+				 struct snd_ctl_elem_value *ucontrol)
+{
+	struct usb_mixer_elem_info *elem = kctl->private_data;
+	struct usb_mixer_interface *mixer = elem->head.mixer;
+	struct scarlett2_mixer_data *private = elem->head.mixer->private_data;
+
+	if (private->line_ctl_updated) {
+		scarlett2_data_lock(private);
+		scarlett2_update_line_ctl_switches(mixer);
+		scarlett2_data_unlock(private);
+	}
+
+	ucontrol->value.enumerated.item[0] = private->air_switch[elem->control];
+	return 0;
+}
+
+static int scarlett2_air_ctl_put(struct snd_kcontrol *kctl,
+				 struct snd_ctl_elem_value *ucontrol)
+{
+	struct usb_mixer_elem_info *elem = kctl->private_data;
+	struct usb_mixer_interface *mixer = elem->head.mixer;
+	struct scarlett2_mixer_data *private = mixer->private_data;
+	const struct scarlett2_device_info *info = private->info;
+
+	int index = elem->control;
+	int oval, val, err = 0;
+
+	scarlett2_data_lock(private);
+	scarlett2_update_line_ctl_switches(mixer);
+
+	oval = private->air_switch[index];
+	val = !!ucontrol->value.integer.value[0];
+
+	if (oval == val)
+		goto unlock;
+
+	private->air_switch[index] = val;
+
+	/* Air switches are present as bitmask? */
+	if (info->air_input_bitmask) {
+		val = 0;
+		for (index = 0; index < info->air_input_count; ++index)
+			val |= private->air_switch[index] << index;
+		index = 0;
+	}
+
+	/* Send switch change to the device */
+	err = scarlett2_usb_set_config(mixer, SCARLETT2_CONFIG_AIR_SWITCH, index, val);
+
+unlock:
+	scarlett2_data_unlock(private);
+	return err;
+}
+
+static const struct snd_kcontrol_new scarlett2_air_ctl = {
+	.iface = SNDRV_CTL_ELEM_IFACE_MIXER,
+	.name = "",
+	.info = scarlett2_bool_enum_ctl_info,
+	.get  = scarlett2_air_ctl_get,
+	.put  = scarlett2_air_ctl_put,
+};
+
+/*** 48V Switch Controls ***/
+static int scarlett2_48v_ctl_get(struct snd_kcontrol *kctl,
+				 struct snd_ctl_elem_value *ucontrol)
+{
+	struct usb_mixer_elem_info *elem = kctl->private_data;
+	struct usb_mixer_interface *mixer = elem->head.mixer;
+	struct scarlett2_mixer_data *private = mixer->private_data;
+
+	if (private->line_ctl_updated) {
+		scarlett2_data_lock(private);
+		scarlett2_update_line_ctl_switches(mixer);
+		scarlett2_data_unlock(private);
+	}
+
+	ucontrol->value.enumerated.item[0] = private->pow_switch[elem->control];
+	return 0;
+}
+
+static int scarlett2_48v_ctl_put(struct snd_kcontrol *kctl,
+				 struct snd_ctl_elem_value *ucontrol)
+{
+	struct usb_mixer_elem_info *elem = kctl->private_data;
+	struct usb_mixer_interface *mixer = elem->head.mixer;
+	struct scarlett2_mixer_data *private = mixer->private_data;
+	const struct scarlett2_device_info *info = private->info;
+
+	int index = elem->control;
+	int i, oval, val, err = 0;
+
+	scarlett2_data_lock(private);
+	scarlett2_update_line_ctl_switches(mixer);
+	oval = private->pow_switch[index];
+	val = !!ucontrol->value.integer.value[0];
+
+	if (oval == val)
+		goto unlock;
+
+	private->pow_switch[index] = val;
+
+	val = 0;
+	for (i = 0; i < info->power_48v_count; ++i)
+		val |= (private->pow_switch[i] << i);
+
+	/* Send switch change to the device */
+	err = scarlett2_usb_set_config(mixer, SCARLETT2_CONFIG_48V_SWITCH, 0, val);
+
+unlock:
+	scarlett2_data_unlock(private);
+	return err;
+}
+
+static const struct snd_kcontrol_new scarlett2_48v_ctl = {
+	.iface = SNDRV_CTL_ELEM_IFACE_MIXER,
+	.name = "",
+	.info = scarlett2_bool_enum_ctl_info,
+	.get  = scarlett2_48v_ctl_get,
+	.put  = scarlett2_48v_ctl_put
+};
+
+/* Retain 48V Switch Control */
+static int scarlett2_retain48v_ctl_get(struct snd_kcontrol *kctl,
+				 struct snd_ctl_elem_value *ucontrol)
+{
+	struct usb_mixer_elem_info *elem = kctl->private_data;
+	struct usb_mixer_interface *mixer = elem->head.mixer;
+	struct scarlett2_mixer_data *private = mixer->private_data;
+
+	ucontrol->value.enumerated.item[0] = private->retain48v_switch;
+	return 0;
+}
+
+
+static int scarlett2_retain48v_ctl_put(struct snd_kcontrol *kctl,
+				 struct snd_ctl_elem_value *ucontrol)
+{
+	struct usb_mixer_elem_info *elem = kctl->private_data;
+	struct usb_mixer_interface *mixer = elem->head.mixer;
+	struct scarlett2_mixer_data *private = mixer->private_data;
+
+	int oval, val, err = 0;
+
+	scarlett2_data_lock(private);
+	scarlett2_update_line_ctl_switches(mixer);
+	oval = private->retain48v_switch;
+	val = !!ucontrol->value.integer.value[0];
+
+	if (oval == val)
+		goto unlock;
+
+	private->retain48v_switch = val;
+
+	/* Send switch change to the device */
+	err = scarlett2_usb_set_config(mixer, SCARLETT2_CONFIG_RETAIN_48V, 0, val);
+
+unlock:
+	scarlett2_data_unlock(private);
+	return err;
+}
+
+static const struct snd_kcontrol_new scarlett2_retain48v_ctl = {
+	.iface = SNDRV_CTL_ELEM_IFACE_MIXER,
+	.name = "",
+	.info = scarlett2_bool_enum_ctl_info,
+	.get  = scarlett2_retain48v_ctl_get,
+	.put  = scarlett2_retain48v_ctl_put
+};
+
+/*** Mute/Dim Controls ***/
+
+static int scarlett2_button_ctl_get(struct snd_kcontrol *kctl,
+				    struct snd_ctl_elem_value *ucontrol)
+{
+	struct usb_mixer_elem_info *elem = kctl->private_data;
+	struct usb_mixer_interface *mixer = elem->head.mixer;
+	struct scarlett2_mixer_data *private = mixer->private_data;
+
+	if (private->vol_updated) {
+		scarlett2_data_lock(private);
+		scarlett2_update_volumes(mixer);
+		scarlett2_data_unlock(private);
+	}
+
+	ucontrol->value.enumerated.item[0] = private->buttons[elem->control];
+	return 0;
+}
+
+static int scarlett2_button_ctl_put(struct snd_kcontrol *kctl,
+				    struct snd_ctl_elem_value *ucontrol)
+{
+	struct usb_mixer_elem_info *elem = kctl->private_data;
+	struct usb_mixer_interface *mixer = elem->head.mixer;
+	struct scarlett2_mixer_data *private = mixer->private_data;
+
+	int index = elem->control;
+	int oval, val, err = 0;
+
+	scarlett2_data_lock(private);
+	scarlett2_update_volumes(mixer);
+
+	oval = private->buttons[index];
+	val = !!ucontrol->value.integer.value[0];
+
+	if (oval == val)
+		goto unlock;
+
+	private->buttons[index] = val;
+
+	/* Send switch change to the device */
+	err = scarlett2_usb_set_config(mixer, SCARLETT2_CONFIG_BUTTONS,
+				       index, val);
+
+unlock:
+	scarlett2_data_unlock(private);
+	return err;
+}
+
+static const struct snd_kcontrol_new scarlett2_button_ctl = {
+	.iface = SNDRV_CTL_ELEM_IFACE_MIXER,
+	.name = "",
+	.info = scarlett2_bool_enum_ctl_info,
+	.get  = scarlett2_button_ctl_get,
+	.put  = scarlett2_button_ctl_put
+};
+
+/*** Mute for each output ***/
+static int scarlett2_mute_ctl_get(struct snd_kcontrol *kctl,
+				    struct snd_ctl_elem_value *ucontrol)
+{
+	struct usb_mixer_elem_info *elem = kctl->private_data;
+	struct usb_mixer_interface *mixer = elem->head.mixer;
+	struct scarlett2_mixer_data *private = mixer->private_data;
+
+	if (private->vol_updated) {
+		scarlett2_data_lock(private);
+		scarlett2_update_volumes(mixer);
+		scarlett2_data_unlock(private);
+	}
+
+	ucontrol->value.enumerated.item[0] = ! private->mutes[elem->control];
+	return 0;
+}
+
+static int scarlett2_mute_ctl_put(struct snd_kcontrol *kctl,
+				    struct snd_ctl_elem_value *ucontrol)
+{
+	struct usb_mixer_elem_info *elem = kctl->private_data;
+	struct usb_mixer_interface *mixer = elem->head.mixer;
+	struct scarlett2_mixer_data *private = mixer->private_data;
+	const struct scarlett2_device_info *info = private->info;
+
+	int analog_outs = info->ports[SCARLETT2_PORT_TYPE_ANALOGUE].num[SCARLETT2_PORT_OUT];
+	int index = elem->control;
+	int oval, val, err = 0;
+	u32 mutes;
+
+	scarlett2_data_lock(private);
+	scarlett2_update_volumes(mixer);
+
+	oval = private->mutes[index];
+	val = !ucontrol->value.integer.value[0];
+	if (oval == val)
+		goto unlock;
+
+	private->mutes[index] = val;
+
+	/* Update mute controls */
+	if ((info->has_hw_volume) && (index < analog_outs)) {
+		/* Update state of hardware configuration */
+		err = scarlett2_usb_set_config(mixer, SCARLETT2_CONFIG_MUTES, index, val);
+	}
+	else if ((info->has_mux) && (private->sw_cfg != NULL)) {
+		/* Set mute bit for the corresponding output */
+		mutes = le32_to_cpu(private->sw_cfg->mute_sw);
+		index = 1 << index;
+		mutes = (val) ? (mutes | index) : (mutes & (~index));
+		private->sw_cfg->mute_sw = cpu_to_le32(mutes);
+
+		/* Update software configuration */
+		err = scarlett2_commit_software_config(mixer, &private->sw_cfg->mute_sw, sizeof(__le32));
+		if (err < 0)
+			goto unlock;
+
+		/* Update MUX settings as it does the original software */
+		err = scarlett2_usb_set_mux(mixer);
+	}
+	else
+		err = -EINVAL;
+
+unlock:
+	scarlett2_data_unlock(private);
+	return err;
+}
+
+static const struct snd_kcontrol_new scarlett2_mute_ctl = {
+	.iface = SNDRV_CTL_ELEM_IFACE_MIXER,
+	.name = "",
+	.info = snd_ctl_boolean_mono_info,
+	.get  = scarlett2_mute_ctl_get,
+	.put  = scarlett2_mute_ctl_put
+};
+
+static int scarlett2_add_mute_ctls(struct usb_mixer_interface *mixer)
+{
+	struct scarlett2_mixer_data *private = mixer->private_data;
+	const struct scarlett2_device_info *info = private->info;
+	char s[SNDRV_CTL_ELEM_ID_NAME_MAXLEN];
+	u32 sw_mutes;
+
+	int num_line_out  = info->ports[SCARLETT2_PORT_TYPE_ANALOGUE].num[SCARLETT2_PORT_OUT];
+	int num_spdif_out = info->ports[SCARLETT2_PORT_TYPE_SPDIF].num[SCARLETT2_PORT_OUT];
+	int num_adat_out  = info->ports[SCARLETT2_PORT_TYPE_ADAT].num[SCARLETT2_PORT_OUT];
+	int err, i, port, index = 0;
+
+	/* Add mutes for line outputs, the hardware state has been read by
+	 * scarlett2_read_configs()
+	 */
+	if (info->has_hw_volume) {
+		for (i=0; i<num_line_out; ++i, ++index) {
+			/* Format the mute switch name */
+			port = scarlett2_get_port_num(info->ports, SCARLETT2_PORT_OUT, SCARLETT2_PORT_TYPE_ANALOGUE, i);
+			scarlett2_fmt_port_name(s, SNDRV_CTL_ELEM_ID_NAME_MAXLEN, "%s Mute", info, SCARLETT2_PORT_OUT, port);
+
+			/* Add port to list */
+			err = scarlett2_add_new_ctl(mixer,
+					    &scarlett2_mute_ctl,
+					    index, 1, s, &private->mute_ctls[index]);
+			if (err < 0)
+				return err;
+		}
+	}
+
+	/* Software mutes */
+	if (info->has_mux && private->sw_cfg) {
+		/* Read state of mutes from software config */
+		sw_mutes = le32_to_cpu(private->sw_cfg->mute_sw);
+
+		/* Add mutes for S/PDIF outputs */
+		for (i=0; i<num_spdif_out; ++i, ++index) {
+			/* Read software mute settings */
+			private->mutes[index] = !! (sw_mutes & (1 << index));
+
+			/* Format the mute switch name */
+			port = scarlett2_get_port_num(info->ports, SCARLETT2_PORT_OUT, SCARLETT2_PORT_TYPE_SPDIF, i);
+			scarlett2_fmt_port_name(s, SNDRV_CTL_ELEM_ID_NAME_MAXLEN, "%s Mute", info, SCARLETT2_PORT_OUT, port);
+
+			/* Add port to list */
+			err = scarlett2_add_new_ctl(mixer,
+					    &scarlett2_mute_ctl,
+					    index, 1, s, &private->mute_ctls[index]);
+			if (err < 0)
+				return err;
+		}
+
+		/* Add mutes for ADAT outputs */
+		for (i=0; i<num_adat_out; ++i, ++index) {
+			/* Read software mute settings */
+			private->mutes[index] = !! (sw_mutes & (1 << index));
+
+			/* Format the mute switch name */
+			port = scarlett2_get_port_num(info->ports, SCARLETT2_PORT_OUT, SCARLETT2_PORT_TYPE_ADAT, i);
+			scarlett2_fmt_port_name(s, SNDRV_CTL_ELEM_ID_NAME_MAXLEN, "%s Mute", info, SCARLETT2_PORT_OUT, port);
+
+			/* Add port to list */
+			err = scarlett2_add_new_ctl(mixer,
+						    &scarlett2_mute_ctl,
+						    index, 1, s, &private->mute_ctls[index]);
+			if (err < 0)
+				return err;
+		}
+	}
+
+	return 0;
+}
+
+/*** Create the analogue output controls ***/
+static int scarlett2_add_line_out_ctls(struct usb_mixer_interface *mixer)
+{
+	struct scarlett2_mixer_data *private = mixer->private_data;
+	const struct scarlett2_device_info *info = private->info;
+	const struct scarlett2_ports *ports = info->ports;
+	int num_line_out = ports[SCARLETT2_PORT_TYPE_ANALOGUE].num[SCARLETT2_PORT_OUT];
+	struct scarlett2_config_write writes[SCARLETT2_ANALOGUE_OUT_MAX];
+	int err, i, port;
+	s16 level;
+	char s[SNDRV_CTL_ELEM_ID_NAME_MAXLEN];
+
+	/* Add R/O HW volume control */
+	if (info->line_out_hw_vol) {
+		snprintf(s, sizeof(s), "Master Playback Volume");
+		err = scarlett2_add_new_ctl(mixer,
+					    &scarlett2_master_volume_ctl,
+					    0, 1, s, &private->master_vol_ctl);
+		if (err < 0)
+			return err;
+	}
+
+	/* Add volume controls */
+	if (info->has_hw_volume) {
+		for (i = 0; i < num_line_out; i++) {
+			/* Volume Fader */
+			port = scarlett2_get_port_num(info->ports, SCARLETT2_PORT_OUT, SCARLETT2_PORT_TYPE_ANALOGUE, i);
+			scarlett2_fmt_port_name(s, SNDRV_CTL_ELEM_ID_NAME_MAXLEN, "%s Volume", info, SCARLETT2_PORT_OUT, port);
+			err = scarlett2_add_new_ctl(mixer,
+					    &scarlett2_line_out_volume_ctl,
+					    i, 1, s, &private->vol_ctls[i]);
+			if (err < 0)
+				return err;
+
+			/* Initialize the value with software configuration
+			 * Make the fader read-only if the SW/HW switch is set to HW
+			 */
+			if ((private->sw_cfg) && (!private->vol_sw_hw_switch[i])) {
+				level  = le16_to_cpu(private->sw_cfg->volume[i].volume);
+				private->vol[i] = clamp(level + SCARLETT2_VOLUME_BIAS, 0, SCARLETT2_VOLUME_BIAS);
+				private->vol_ctls[i]->vd[0].access |= SNDRV_CTL_ELEM_ACCESS_WRITE;
+			}
+			else {
+				private->vol[i] = private->master_vol;
+				private->vol_ctls[i]->vd[0].access &= ~SNDRV_CTL_ELEM_ACCESS_WRITE;
+			}
+
+			/* SW/HW Switch */
+			if (info->line_out_hw_vol) {
+				scarlett2_fmt_port_name(s, SNDRV_CTL_ELEM_ID_NAME_MAXLEN, "%s Control", info, SCARLETT2_PORT_OUT, port);
+				err = scarlett2_add_new_ctl(mixer,
+							    &scarlett2_sw_hw_enum_ctl,
+							    i, 1, s, NULL);
+				if (err < 0)
+					return err;
+			}
+		}
+	}
+
+	/* Add HW button controls */
+	for (i = 0; i < private->info->button_count; i++) {
+		err = scarlett2_add_new_ctl(mixer, &scarlett2_button_ctl,
+					    i, 1, scarlett2_button_names[i],
+					    &private->button_ctls[i]);
+		if (err < 0)
+			return err;
+	}
+
+	/* Commit actual volumes with one request */
+	if (private->sw_cfg) {
+		for (i = 0; i < num_line_out; i++)
+			writes[i] = (struct scarlett2_config_write) {
+				SCARLETT2_CONFIG_LINE_OUT_VOLUME, i, private->vol[i] - SCARLETT2_VOLUME_BIAS
+			};
+		err = scarlett2_usb_set_config_multi(mixer, writes, num_line_out);
+		if (err < 0)
+			return err;
+	}
+
+	return err;
+}
+
+/*** Create the analogue input controls ***/
+static int scarlett2_add_line_in_ctls(struct usb_mixer_interface *mixer)
+{
+	struct scarlett2_mixer_data *private = mixer->private_data;
+	const struct scarlett2_device_info *info = private->info;
+	int err, i, port;
+	char s[SNDRV_CTL_ELEM_ID_NAME_MAXLEN];
+
+	/* Add input level (line/inst) controls */
+	for (i = 0; i < info->level_input_count; i++) {
+		port = scarlett2_get_port_num(info->ports, SCARLETT2_PORT_OUT, SCARLETT2_PORT_TYPE_ANALOGUE, i + info->level_input_offset);
+		scarlett2_fmt_port_name(s, SNDRV_CTL_ELEM_ID_NAME_MAXLEN, "%s Mode Switch", info, SCARLETT2_PORT_IN, port);
+		err = scarlett2_add_new_ctl(mixer, &scarlett2_level_enum_ctl,
+					    i, 1, s, &private->level_ctls[i]);
+		if (err < 0)
+			return err;
+	}
+
+	/* Add input pad controls */
+	for (i = 0; i < info->pad_input_count; i++) {
+		port = scarlett2_get_port_num(info->ports, SCARLETT2_PORT_OUT, SCARLETT2_PORT_TYPE_ANALOGUE, i);
+		scarlett2_fmt_port_name(s, SNDRV_CTL_ELEM_ID_NAME_MAXLEN, "%s Pad Switch", info, SCARLETT2_PORT_IN, port);
+
+		err = scarlett2_add_new_ctl(mixer, &scarlett2_pad_ctl,
+					    i, 1, s, &private->pad_ctls[i]);
+		if (err < 0)
+			return err;
+	}
+
+	/* Add input air controls */
+	for (i = 0; i < info->air_input_count; i++) {
+		port = scarlett2_get_port_num(info->ports, SCARLETT2_PORT_OUT, SCARLETT2_PORT_TYPE_ANALOGUE, i);
+		scarlett2_fmt_port_name(s, SNDRV_CTL_ELEM_ID_NAME_MAXLEN, "%s Air Switch", info, SCARLETT2_PORT_IN, port);
+
+		err = scarlett2_add_new_ctl(mixer, &scarlett2_air_ctl,
+					    i, 1, s, &private->air_ctls[i]);
+		if (err < 0)
+			return err;
+	}
+
+	/* Add input 48v controls */
+	for (i = 0; i < info->power_48v_count; i++) {
+		if (info->power_48v_count > 1)
+			snprintf(s, sizeof(s), "Analogue In 48V Switch %d", i + 1);
+		else
+			snprintf(s, sizeof(s), "Analogue In 48V Switch");
+		err = scarlett2_add_new_ctl(mixer, &scarlett2_48v_ctl,
+					    i, 1, s, &private->pow_ctls[i]);
+		if (err < 0)
+			return err;
+	}
+
+	/* Add 'Retain 48v' control */
+	if (info->has_retain48v) {
+		err = scarlett2_add_new_ctl(mixer, &scarlett2_retain48v_ctl,
+					    0, 1, "Analogue In 48V Retain", NULL);
+		if (err < 0)
+			return err;
+	}
+
+	return 0;
+}
+
+/*** Create the Gain Halo controls ***/
+static int scarlett2_add_ghalo_ctls(struct usb_mixer_interface *mixer)
+{
+	struct scarlett2_mixer_data *private = mixer->private_data;
+	const struct scarlett2_device_info *info = private->info;
+	int err, i;
+	char s[SNDRV_CTL_ELEM_ID_NAME_MAXLEN];
+	static const char * const level_names[SCARLETT2_GAIN_HALO_LEVELS] = {
+		"LED Clip Color",
+		"LED Pre-Clip Color",
+		"LED Good Color"
+	};
+
+	/* Check that device supports gain halos */
+	if (info->gain_halos_count <= 0)
+		return 0;
+
+	/* The settings have been read by scarlett2_read_configs() */
+
+	/* Add custom color control */
+	err = scarlett2_add_new_ctl(mixer, &scarlett2_ghalo_custom_ctl, 0, 1, "LED Custom Colors",
+				    &private->ghalo_custom_ctl);
+	if (err < 0)
+		return err;
+
+	/* Add level color controls */
+	for (i = 0; i < SCARLETT2_GAIN_HALO_LEVELS; i++) {
+		err = scarlett2_add_new_ctl(mixer, &scarlett2_ghalo_level_ctl, i, 1, level_names[i],
+					    &private->ghalo_level_ctls[i]);
+		if (err < 0)
+			return err;
+	}
+
+	/* Add custom color controls */
+	for (i = 0; i<info->gain_halos_count; ++i) {
+		snprintf(s, SNDRV_CTL_ELEM_ID_NAME_MAXLEN, "LED %d Custom Color", i);
+		err = scarlett2_add_new_ctl(mixer, &scarlett2_ghalo_led_ctl, i, 1, s,
+					    &private->ghalo_led_ctls[i]);
+		if (err < 0)
+			return err;
+	}
+
+	/* Add the control programming the whole scheme at once */
+	return scarlett2_add_new_ctl(mixer, &scarlett2_ghalo_scheme_ctl, 0,
+				     1 + SCARLETT2_GAIN_HALO_LEVELS + info->gain_halos_count,
+				     "LED Color Scheme", &private->ghalo_scheme_ctl);
+}
+
+/*** Mixer Volume Controls ***/
+static int scarlett2_mixer_ctl_info(struct snd_kcontrol *kctl,
+				    struct snd_ctl_elem_info *uinfo)
+{
+	struct usb_mixer_elem_info *elem = kctl->private_data;
+
+	uinfo->type = SNDRV_CTL_ELEM_TYPE_INTEGER;
+	uinfo->count = elem->channels;
+	uinfo->value.integer.min = 0;
+	uinfo->value.integer.max = SCARLETT2_MIXER_MAX_VALUE;
+	uinfo->value.integer.step = 1;
+	return 0;
+}
+
+static int scarlett2_mixer_ctl_get(struct snd_kcontrol *kctl,
+				   struct snd_ctl_elem_value *ucontrol)
+{
+	struct usb_mixer_elem_info *elem = kctl->private_data;
+	struct scarlett2_mixer_data *private = elem->head.mixer->private_data;
+
+	ucontrol->value.integer.value[0] = private->mix[elem->control];
+	return 0;
+}
+
+static int scarlett2_mixer_ctl_put(struct snd_kcontrol *kctl,
+				   struct snd_ctl_elem_value *ucontrol)
+{
+	struct usb_mixer_elem_info *elem = kctl->private_data;
+	struct usb_mixer_interface *mixer = elem->head.mixer;
+	struct scarlett2_mixer_data *private = mixer->private_data;
+	int oval, val, mix_num, input_num, err = 0;
+	int index = elem->control;
+	u32 level;
+	__le32 *gain;
+
+	scarlett2_data_lock(private);
+
+	oval      = private->mix[index];
+	val       = ucontrol->value.integer.value[0];
+	mix_num   = index / SCARLETT2_INPUT_MIX_MAX;
+	input_num = index % SCARLETT2_INPUT_MIX_MAX;
+
+	if (oval == val)
+		goto unlock;
+
+	private->mix[index] = val;
+	err = scarlett2_usb_set_mix(mixer, mix_num);
+	if (err < 0)
+		goto unlock;
+
+	/* Update software configuration data */
+	level = scarlett2_sw_config_mixer_values[val];
+	gain  = &private->sw_cfg->mixer[mix_num][input_num];
+	*gain = cpu_to_le32(level << 16); /* Convert to F32LE */
+
+	scarlett2_commit_software_config(mixer, gain, sizeof(__le32));
+
+	if (err == 0)
+		err = 1;
+
+unlock:
+	scarlett2_data_unlock(private);
+	return err;
+}
+
+static const DECLARE_TLV_DB_MINMAX(
+	db_scale_scarlett2_mixer,
+	SCARLETT2_MIXER_MIN_DB * 100,
+	SCARLETT2_MIXER_MAX_DB * 100
+);
+
+static const struct snd_kcontrol_new scarlett2_mixer_ctl = {
+	.iface = SNDRV_CTL_ELEM_IFACE_MIXER,
+	.access = SNDRV_CTL_ELEM_ACCESS_READWRITE |
+		  SNDRV_CTL_ELEM_ACCESS_TLV_READ,
+	.name = "",
+	.info = scarlett2_mixer_ctl_info,
+	.get  = scarlett2_mixer_ctl_get,
+	.put  = scarlett2_mixer_ctl_put,
+	.private_value = SCARLETT2_MIXER_MAX_DB, /* max value */
+	.tlv = { .p = db_scale_scarlett2_mixer }
+};
+
+/*** Mixer Mute Controls ***/
+static int scarlett2_mixer_mute_ctl_get(struct snd_kcontrol *kctl,
+				    struct snd_ctl_elem_value *ucontrol)
+{
+	struct usb_mixer_elem_info *elem = kctl->private_data;
+	struct usb_mixer_interface *mixer = elem->head.mixer;
+	struct scarlett2_mixer_data *private = mixer->private_data;
+
+	ucontrol->value.enumerated.item[0] = !private->mix_mutes[elem->control];
+	return 0;
+}
+
+static int scarlett2_mixer_mute_ctl_put(struct snd_kcontrol *kctl,
+				    struct snd_ctl_elem_value *ucontrol)
+{
+	struct usb_mixer_elem_info *elem = kctl->private_data;
+	struct usb_mixer_interface *mixer = elem->head.mixer;
+	struct scarlett2_mixer_data *private = mixer->private_data;
+	const struct scarlett2_device_info *info = private->info;
+	struct scarlett2_sw_cfg *sw_cfg = private->sw_cfg;
+
+	int num_inputs = info->ports[SCARLETT2_PORT_TYPE_MIX].num[SCARLETT2_PORT_OUT];
+	int index = elem->control;
+	int i, oval, val, err = 0;
+	int mix_num;
+	u8 *mutes;
+	u32 mask;
+
+	scarlett2_data_lock(private);
+
+	oval = private->mix_mutes[index];
+	val = !ucontrol->value.integer.value[0];
+	if (oval == val)
+		goto unlock;
+
+	private->mix_mutes[index] = val;
+
+	/* Compute the mixer to update */
+	mix_num   = index / SCARLETT2_INPUT_MIX_MAX;
+
+	if (sw_cfg != NULL) {
+		/* Build the mute mask */
+		mutes = &private->mix_mutes[mix_num * SCARLETT2_INPUT_MIX_MAX];
+		mask = 0;
+		for (i = 0; i < num_inputs; ++i)
+			mask |= mutes[i] << i;
+
+		/* Update software config for corresponding mixer */
+		sw_cfg->mixer_mute[mix_num] = cpu_to_le32(mask);
+		err = scarlett2_commit_software_config(mixer, &sw_cfg->mixer_mute[mix_num], sizeof(__le32));
+		if (err < 0)
+			goto unlock;
+	}
+
+	/* Update MIX settings as it does the original software */
+	err = scarlett2_usb_set_mix(mixer, mix_num);
+
+unlock:
+	scarlett2_data_unlock(private);
+	return err;
+}
+
+static const struct snd_kcontrol_new scarlett2_mixer_mute_ctl = {
+	.iface = SNDRV_CTL_ELEM_IFACE_MIXER,
+	.name = "",
+	.info = snd_ctl_boolean_mono_info,
+	.get  = scarlett2_mixer_mute_ctl_get,
+	.put  = scarlett2_mixer_mute_ctl_put
+};
+
+static int scarlett2_add_mixer_ctls(struct usb_mixer_interface *mixer)
+{
+	struct scarlett2_mixer_data *private = mixer->private_data;
+	const struct scarlett2_ports *ports = private->info->ports;
+	struct scarlett2_sw_cfg *sw_cfg = private->sw_cfg;
+
+	int err, i, j;
+	int mix_idx, num_inputs, num_outputs;
+	char s[SNDRV_CTL_ELEM_ID_NAME_MAXLEN];
+	u32 level, mask;
+
+	/* Check that device has mixer */
+	if (!private->info->has_mixer)
+		return 0;
+
+	num_inputs  = ports[SCARLETT2_PORT_TYPE_MIX].num[SCARLETT2_PORT_OUT];
+	num_outputs = ports[SCARLETT2_PORT_TYPE_MIX].num[SCARLETT2_PORT_IN];
+
+	/* For each mixer */
+	for (i=0; i<num_outputs; ++i) {
+		mix_idx   = i * SCARLETT2_INPUT_MIX_MAX;
+
+		/* Decode software config for mixer channel */
+		mask = (sw_cfg) ? le32_to_cpu(sw_cfg->mixer_mute[i]) : 0;
+
+		/* Add Mix control */
+		for (j = 0; j < num_inputs; ++j, ++mix_idx) {
+			level = le32_to_cpu(private->sw_cfg->mixer[i][j]);
+			private->mix[mix_idx] = scarlett2_float_to_mixer_level(level) - (SCARLETT2_MIXER_MIN_DB * 2);
+			private->mix_mutes[mix_idx] = !!(mask & (1 << j));
+
+			/* Add Mixer volume control */
+			snprintf(s, sizeof(s), "Mix %c In %02d Volume", 'A' + i, j + 1);
+			err = scarlett2_add_new_ctl(mixer, &scarlett2_mixer_ctl, mix_idx, 1, s,
+						    &private->mix_ctls[mix_idx]);
+			if (err < 0)
+				return err;
+
+			/* Add Mixer mute control */
+			snprintf(s, sizeof(s), "Mix %c In %02d Switch", 'A' + i, j + 1);
+			err = scarlett2_add_new_ctl(mixer, &scarlett2_mixer_mute_ctl, mix_idx, 1, s,
+						    &private->mix_mute_ctls[mix_idx]);
+			if (err < 0)
+				return err;
+		}
+
+		/* Commit the actual mix state at startup */
+		err = scarlett2_usb_set_mix(mixer, i);
+		if (err < 0)
+			return err;
+	}
+
+	return 0;
+}
+
+/*** Mux Source Selection Controls ***/
+static int scarlett2_mux_src_enum_ctl_info(struct snd_kcontrol *kctl,
+					   struct snd_ctl_elem_info *uinfo)
+{
+	struct usb_mixer_elem_info *elem = kctl->private_data;
+	struct usb_mixer_interface *mixer = elem->head.mixer;
+	struct scarlett2_mixer_data *private = mixer->private_data;
+	int item = uinfo->value.enumerated.item;
+	int items = private->num_inputs + 1;
+	int port = clamp(item, 0, private->num_inputs) - 1;
+
+	uinfo->type  = SNDRV_CTL_ELEM_TYPE_ENUMERATED;
+	uinfo->count = elem->channels;
+	uinfo->value.enumerated.items = items;
+	if (!items)
+		return 0;
+	if (item >= items)
+		item = uinfo->value.enumerated.item = items - 1;
+
+	scarlett2_fmt_port_name(uinfo->value.enumerated.name,
+	                        sizeof(uinfo->value.enumerated.name),
+	                        "%s",
+	                        private->info,
+	                        SCARLETT2_PORT_IN, port);
+
+	return 0;
+}
+
+static int scarlett2_mux_src_enum_ctl_get(struct snd_kcontrol *kctl,
+					  struct snd_ctl_elem_value *ucontrol)
+{
+	struct usb_mixer_elem_info *elem = kctl->private_data;
+	struct scarlett2_mixer_data *private = elem->head.mixer->private_data;
+
+	ucontrol->value.enumerated.item[0] = private->mux[elem->control] + 1; /* Element 0 is always 'Off' */
+	return 0;
+}
+
+/* Stage the software configuration changes of the routing; called
+ * within a transaction
+ */
+static int scarlett2_commit_sw_routing(struct usb_mixer_interface *mixer, int src_port, int dst_port) {
+	struct scarlett2_mixer_data *private = mixer->private_data;
+	const struct scarlett2_device_info *info = private->info;
+	struct scarlett2_sw_cfg *sw_cfg = private->sw_cfg;
+	int err, i;
+	int num_mixer_ins;
+	int dst_port_type, dst_port_num;
+	int src_port_type, src_port_num;
+	int in_idx, out_idx, op_idx;
+	char src[SNDRV_CTL_ELEM_ID_NAME_MAXLEN], dst[SNDRV_CTL_ELEM_ID_NAME_MAXLEN];
+	u32 mask;
+
+	/* Nothing to do if there is no software config */
+	if ((!sw_cfg) || (!info->sw_port_mapping))
+		return 0;
+
+	/* Decoded port OK? */
+	err = scarlett2_decode_port(&dst_port_type, &dst_port_num, info->ports, SCARLETT2_PORT_OUT, dst_port);
+	if (err < 0)
+		return 0;
+
+	/* DEBUG: output routing information */
+	scarlett2_fmt_port_name(src, SNDRV_CTL_ELEM_ID_NAME_MAXLEN, "%s", info, SCARLETT2_PORT_IN, src_port);
+	scarlett2_fmt_port_name(dst, SNDRV_CTL_ELEM_ID_NAME_MAXLEN, "%s", info, SCARLETT2_PORT_OUT, dst_port);
+
+	if (dst_port_type == SCARLETT2_PORT_TYPE_MIX) {
+		/* Decode input port index */
+		in_idx  = scarlett2_drv2sw_port_num(info->ports, info->sw_port_mapping, SCARLETT2_PORT_IN, src_port);
+		if (in_idx < 0)
+			return 0;
+
+		/* If output is working in stereo mode - switch it into mono mode */
+		if (sw_cfg->mixer_in_map[dst_port_num] & 0x80) {
+			/* Eliminate the 'FAT'-style allocation table for mixer lines */
+			num_mixer_ins = info->ports[SCARLETT2_PORT_TYPE_MIX].num[SCARLETT2_PORT_OUT];
+			for (i = 0; i < num_mixer_ins; ++i) {
+				/* The stereo pair should have bit 7 set */
+				op_idx = sw_cfg->mixer_in_map[i];
+				if (!(op_idx & 0x80))
+					continue;
+
+				/* The beginning of stereo pair should refer next channel (non-zero value) */
+				op_idx &= 0x7f;
+				if ((!op_idx) || (op_idx >= num_mixer_ins))
+					continue;
+
+				/* The current channel or referenced channel should match mixer index */
+				if ((i == dst_port_num) || (op_idx == dst_port_num)) {
+					sw_cfg->mixer_in_map[i]      = 0;
+					sw_cfg->mixer_in_map[op_idx] = 0;
+					err = scarlett2_commit_software_config(mixer, &sw_cfg->mixer_in_map, sizeof(u8) * num_mixer_ins);
+					if (err < 0)
+						return err;
+					break;
+				}
+			}
+		}
+
+		/* Now we can update software configuration to set up proper routing */
+		sw_cfg->mixer_in_mux[dst_port_num] = in_idx + 1;
+		err = scarlett2_commit_software_config(mixer, &sw_cfg->mixer_in_mux[dst_port_num], sizeof(u8));
+		if (err < 0)
+			return err;
+	}
+	else {
+		/* Decode source port type */
+		err = scarlett2_decode_port(&src_port_type, &src_port_num, info->ports, SCARLETT2_PORT_IN, src_port);
+		if (err < 0)
+			return 0;
+
+		/* Check that output is valid */
+		out_idx = scarlett2_get_sw_port_num(info->sw_port_mapping, SCARLETT2_PORT_OUT, dst_port_type, dst_port_num);
+		if (out_idx < 0)
+			return 0;
+		op_idx  = out_idx & (~1);
+
+		/* If output is working in stereo mode - switch it into mono mode */
+		mask    = le32_to_cpu(sw_cfg->stereo_sw);
+		if (mask & (3 << op_idx)) {
+			mask &= ~(3 << op_idx);
+
+			/* Reset stereo mask for output channel */
+			sw_cfg->stereo_sw = cpu_to_le32(mask);
+			err = scarlett2_commit_software_config(mixer, &sw_cfg->stereo_sw, sizeof(__le32));
+			if (err < 0)
+				return err;
+
+			/* Update routing for odd output channel if it is required */
+			if (sw_cfg->out_mux[op_idx+1] != (sw_cfg->out_mux[op_idx]+1)) {
+				sw_cfg->out_mux[op_idx+1] = sw_cfg->out_mux[op_idx] + 1;
+				err = scarlett2_commit_software_config(mixer, &sw_cfg->out_mux[op_idx], sizeof(u8) * 2);
+				if (err < 0)
+					return err;
+			}
+
+			/* Update mixer usage mask if mixer is enabled */
+			mask = le32_to_cpu(sw_cfg->mixer_bind);
+			if ((mask >> op_idx) & 3) { /* For mixer enabled for channels both bits should be 0 */
+				mask &= ~(3 << op_idx);
+				sw_cfg->mixer_bind = cpu_to_le32(mask);
+				err = scarlett2_commit_software_config(mixer, &sw_cfg->mixer_bind, sizeof(__le32));
+				if (err < 0)
+					return err;
+			}
+		}
+
+		/* Perform routing depending on the source port type */
+		mask = le32_to_cpu(sw_cfg->mixer_bind);
+		if (src_port_type == SCARLETT2_PORT_TYPE_MIX) {
+			in_idx = src_port_num;
+			/* Reset the mixer usage mask */
+			mask  &= ~(1 << out_idx);
+		} else {
+			in_idx = scarlett2_get_sw_port_num(info->sw_port_mapping, SCARLETT2_PORT_IN, src_port_type, src_port_num);
+			mask  |= (1 << out_idx);
+		}
+
+		/* Update mixer settings */
+		sw_cfg->mixer_bind = cpu_to_le32(mask);
+		err = scarlett2_commit_software_config(mixer, &sw_cfg->mixer_bind, sizeof(__le32));
+		if (err < 0)
+			return err;
+
+		/* Now we can update software configuration to set up proper routing */
+		sw_cfg->out_mux[out_idx] = in_idx + 1;
+		err = scarlett2_commit_software_config(mixer, &sw_cfg->out_mux[out_idx], sizeof(u8));
+		if (err < 0)
+			return err;
+	}
+
+	return 0;
+}
+
+static int scarlett2_mux_src_enum_ctl_put(struct snd_kcontrol *kctl,
+					  struct snd_ctl_elem_value *ucontrol)
+{
+	struct usb_mixer_elem_info *elem = kctl->private_data;
+	struct usb_mixer_interface *mixer = elem->head.mixer;
+	struct scarlett2_mixer_data *private = mixer->private_data;
+	int index = elem->control;
+	int oval, val, err = 0;
+
+	scarlett2_data_lock(private);
+
+	oval = private->mux[index];
+	val  = ucontrol->value.integer.value[0];
+	val  = clamp(val, 0, private->num_inputs) - 1;
+
+	if (oval == val)
+		goto unlock;
+
+	/* Update routing for software configuration */
+	scarlett2_sw_cfg_txn_begin(mixer);
+	err = scarlett2_commit_sw_routing(mixer, val, index);
+	if (err < 0)
+		goto abort;
+
+	/* Commit routing settings */
+	private->mux[index] = val;
+	err = scarlett2_usb_set_mux(mixer);
+	if (err < 0) {
+		private->mux[index] = oval;
+		goto abort;
+	}
+
+	/* The whole routing change goes as one write set */
+	err = scarlett2_sw_cfg_txn_commit(mixer);
+	if (err == 0)
+		err = 1;
+	goto unlock;
+
+abort:
+	scarlett2_sw_cfg_txn_abort(mixer);
+
+unlock:
+	scarlett2_data_unlock(private);
+	return err;
+}
+
+static const struct snd_kcontrol_new scarlett2_mux_src_enum_ctl = {
+	.iface = SNDRV_CTL_ELEM_IFACE_MIXER,
+	.name = "",
+	.info = scarlett2_mux_src_enum_ctl_info,
+	.get  = scarlett2_mux_src_enum_ctl_get,
+	.put  = scarlett2_mux_src_enum_ctl_put,
+};
+
+static int scarlett2_parse_sw_mux(struct usb_mixer_interface *mixer)
+{
+	struct scarlett2_mixer_data *private = mixer->private_data;
+	const struct scarlett2_device_info *info = private->info;
+	struct scarlett2_sw_cfg *sw_cfg = private->sw_cfg;
+	char src[SNDRV_CTL_ELEM_ID_NAME_MAXLEN], dst[SNDRV_CTL_ELEM_ID_NAME_MAXLEN];
+
+	int port_type, port_count, num_mix_in;
+	int dst_port, src_port, mix_bit;
+	int sw_idx, sp_idx;
+	u32 st_map, mix_map;
+	int i, j;
+
+	static const int sw_list[] = {
+		SCARLETT2_PORT_TYPE_ANALOGUE,
+		SCARLETT2_PORT_TYPE_SPDIF,
+		SCARLETT2_PORT_TYPE_ADAT,
+		SCARLETT2_PORT_TYPE_PCM
+	};
+
+	/* If we have software configuration and port mapping - apply them */
+	if ((sw_cfg == NULL) || (info->sw_port_mapping == NULL))
+		return 0;
+
+	/* Apply physical output routing */
+	st_map = le32_to_cpu(sw_cfg->stereo_sw);
+	mix_map = le32_to_cpu(sw_cfg->mixer_bind);
+
+	for (i=0; i < sizeof(sw_list)/sizeof(int); ++i) {
+		port_type = sw_list[i];
+		port_count = info->ports[port_type].num[SCARLETT2_PORT_OUT];
+
+		for (j=0; j<port_count; ++j) {
+			sw_idx = scarlett2_get_sw_port_num(info->sw_port_mapping, SCARLETT2_PORT_OUT, port_type, j);
+			if (sw_idx < 0) /* Skip port if it is not mapped in software configuration */
+				continue;
+
+			/* Check that destination port is valid */
+			dst_port = scarlett2_get_port_num(info->ports, SCARLETT2_PORT_OUT, port_type, j);
+			if ((dst_port < 0) || (dst_port >= SCARLETT2_MUX_MAX))
+				continue;
+
+			/* Check whether output is in stereo or mono mode and fetch the source port number */
+			sp_idx = sw_idx & (~1); /* Index of byte for the corresponding stereo (even) channel */
+
+			if (st_map & ((1 << sw_idx) | (1 << sp_idx))) {
+				src_port = (sw_idx & 1) ? sw_cfg->out_mux[sp_idx]+1 : sw_cfg->out_mux[sp_idx];
+				mix_bit  = 1 << sp_idx;
+			}
+			else {
+				src_port = sw_cfg->out_mux[sw_idx];
+				mix_bit  = 1 << sw_idx;
+			}
+
+			/* Check that channel is routed to mixer */
+			if (mix_map & mix_bit) /* Bit is set - not routed to mixer, it is a physical port number */
+				src_port = scarlett2_sw2drv_port_num(info->ports, info->sw_port_mapping, SCARLETT2_PORT_IN, src_port);
+			else if (src_port > 0) /* Bit not set and source number is greater than zero - routed via mixer */
+				src_port = scarlett2_get_port_num(info->ports, SCARLETT2_PORT_IN, SCARLETT2_PORT_TYPE_MIX, src_port - 1);
+
+			/* Write the actual mux configuration */
+			private->mux[dst_port] = src_port;
+		}
+	}
+
+	/* Apply mixer routing */
+	num_mix_in = (info->has_mixer) ? info->ports[SCARLETT2_PORT_TYPE_MIX].num[SCARLETT2_PORT_OUT] : 0;
+	for (i=0; i < num_mix_in; ++i) {
+		sw_idx = i;
+		src_port = sw_cfg->mixer_in_mux[sw_idx];
+
+		/* Decode the routing port */
+		src_port = scarlett2_sw2drv_port_num(info->ports, info->sw_port_mapping, SCARLETT2_PORT_IN, src_port);
+
+		/* Check that destination port is valid */
+		dst_port = scarlett2_get_port_num(info->ports, SCARLETT2_PORT_OUT, SCARLETT2_PORT_TYPE_MIX, sw_idx);
+		if ((dst_port < 0) || (dst_port >= SCARLETT2_MUX_MAX))
+			continue;
+
+		/* DEBUG: output routing information */
+		scarlett2_fmt_port_name(src, SNDRV_CTL_ELEM_ID_NAME_MAXLEN, "%s", info, SCARLETT2_PORT_IN, src_port);
+		scarlett2_fmt_port_name(dst, SNDRV_CTL_ELEM_ID_NAME_MAXLEN, "%s", info, SCARLETT2_PORT_OUT, dst_port);
+
+		/* Write the actual mux configuration */
+		private->mux[dst_port] = src_port;
+	}
+
+	return 0;
+}
+
+static int scarlett2_init_mux(struct usb_mixer_interface *mixer)
+{
+	struct scarlett2_mixer_data *private = mixer->private_data;
+	const struct scarlett2_device_info *info = private->info;
+
+	int port, err;
+	char name[SNDRV_CTL_ELEM_ID_NAME_MAXLEN];
+
+	/* Check that device has MUX */
+	if (!info->has_mux)
+		return 0;
+
+	/* Read MUX settings */
+	err = scarlett2_usb_get_mux(mixer);
+	if (err < 0)
+		return err;
+
+	/* Parse software MUX configuration if present */
+	err = scarlett2_parse_sw_mux(mixer);
+	if (err < 0)
+		return err;
+
+	/* Apply MUX settings */
+	err = scarlett2_usb_set_mux(mixer);
+	if (err < 0)
+		return err;
+
+	/* Create mux control ports based on output port list */
+	for (port = 0; port < private->num_outputs; ++port) {
+		/* Create port descriptor */
+		scarlett2_fmt_port_name(name, SNDRV_CTL_ELEM_ID_NAME_MAXLEN, "%s Source", info, SCARLETT2_PORT_OUT, port);
+		err = scarlett2_add_new_ctl(mixer,
+					    &scarlett2_mux_src_enum_ctl,
+					    port, 1, name, &private->mux_ctls[port]);
+		if (err < 0)
+			return err;
+	}
+
+	return err;
+}
+
+/*** Meter Controls ***/
+
+static int scarlett2_meter_ctl_info(struct snd_kcontrol *kctl,
+				    struct snd_ctl_elem_info *uinfo)
+{
+	struct usb_mixer_elem_info *elem = kctl->private_data;
+
+	uinfo->type = SNDRV_CTL_ELEM_TYPE_INTEGER;
+	uinfo->count = elem->channels;
+	uinfo->value.integer.min = 0;
+	uinfo->value.integer.max = 4095;
+	uinfo->value.integer.step = 1;
+	return 0;
+}
+
+static int scarlett2_meter_ctl_get(struct snd_kcontrol *kctl,
+				   struct snd_ctl_elem_value *ucontrol)
+{
+	struct usb_mixer_elem_info *elem = kctl->private_data;
+	u16 meter_levels[SCARLETT2_NUM_METERS];
+	int i, err;
+
+	err = scarlett2_usb_get_meter_levels(elem->head.mixer, meter_levels);
+	if (err < 0)
+		return err;
+
+	for (i = 0; i < elem->channels; i++)
+		ucontrol->value.integer.value[i] = meter_levels[i];
+
+	return 0;
+}
+
+static const struct snd_kcontrol_new scarlett2_meter_ctl = {
+	.iface = SNDRV_CTL_ELEM_IFACE_PCM,
+	.access = SNDRV_CTL_ELEM_ACCESS_READ | SNDRV_CTL_ELEM_ACCESS_VOLATILE,
+	.name = "",
+	.info = scarlett2_meter_ctl_info,
+	.get  = scarlett2_meter_ctl_get
+};
+
+static int scarlett2_add_meter_ctl(struct usb_mixer_interface *mixer)
+{
+	struct scarlett2_mixer_data *private = mixer->private_data;
+
+	/** Ensure the device has level meters */
+	if (!private->info->has_meters)
+		return 0;
+
+	return scarlett2_add_new_ctl(mixer, &scarlett2_meter_ctl,
+				     0, SCARLETT2_NUM_METERS,
+				     "Level Meter", NULL);
+}
+
+/*** MSD Controls ***/
+
+static int scarlett2_msd_ctl_get(struct snd_kcontrol *kctl,
+				 struct snd_ctl_elem_value *ucontrol)
+{
+	struct usb_mixer_elem_info *elem = kctl->private_data;
+	struct scarlett2_mixer_data *private = elem->head.mixer->private_data;
+
+	ucontrol->value.enumerated.item[0] = private->msd_switch;
+	return 0;
+}
+
+static int scarlett2_msd_ctl_put(struct snd_kcontrol *kctl,
+				 struct snd_ctl_elem_value *ucontrol)
+{
+	struct usb_mixer_elem_info *elem = kctl->private_data;
+	struct usb_mixer_interface *mixer = elem->head.mixer;
+	struct scarlett2_mixer_data *private = mixer->private_data;
+
+	int oval, val, err = 0;
+
+	scarlett2_data_lock(private);
+
+	oval = private->msd_switch;
+	val = !!ucontrol->value.integer.value[0];
+	if (oval == val)
+		goto unlock;
+
+	private->msd_switch = val;
+
+	/* Send switch change to the device */
+	err = scarlett2_usb_set_config(mixer, SCARLETT2_CONFIG_MSD_SWITCH,
+				       0, val);
+
+unlock:
+	scarlett2_data_unlock(private);
+	return err;
+}
+
+static const struct snd_kcontrol_new scarlett2_msd_ctl = {
+	.iface = SNDRV_CTL_ELEM_IFACE_MIXER,
+	.name = "",
+	.info = scarlett2_bool_enum_ctl_info,
+	.get  = scarlett2_msd_ctl_get,
+	.put  = scarlett2_msd_ctl_put,
+};
+
+static int scarlett2_add_msd_ctl(struct usb_mixer_interface *mixer)
+{
+	struct scarlett2_mixer_data *private = mixer->private_data;
+	const struct scarlett2_device_info *info = private->info;
+
+	/* Check that device has MSD mode */
+	if (!info->has_msd_mode)
+		return 0;
+
+	/* If MSD mode is off, hide the switch by default */
+	if (!private->msd_switch && !(mixer->chip->setup & SCARLETT2_MSD_ENABLE))
+		return 0;
+
+	/* Add MSD control */
+	return scarlett2_add_new_ctl(mixer, &scarlett2_msd_ctl,
+				     0, 1, "MSD Mode", NULL);
+}
+
+/*** Speaker Switching Control ***/
+static int scarlett2_update_speaker_switch_enum_ctl(struct usb_mixer_interface *mixer)
+{
+	struct scarlett2_mixer_data *private = mixer->private_data;
+	const struct scarlett2_device_info *info = private->info;
+	u8 speaker_switching, speaker_switch, direct_monitor;
+	struct scarlett2_config_req reqs[3];
+	int num = 0, err = 0;
+
+	/* Check for re-entrance */
+	if (!private->speaker_updated)
+		return 0;
+
+	/* Fetch speaker switching state, speaker & talkback configuration
+	 * and direct monitor flag at once
+	 */
+	if (info->has_speaker_switching) {
+		reqs[num++] = (struct scarlett2_config_req) {
+			SCARLETT2_CONFIG_SPEAKER_SWITCHING_SWITCH, 1, &speaker_switching
+		};
+		reqs[num++] = (struct scarlett2_config_req) {
+			SCARLETT2_CONFIG_MAIN_ALT_SPEAKER_SWITCH, 1, &speaker_switch
+		};
+	}
+	if (info->has_direct_monitor)
+		reqs[num++] = (struct scarlett2_config_req) {
+			SCARLETT2_CONFIG_DIRECT_MONITOR_SWITCH, 1, &direct_monitor
+		};
+
+	err = scarlett2_usb_get_config_multi(mixer, reqs, num);
+	if (err < 0)
+		return err;
+
+	if (info->has_speaker_switching) {
+		/* decode speaker & talkback values */
+		private->speaker_switch  = (speaker_switching) ? (speaker_switch & 1) + 1 : 0;
+		if (info->has_talkback)
+			private->talkback_switch = !!(speaker_switch & 2);
+	}
+
+	if (info->has_direct_monitor) {
+		/* update direct monitor state */
+		if (info->has_direct_monitor > 1)
+			private->direct_monitor_switch = (direct_monitor < 3) ? direct_monitor : 0;
+		else
+			private->direct_monitor_switch = !! direct_monitor;
+	}
+
+	/* Reset the flag AFTER values have been retrieved */
+	private->speaker_updated = 0;
+
+	return 0;
+}
+
+static int scarlett2_speaker_switch_enum_ctl_info(
+	struct snd_kcontrol *kctl, struct snd_ctl_elem_info *uinfo)
+{
+	static const char *const values[3] = {
+		"Off", "Main", "Alt"
+	};
+
+	return snd_ctl_enum_info(uinfo, 1, 3, values);
+}
+
+static int scarlett2_direct_monitor_switch_enum_ctl_info(
+	struct snd_kcontrol *kctl, struct snd_ctl_elem_info *uinfo)
+{
+	struct usb_mixer_elem_info *elem = kctl->private_data;
+	struct usb_mixer_interface *mixer = elem->head.mixer;
+	struct scarlett2_mixer_data *private = mixer->private_data;
+	const struct scarlett2_device_info *info = private->info;
+
+	static const char *const mono_values[2] = {
+		"Off", "On"
+	};
+	static const char *const stereo_values[3] = {
+		"Off", "Mono", "Stereo"
+	};
+
+	return (info->has_direct_monitor > 1) ?
+		snd_ctl_enum_info(uinfo, 1, 3, stereo_values) :
+		snd_ctl_enum_info(uinfo, 1, 2, mono_values);
+}
+
+static int scarlett2_speaker_switch_enum_ctl_get(
+	struct snd_kcontrol *kctl, struct snd_ctl_elem_value *ucontrol)
+{
+	struct usb_mixer_elem_info *elem = kctl->private_data;
+	struct usb_mixer_interface *mixer = elem->head.mixer;
+	struct scarlett2_mixer_data *private = mixer->private_data;
+
+	if (private->speaker_updated) {
+		scarlett2_data_lock(private);
+		scarlett2_update_speaker_switch_enum_ctl(mixer);
+		scarlett2_data_unlock(private);
+	}
+
+	ucontrol->value.enumerated.item[0] = private->speaker_switch;
+	return 0;
+}
+
+static int scarlett2_direct_monitor_switch_enum_ctl_get(
+	struct snd_kcontrol *kctl, struct snd_ctl_elem_value *ucontrol)
+{
+	struct usb_mixer_elem_info *elem = kctl->private_data;
+	struct usb_mixer_interface *mixer = elem->head.mixer;
+	struct scarlett2_mixer_data *private = mixer->private_data;
+
+	if (private->speaker_updated) {
+		scarlett2_data_lock(private);
+		scarlett2_update_speaker_switch_enum_ctl(mixer);
+		scarlett2_data_unlock(private);
+	}
+
+	ucontrol->value.enumerated.item[0] = private->direct_monitor_switch;
+	return 0;
+}
+
+static int scarlett2_talkback_switch_ctl_get(
+	struct snd_kcontrol *kctl, struct snd_ctl_elem_value *ucontrol)
+{
+	struct usb_mixer_elem_info *elem = kctl->private_data;
+	struct usb_mixer_interface *mixer = elem->head.mixer;
+	struct scarlett2_mixer_data *private = mixer->private_data;
+
+	if (private->speaker_updated) {
+		scarlett2_data_lock(private);
+		scarlett2_update_speaker_switch_enum_ctl(mixer);
+		scarlett2_data_unlock(private);
+	}
+
+	ucontrol->value.enumerated.item[0] = private->talkback_switch;
+	return 0;
+}
+
+static int scarlett2_mix_talkback_switch_ctl_get(
+	struct snd_kcontrol *kctl, struct snd_ctl_elem_value *ucontrol)
+{
+	struct usb_mixer_elem_info *elem = kctl->private_data;
+	struct usb_mixer_interface *mixer = elem->head.mixer;
+	struct scarlett2_mixer_data *private = mixer->private_data;
+
+	ucontrol->value.enumerated.item[0] = private->mix_talkback[elem->control];
+	return 0;
+}
+
+static int scarlett2_speaker_switch_update_state(struct usb_mixer_interface *mixer, int alt, int talkback) {
+	struct scarlett2_mixer_data *private = mixer->private_data;
+	const struct scarlett2_device_info *info = private->info;
+	struct scarlett2_config_write writes[2];
+	int old_alt, old_talk, num = 0, err = 0;
+
+	scarlett2_data_lock(private);
+	scarlett2_update_speaker_switch_enum_ctl(mixer);
+
+	old_alt = private->speaker_switch;
+	old_talk = private->talkback_switch;
+
+	if ((old_alt == alt) && (old_talk == talkback))
+		goto unlock;
+	private->speaker_switch = alt;
+	private->talkback_switch = talkback;
+
+	/* enable/disable speaker switching */
+	if (old_alt == 0 || alt == 0)
+		writes[num++] = (struct scarlett2_config_write) {
+			SCARLETT2_CONFIG_SPEAKER_SWITCHING_SWITCH, 0, !!alt
+		};
+
+	/* update talkback speaker and talkback */
+	writes[num] = (struct scarlett2_config_write) {
+		SCARLETT2_CONFIG_MAIN_ALT_SPEAKER_SWITCH, 0, (alt == 2)
+	};
+	if (info->has_talkback)
+		writes[num].value |= talkback << 1;
+	++num;
+
+	/* Both items are neighbours and go with one request */
+	err = scarlett2_usb_set_config_multi(mixer, writes, num);
+
+unlock:
+	scarlett2_data_unlock(private);
+	return err;
+}
+
+static int scarlett2_direct_monitor_switch_enum_ctl_put(
+	struct snd_kcontrol *kctl, struct snd_ctl_elem_value *ucontrol)
+{
+	struct usb_mixer_elem_info *elem = kctl->private_data;
+	struct usb_mixer_interface *mixer = elem->head.mixer;
+	struct scarlett2_mixer_data *private = mixer->private_data;
+	const struct scarlett2_device_info *info = private->info;
+	int old_val, val, err = 0;
+
+	scarlett2_data_lock(private);
+	scarlett2_update_speaker_switch_enum_ctl(mixer);
+
+	old_val = private->direct_monitor_switch;
+	val = ucontrol->value.integer.value[0];
+	val = (info->has_direct_monitor > 1) ? clamp(val, 0, 2) : !! val;
+	if (old_val == val)
+		goto unlock;
+
+	private->direct_monitor_switch = val;
+
+	/* Update direct monitor settings */
+	err = scarlett2_usb_set_config(mixer, SCARLETT2_CONFIG_DIRECT_MONITOR_SWITCH, 0, val);
+
+unlock:
+	scarlett2_data_unlock(private);
+	return err;
+}
+
+static int scarlett2_speaker_switch_enum_ctl_put(
+	struct snd_kcontrol *kctl, struct snd_ctl_elem_value *ucontrol)
+{
+	struct usb_mixer_elem_info *elem = kctl->private_data;
+	struct usb_mixer_interface *mixer = elem->head.mixer;
+	struct scarlett2_mixer_data *private = mixer->private_data;
+
+	return scarlett2_speaker_switch_update_state(mixer,
+						     ucontrol->value.integer.value[0],
+						     private->talkback_switch);
+}
+
+static int scarlett2_talkback_switch_ctl_put(
+	struct snd_kcontrol *kctl, struct snd_ctl_elem_value *ucontrol)
+{
+	struct usb_mixer_elem_info *elem = kctl->private_data;
+	struct usb_mixer_interface *mixer = elem->head.mixer;
+	struct scarlett2_mixer_data *private = mixer->private_data;
+
+	return scarlett2_speaker_switch_update_state(mixer,
+						     private->speaker_switch,
+						     ucontrol->value.integer.value[0]);
+}
+
+static int scarlett2_mix_talkback_switch_ctl_put(
+	struct snd_kcontrol *kctl, struct snd_ctl_elem_value *ucontrol)
+{
+	struct usb_mixer_elem_info *elem = kctl->private_data;
+	struct usb_mixer_interface *mixer = elem->head.mixer;
+	struct scarlett2_mixer_data *private = mixer->private_data;
+	const struct scarlett2_ports *ports = private->info->ports;
+	int i, val, old_val, num_mixes, err = 0;
+
+	scarlett2_data_lock(private);
 
-		/* Decode the routing port */
-		src_port = scarlett2_sw2drv_port_num(info->ports, info->sw_port_mapping, SCARLETT2_PORT_IN, src_port);
+	old_val  = private->mix_talkback[elem->control];
+	val      = !! ucontrol->value.integer.value[0];
+	if (old_val == val)
+		goto unlock;
 
-		/* Check that destination port is valid */
-		dst_port = scarlett2_get_port_num(info->ports, SCARLETT2_PORT_OUT, SCARLETT2_PORT_TYPE_MIX, sw_idx);
-		if ((dst_port < 0) || (dst_port >= SCARLETT2_MUX_MAX))
-			continue;
+	private->mix_talkback[elem->control] = val;
 
-		/* DEBUG: output routing information */
-		scarlett2_fmt_port_name(src, SNDRV_CTL_ELEM_ID_NAME_MAXLEN, "%s", info, SCARLETT2_PORT_IN, src_port);
-		scarlett2_fmt_port_name(dst, SNDRV_CTL_ELEM_ID_NAME_MAXLEN, "%s", info, SCARLETT2_PORT_OUT, dst_port);
+	/* Build bit mask for each mixer channel and commit to device */
+	val      = 0;
+	num_mixes = ports[SCARLETT2_PORT_TYPE_MIX].num[SCARLETT2_PORT_IN];
+	for (i=0; i<num_mixes; ++i)
+		val |= (private->mix_talkback[i]) << i;
 
-		/* Write the actual mux configuration */
-		private->mux[dst_port] = src_port;
-	}
+	err = scarlett2_usb_set_config(
+		mixer, SCARLETT2_CONFIG_MIX_TALKBACK,
+		0, val);
 
-	return 0;
+unlock:
+	scarlett2_data_unlock(private);
+	return err;
 }
 
-static int scarlett2_init_mux(struct usb_mixer_interface *mixer)
+static const struct snd_kcontrol_new scarlett2_speaker_switch_enum_ctl = {
+	.iface = SNDRV_CTL_ELEM_IFACE_MIXER,
+	.name = "",
+	.info = scarlett2_speaker_switch_enum_ctl_info,
+	.get  = scarlett2_speaker_switch_enum_ctl_get,
+	.put  = scarlett2_speaker_switch_enum_ctl_put,
+};
+
+static const struct snd_kcontrol_new scarlett2_direct_monitor_switch_enum_ctl = {
+	.iface = SNDRV_CTL_ELEM_IFACE_MIXER,
+	.name = "",
+	.info = scarlett2_direct_monitor_switch_enum_ctl_info,
+	.get  = scarlett2_direct_monitor_switch_enum_ctl_get,
+	.put  = scarlett2_direct_monitor_switch_enum_ctl_put,
+};
+
+static const struct snd_kcontrol_new scarlett2_talkback_switch_ctl = {
+	.iface = SNDRV_CTL_ELEM_IFACE_MIXER,
+	.name = "",
+	.info = snd_ctl_boolean_mono_info,
+	.get  = scarlett2_talkback_switch_ctl_get,
+	.put  = scarlett2_talkback_switch_ctl_put,
+};
+
+static const struct snd_kcontrol_new scarlett2_mix_talkback_switch_ctl = {
+	.iface = SNDRV_CTL_ELEM_IFACE_MIXER,
+	.name = "",
+	.info = snd_ctl_boolean_mono_info,
+	.get  = scarlett2_mix_talkback_switch_ctl_get,
+	.put  = scarlett2_mix_talkback_switch_ctl_put,
+};
+
+static int scarlett2_add_speaker_switch_ctl(
+	struct usb_mixer_interface *mixer)
 {
 	struct scarlett2_mixer_data *private = mixer->private_data;
 	const struct scarlett2_device_info *info = private->info;
+	const struct scarlett2_ports *ports = private->info->ports;
+	char s[SNDRV_CTL_ELEM_ID_NAME_MAXLEN];
+	int err = 0, num_mixes, i;
 
-	int port, err;
-	char name[SNDRV_CTL_ELEM_ID_NAME_MAXLEN];
-
-	/* Check that device has MUX */
-	if (!info->has_mux)
-		return 0;
-
-	/* Read MUX settings */
-	err = scarlett2_usb_get_mux(mixer);
-	if (err < 0)
-		return err;
+	if (info->has_speaker_switching) {
+		/* Add speaker switching control */
+		err = scarlett2_add_new_ctl(
+			mixer, &scarlett2_speaker_switch_enum_ctl,
+			0, 1, "Speaker Switching", &private->speaker_ctl);
+		
+		if (err < 0)
+			return err;
+	}
 
-	/* Parse software MUX configuration if present */
-	err = scarlett2_parse_sw_mux(mixer);
-	if (err < 0)
-		return err;
+	if (info->has_direct_monitor) {
+		/* Add direct monitor control */
+		err = scarlett2_add_new_ctl(
+			mixer, &scarlett2_direct_monitor_switch_enum_ctl,
+			0, 1, "Direct Monitor", &private->direct_monitor_ctl);
 
-	/* Apply MUX settings */
-	err = scarlett2_usb_set_mux(mixer);
-	if (err < 0)
-		return err;
+		if (err < 0)
+			return err;
+	}
 
-	/* Create mux control ports based on output port list */
-	for (port = 0; port < private->num_outputs; ++port) {
-		/* Create port descriptor */
-		scarlett2_fmt_port_name(name, SNDRV_CTL_ELEM_ID_NAME_MAXLEN, "%s Source", info, SCARLETT2_PORT_OUT, port);
-		err = scarlett2_add_new_ctl(mixer,
-					    &scarlett2_mux_src_enum_ctl,
-					    port, 1, name, NULL);
+	if (info->has_talkback) {
+		/* Add talkback switching control */
+		err = scarlett2_add_new_ctl(
+			mixer, &scarlett2_talkback_switch_ctl,
+			0, 1, "Talkback Switching", &private->talkback_ctl);
+		
 		if (err < 0)
 			return err;
+		
+		/* Add 'talkback enable' for mix */
+		num_mixes = ports[SCARLETT2_PORT_TYPE_MIX].num[SCARLETT2_PORT_IN];
+		for (i=0; i<num_mixes; ++i) {
+			snprintf(s, sizeof(s), "Mix %c Talkback", 'A' + i);
+			
+			err = scarlett2_add_new_ctl(
+				mixer, &scarlett2_mix_talkback_switch_ctl,
+				i, 1, s, &private->mix_talkback_ctls[i]);
+
+			if (err < 0)
+				return err;
+		}
 	}
 
-	return err;
+	return 0;
 }
 
-/*** Meter Controls ***/
+/*** Command Status Control ***/
 
-static int scarlett2_meter_ctl_info(struct snd_kcontrol *kctl,
-				    struct snd_ctl_elem_info *uinfo)
+/* The control reports the number of failed asynchronous commands and
+ * the error code of the last failure; it is notified on each failure
+ */
+static int scarlett2_cmd_status_ctl_info(struct snd_kcontrol *kctl,
+					 struct snd_ctl_elem_info *uinfo)
 {
-	struct usb_mixer_elem_info *elem = kctl->private_data;
-
 	uinfo->type = SNDRV_CTL_ELEM_TYPE_INTEGER;
-	uinfo->count = elem->channels;
-	uinfo->value.integer.min = 0;
-	uinfo->value.integer.max = 4095;
+	uinfo->count = 2;
+	uinfo->value.integer.min = -4095;
+	uinfo->value.integer.max = INT_MAX;
 	uinfo->value.integer.step = 1;
 	return 0;
 }
 
-static int scarlett2_meter_ctl_get(struct snd_kcontrol *kctl,
-				   struct snd_ctl_elem_value *ucontrol)
+static int scarlett2_cmd_status_ctl_get(struct snd_kcontrol *kctl,
+					struct snd_ctl_elem_value *ucontrol)
 {
 	struct usb_mixer_elem_info *elem = kctl->private_data;
-	u16 meter_levels[SCARLETT2_NUM_METERS];
-	int i, err;
-
-	err = scarlett2_usb_get_meter_levels(elem->head.mixer, meter_levels);
-	if (err < 0)
-		return err;
+	struct scarlett2_mixer_data *private = elem->head.mixer->private_data;
+	unsigned long flags;
 
-	for (i = 0; i < elem->channels; i++)
-		ucontrol->value.integer.value[i] = meter_levels[i];
+	spin_lock_irqsave(&private->cmd_lock, flags);
+	ucontrol->value.integer.value[0] = min_t(unsigned int, private->cmd_errors, INT_MAX);
+	ucontrol->value.integer.value[1] = private->cmd_last_error;
+	spin_unlock_irqrestore(&private->cmd_lock, flags);
 
 	return 0;
 }
 
-static const struct snd_kcontrol_new scarlett2_meter_ctl = {
-	.iface = SNDRV_CTL_ELEM_IFACE_PCM,
+static const struct snd_kcontrol_new scarlett2_cmd_status_ctl = {
+	.iface = SNDRV_CTL_ELEM_IFACE_MIXER,
 	.access = SNDRV_CTL_ELEM_ACCESS_READ | SNDRV_CTL_ELEM_ACCESS_VOLATILE,
 	.name = "",
-	.info = scarlett2_meter_ctl_info,
-	.get  = scarlett2_meter_ctl_get
+	.info = scarlett2_cmd_status_ctl_info,
+	.get  = scarlett2_cmd_status_ctl_get
 };
 
-static int scarlett2_add_meter_ctl(struct usb_mixer_interface *mixer)
+static int scarlett2_add_cmd_status_ctl(struct usb_mixer_interface *mixer)
 {
 	struct scarlett2_mixer_data *private = mixer->private_data;
 
-	/** Ensure the device has level meters */
-	if (!private->info->has_meters)
-		return 0;
-
-	return scarlett2_add_new_ctl(mixer, &scarlett2_meter_ctl,
-				     0, SCARLETT2_NUM_METERS,
-				     "Level Meter", NULL);
+	return scarlett2_add_new_ctl(mixer, &scarlett2_cmd_status_ctl,
+				     0, 2, "USB Command Status",
+				     &private->cmd_status_ctl);
 }
 
-/*** MSD Controls ***/
+/*** Deferred Commit Control ***/
 
-static int scarlett2_msd_ctl_get(struct snd_kcontrol *kctl,
-				 struct snd_ctl_elem_value *ucontrol)
+/* Send everything held back by the deferred commit mode: one SET_MIX
+ * per changed mix, one SET_MUX, the changed ranges of the hardware
+ * configuration followed by each activation once, and the software
+ * configuration flush. Each change is forgotten only once it has been
+ * sent, so on failure the mode is left on with the rest held back and
+ * the commit can be retried. Called with data_mutex held.
+ */
+static int scarlett2_deferred_commit(struct usb_mixer_interface *mixer)
+{
+	struct scarlett2_mixer_data *private = mixer->private_data;
+	const struct scarlett2_ports *ports = private->info->ports;
+	int num_mixes = ports[SCARLETT2_PORT_TYPE_MIX].num[SCARLETT2_PORT_IN];
+	DECLARE_BITMAP(dirty, SCARLETT2_CONFIG_MIRROR_MAX);
+	u8 buf[SCARLETT2_CONFIG_MIRROR_MAX];
+	unsigned long flags;
+	int i, offset, end, err = 0;
+	u32 activate;
+
+	private->deferred = 0;
+
+	/* Matrix mixer */
+	for (i = 0; i < num_mixes; ++i) {
+		if (!(private->deferred_mix & BIT(i)))
+			continue;
+		err = scarlett2_usb_set_mix(mixer, i);
+		if (err < 0)
+			goto fail;
+		private->deferred_mix &= ~BIT(i);
+	}
+
+	/* Routing */
+	if (private->deferred_mux) {
+		err = scarlett2_usb_set_mux(mixer);
+		if (err < 0)
+			goto fail;
+		private->deferred_mux = 0;
+	}
+
+	/* Hardware configuration */
+	spin_lock_irqsave(&private->cfg_lock, flags);
+	bitmap_copy(dirty, private->cfg_deferred, SCARLETT2_CONFIG_MIRROR_MAX);
+	memcpy(buf, private->cfg_mirror, private->cfg_mirror_size);
+	spin_unlock_irqrestore(&private->cfg_lock, flags);
+
+	for (offset = find_first_bit(dirty, SCARLETT2_CONFIG_MIRROR_MAX);
+	     offset < SCARLETT2_CONFIG_MIRROR_MAX;
+	     offset = find_next_bit(dirty, SCARLETT2_CONFIG_MIRROR_MAX, end)) {
+		end = find_next_zero_bit(dirty, SCARLETT2_CONFIG_MIRROR_MAX, offset);
+		err = scarlett2_usb_set(mixer, offset, &buf[offset], end - offset);
+		if (err < 0)
+			goto fail;
+
+		spin_lock_irqsave(&private->cfg_lock, flags);
+		bitmap_clear(private->cfg_deferred, offset, end - offset);
+		spin_unlock_irqrestore(&private->cfg_lock, flags);
+	}
+
+	spin_lock_irqsave(&private->cfg_lock, flags);
+	activate = private->cfg_deferred_activate;
+	private->cfg_deferred_activate = 0;
+	spin_unlock_irqrestore(&private->cfg_lock, flags);
+
+	for (i = 0; activate; ++i, activate >>= 1)
+		if (activate & 1)
+			scarlett2_activate(mixer, i);
+
+	/* Software configuration and the NVRAM save */
+	mod_delayed_work(private->wq, &private->sw_flush_work, 0);
+	spin_lock_irqsave(&private->cmd_lock, flags);
+	i = private->save_pending;
+	spin_unlock_irqrestore(&private->cmd_lock, flags);
+	if (i)
+		scarlett2_config_save_schedule(mixer);
+
+	return 0;
+
+fail:
+	usb_audio_warn(mixer->chip, "failed to send the deferred changes: %d", err);
+	private->deferred = 1;
+	return err;
+}
+
+static int scarlett2_deferred_ctl_get(struct snd_kcontrol *kctl,
+				      struct snd_ctl_elem_value *ucontrol)
 {
 	struct usb_mixer_elem_info *elem = kctl->private_data;
 	struct scarlett2_mixer_data *private = elem->head.mixer->private_data;
 
-	ucontrol->value.enumerated.item[0] = private->msd_switch;
+	ucontrol->value.integer.value[0] = private->deferred;
 	return 0;
 }
 
-static int scarlett2_msd_ctl_put(struct snd_kcontrol *kctl,
-				 struct snd_ctl_elem_value *ucontrol)
+static int scarlett2_deferred_ctl_put(struct snd_kcontrol *kctl,
+				      struct snd_ctl_elem_value *ucontrol)
 {
 	struct usb_mixer_elem_info *elem = kctl->private_data;
 	struct usb_mixer_interface *mixer = elem->head.mixer;
@@ -4149,406 +7264,577 @@ static int scarlett2_msd_ctl_put(struct snd_kcontrol *kctl,
 
 	int oval, val, err = 0;
 
-	mutex_lock(&private->data_mutex);
+	scarlett2_data_lock(private);
 
-	oval = private->msd_switch;
+	oval = private->deferred;
 	val = !!ucontrol->value.integer.value[0];
+
 	if (oval == val)
 		goto unlock;
 
-	private->msd_switch = val;
-
-	/* Send switch change to the device */
-	err = scarlett2_usb_set_config(mixer, SCARLETT2_CONFIG_MSD_SWITCH,
-				       0, val);
+	/* The mode stays on if the held back changes can not be sent */
+	if (val)
+		private->deferred = 1;
+	else
+		err = scarlett2_deferred_commit(mixer);
+	if (err == 0)
+		err = 1;
 
 unlock:
-	mutex_unlock(&private->data_mutex);
+	scarlett2_data_unlock(private);
 	return err;
 }
 
-static const struct snd_kcontrol_new scarlett2_msd_ctl = {
+static const struct snd_kcontrol_new scarlett2_deferred_ctl = {
 	.iface = SNDRV_CTL_ELEM_IFACE_MIXER,
 	.name = "",
-	.info = scarlett2_bool_enum_ctl_info,
-	.get  = scarlett2_msd_ctl_get,
-	.put  = scarlett2_msd_ctl_put,
+	.info = snd_ctl_boolean_mono_info,
+	.get  = scarlett2_deferred_ctl_get,
+	.put  = scarlett2_deferred_ctl_put,
 };
 
-static int scarlett2_add_msd_ctl(struct usb_mixer_interface *mixer)
-{
-	struct scarlett2_mixer_data *private = mixer->private_data;
-	const struct scarlett2_device_info *info = private->info;
-
-	/* Check that device has MSD mode */
-	if (!info->has_msd_mode)
-		return 0;
-
-	/* If MSD mode is off, hide the switch by default */
-	if (!private->msd_switch && !(mixer->chip->setup & SCARLETT2_MSD_ENABLE))
-		return 0;
-
-	/* Add MSD control */
-	return scarlett2_add_new_ctl(mixer, &scarlett2_msd_ctl,
-				     0, 1, "MSD Mode", NULL);
-}
-
-/*** Speaker Switching Control ***/
-static int scarlett2_update_speaker_switch_enum_ctl(struct usb_mixer_interface *mixer)
+/* Send the changes held back by the deferred commit mode; the mode
+ * stays as it is
+ */
+static void scarlett2_deferred_push(struct usb_mixer_interface *mixer)
 {
-	struct scarlett2_mixer_data *private = mixer->private_data;
-	const struct scarlett2_device_info *info = private->info;
-	u8 speaker_switching, speaker_switch;
-	int err = 0;
-
-	/* Check for re-entrance */
-	if (!private->speaker_updated)
-		return 0;
-
-	if (info->has_speaker_switching) {
-		/* check if speaker switching is enabled */
-		err = scarlett2_usb_get_config(
-			mixer,
-			SCARLETT2_CONFIG_SPEAKER_SWITCHING_SWITCH,
-			1, &speaker_switching);
-		if (err < 0)
-			return err;
-
-		/* get actual speaker & talkback configuration */
-		err = scarlett2_usb_get_config(
-			mixer,
-			SCARLETT2_CONFIG_MAIN_ALT_SPEAKER_SWITCH,
-			1, &speaker_switch);
-		if (err < 0)
-			return err;
-
-		/* decode speaker & talkback values */
-		private->speaker_switch  = (speaker_switching) ? (speaker_switch & 1) + 1 : 0;
-		if (info->has_talkback)
-			private->talkback_switch = !!(speaker_switch & 2);
+	struct scarlett2_mixer_data *private = mixer->private_data;
+
+	scarlett2_data_lock(private);
+	if (private->deferred) {
+		scarlett2_deferred_commit(mixer);
+		private->deferred = 1;
 	}
+	scarlett2_data_unlock(private);
+}
 
-	if (info->has_direct_monitor) {
-		/* Fetch direct monitor flag */
-		err = scarlett2_usb_get_config(
-			mixer,
-			SCARLETT2_CONFIG_DIRECT_MONITOR_SWITCH,
-			1, &speaker_switching);
-		if (err < 0)
-			return err;
+/*** Debugfs ***/
 
-		/* update direct monitor state */
-		if (info->has_direct_monitor > 1)
-			private->direct_monitor_switch = (speaker_switching < 3) ? speaker_switching : 0;
-		else
-			private->direct_monitor_switch = !! speaker_switching;
+static int scarlett2_stats_show(struct seq_file *m, void *v)
+{
+	struct scarlett2_mixer_data *private = m->private;
+	unsigned long flags;
+
+	spin_lock_irqsave(&private->cmd_lock, flags);
+	seq_printf(m, "chunk_size: %u\n", private->chunk_size);
+	seq_printf(m, "cmd_sent: %lu\n", private->stat_cmd_sent);
+	seq_printf(m, "cmd_errors: %u\n", private->cmd_errors);
+	seq_printf(m, "cmd_retries: %lu\n", private->stat_cmd_retries);
+	seq_printf(m, "resyncs: %lu\n", private->stat_resyncs);
+	seq_printf(m, "resync_failed: %lu\n", private->stat_resync_failed);
+	seq_printf(m, "set_data: %lu\n", private->stat_set_data);
+	seq_printf(m, "set_data_merged: %lu\n", private->stat_set_data_merged);
+	seq_printf(m, "set_data_merged_bytes: %lu\n", private->stat_set_data_merged_bytes);
+	seq_printf(m, "activate_requested: %lu\n", private->stat_activate_requested);
+	seq_printf(m, "activate_sent: %lu\n", private->stat_activate_sent);
+	seq_printf(m, "save_issued: %lu\n", private->stat_save_issued);
+	seq_printf(m, "save_coalesced: %lu\n", private->stat_save_coalesced);
+	seq_printf(m, "config_mirror_size: %u\n", private->cfg_mirror_size);
+	seq_printf(m, "config_mirror_valid: 0x%x\n", private->cfg_valid);
+	seq_printf(m, "config_hits: %lu\n", private->stat_cfg_hits);
+	seq_printf(m, "config_misses: %lu\n", private->stat_cfg_misses);
+	seq_printf(m, "sw_commits: %lu\n", private->stat_sw_commits);
+	seq_printf(m, "sw_aborts: %lu\n", private->stat_sw_aborts);
+	seq_printf(m, "sw_flushes: %lu\n", private->stat_sw_flushes);
+	seq_printf(m, "sw_ranges: %lu\n", private->stat_sw_ranges);
+	seq_printf(m, "meter_polls: %lu\n", private->stat_meter_polls);
+	seq_printf(m, "meter_merged: %lu\n", private->stat_meter_merged);
+	seq_printf(m, "rate_limit: %u\n", scarlett2_rate_limit);
+	seq_printf(m, "rate_limit_pcm: %u\n", scarlett2_rate_limit_pcm);
+	seq_printf(m, "rate_tokens: %u\n", private->rate_tokens);
+	seq_printf(m, "throttled: %lu\n", private->stat_throttled);
+	seq_printf(m, "throttled_pcm: %lu\n", private->stat_throttled_pcm);
+	seq_printf(m, "throttle_us: %llu\n", div_u64(private->stat_throttle_ns, NSEC_PER_USEC));
+	spin_unlock_irqrestore(&private->cmd_lock, flags);
+
+	return 0;
+}
+DEFINE_SHOW_ATTRIBUTE(scarlett2_stats);
+
+static int scarlett2_transport_show(struct seq_file *m, void *v)
+{
+	struct scarlett2_mixer_data *private = m->private;
+	struct scarlett2_record *rec = private->record;
+	struct scarlett2_record_stats stats[SCARLETT2_CMD_ID_COUNT], total = { 0 };
+	char op[SCARLETT2_RECORD_OP_LEN];
+	unsigned long flags;
+	int i;
+
+	if (!rec) {
+		seq_printf(m, "transport: %s\n", private->transport->name);
+		return 0;
 	}
 
-	/* Reset the flag AFTER values have been retrieved */
-	private->speaker_updated = 0;
+	seq_printf(m, "transport: %s (recording)\n", private->transport_lower->name);
+
+	spin_lock_irqsave(&rec->lock, flags);
+	memcpy(stats, rec->stats, sizeof(stats));
+	memcpy(op, rec->op, sizeof(op));
+	spin_unlock_irqrestore(&rec->lock, flags);
+
+	seq_printf(m, "operation: %s\n", (op[0]) ? op : "-");
+	seq_printf(m, "%-18s %10s %10s %10s %10s\n",
+		   "command", "commands", "transfers", "bytes_out", "bytes_in");
+	for (i = 0; i < SCARLETT2_CMD_ID_COUNT; ++i) {
+		seq_printf(m, "%-18s %10lu %10lu %10lu %10lu\n",
+			   scarlett2_cmd_names[i], stats[i].commands, stats[i].transfers,
+			   stats[i].bytes_out, stats[i].bytes_in);
+		total.commands += stats[i].commands;
+		total.transfers += stats[i].transfers;
+		total.bytes_out += stats[i].bytes_out;
+		total.bytes_in += stats[i].bytes_in;
+	}
+	seq_printf(m, "%-18s %10lu %10lu %10lu %10lu\n", "total",
+		   total.commands, total.transfers, total.bytes_out, total.bytes_in);
 
 	return 0;
 }
 
-static int scarlett2_speaker_switch_enum_ctl_info(
-	struct snd_kcontrol *kctl, struct snd_ctl_elem_info *uinfo)
+static int scarlett2_transport_open(struct inode *inode, struct file *file)
 {
-	static const char *const values[3] = {
-		"Off", "Main", "Alt"
-	};
-
-	return snd_ctl_enum_info(uinfo, 1, 3, values);
+	return single_open(file, scarlett2_transport_show, inode->i_private);
 }
 
-static int scarlett2_direct_monitor_switch_enum_ctl_info(
-	struct snd_kcontrol *kctl, struct snd_ctl_elem_info *uinfo)
+/* Any write resets the recorded statistics, the first line of the
+ * written text names the operation measured from now on
+ */
+static ssize_t scarlett2_transport_write(struct file *file, const char __user *buf,
+					 size_t count, loff_t *ppos)
 {
-	struct usb_mixer_elem_info *elem = kctl->private_data;
-	struct usb_mixer_interface *mixer = elem->head.mixer;
-	struct scarlett2_mixer_data *private = mixer->private_data;
-	const struct scarlett2_device_info *info = private->info;
+	struct scarlett2_mixer_data *private = ((struct seq_file *)file->private_data)->private;
+	struct scarlett2_record *rec = private->record;
+	char op[SCARLETT2_RECORD_OP_LEN];
+	size_t len = min(count, sizeof(op) - 1);
+	unsigned long flags;
 
-	static const char *const mono_values[2] = {
-		"Off", "On"
-	};
-	static const char *const stereo_values[3] = {
-		"Off", "Mono", "Stereo"
-	};
+	if (!rec)
+		return count;
 
-	return (info->has_direct_monitor > 1) ?
-		snd_ctl_enum_info(uinfo, 1, 3, stereo_values) :
-		snd_ctl_enum_info(uinfo, 1, 2, mono_values);
+	if (copy_from_user(op, buf, len))
+		return -EFAULT;
+	op[len] = '\0';
+	op[strcspn(op, "\n")] = '\0';
+
+	spin_lock_irqsave(&rec->lock, flags);
+	memset(rec->stats, 0, sizeof(rec->stats));
+	memcpy(rec->op, op, sizeof(rec->op));
+	spin_unlock_irqrestore(&rec->lock, flags);
+
+	return count;
 }
 
-static int scarlett2_speaker_switch_enum_ctl_get(
-	struct snd_kcontrol *kctl, struct snd_ctl_elem_value *ucontrol)
+static const struct file_operations scarlett2_transport_fops = {
+	.owner   = THIS_MODULE,
+	.open    = scarlett2_transport_open,
+	.read    = seq_read,
+	.write   = scarlett2_transport_write,
+	.llseek  = seq_lseek,
+	.release = single_release,
+};
+
+static int scarlett2_commands_show(struct seq_file *m, void *v)
 {
-	struct usb_mixer_elem_info *elem = kctl->private_data;
-	struct usb_mixer_interface *mixer = elem->head.mixer;
-	struct scarlett2_mixer_data *private = mixer->private_data;
+	struct scarlett2_mixer_data *private = m->private;
+	struct scarlett2_cmd_stats *stats;
+	unsigned long flags;
+	int i, j;
 
-	if (private->speaker_updated) {
-		mutex_lock(&private->data_mutex);
-		scarlett2_update_speaker_switch_enum_ctl(mixer);
-		mutex_unlock(&private->data_mutex);
+	stats = kmalloc_array(SCARLETT2_CMD_ID_COUNT, sizeof(*stats), GFP_KERNEL);
+	if (!stats)
+		return -ENOMEM;
+
+	spin_lock_irqsave(&private->cmd_lock, flags);
+	memcpy(stats, private->cmd_stats, SCARLETT2_CMD_ID_COUNT * sizeof(*stats));
+	spin_unlock_irqrestore(&private->cmd_lock, flags);
+
+	seq_printf(m, "usb_mutex_max_hold_us: %llu\n",
+		   div_u64(READ_ONCE(private->usb_mutex_max_hold), NSEC_PER_USEC));
+	seq_printf(m, "data_mutex_max_hold_us: %llu\n",
+		   div_u64(READ_ONCE(private->data_mutex_max_hold), NSEC_PER_USEC));
+
+	seq_printf(m, "%-18s %10s %10s %10s %8s  %s\n",
+		   "command", "count", "bytes_tx", "bytes_rx", "errors",
+		   "latency_us log2 histogram [<1, <2, <4, ...]");
+	for (i = 0; i < SCARLETT2_CMD_ID_COUNT; ++i) {
+		seq_printf(m, "%-18s %10lu %10lu %10lu %8lu ",
+			   scarlett2_cmd_names[i], stats[i].count, stats[i].bytes_tx,
+			   stats[i].bytes_rx, stats[i].errors);
+		for (j = 0; j < SCARLETT2_LATENCY_BUCKETS; ++j)
+			seq_printf(m, " %lu", stats[i].latency[j]);
+		seq_putc(m, '\n');
 	}
 
-	ucontrol->value.enumerated.item[0] = private->speaker_switch;
+	kfree(stats);
 	return 0;
 }
 
-static int scarlett2_direct_monitor_switch_enum_ctl_get(
-	struct snd_kcontrol *kctl, struct snd_ctl_elem_value *ucontrol)
+static int scarlett2_commands_open(struct inode *inode, struct file *file)
 {
-	struct usb_mixer_elem_info *elem = kctl->private_data;
-	struct usb_mixer_interface *mixer = elem->head.mixer;
-	struct scarlett2_mixer_data *private = mixer->private_data;
+	return single_open(file, scarlett2_commands_show, inode->i_private);
+}
 
-	if (private->speaker_updated) {
-		mutex_lock(&private->data_mutex);
-		scarlett2_update_speaker_switch_enum_ctl(mixer);
-		mutex_unlock(&private->data_mutex);
-	}
+/* Any write resets the command statistics and the lock hold times */
+static ssize_t scarlett2_commands_write(struct file *file, const char __user *buf,
+					size_t count, loff_t *ppos)
+{
+	struct scarlett2_mixer_data *private = ((struct seq_file *)file->private_data)->private;
+	unsigned long flags;
 
-	ucontrol->value.enumerated.item[0] = private->direct_monitor_switch;
-	return 0;
+	spin_lock_irqsave(&private->cmd_lock, flags);
+	memset(private->cmd_stats, 0, SCARLETT2_CMD_ID_COUNT * sizeof(*private->cmd_stats));
+	spin_unlock_irqrestore(&private->cmd_lock, flags);
+
+	WRITE_ONCE(private->usb_mutex_max_hold, 0);
+	WRITE_ONCE(private->data_mutex_max_hold, 0);
+
+	return count;
 }
 
-static int scarlett2_talkback_switch_ctl_get(
-	struct snd_kcontrol *kctl, struct snd_ctl_elem_value *ucontrol)
-{
-	struct usb_mixer_elem_info *elem = kctl->private_data;
-	struct usb_mixer_interface *mixer = elem->head.mixer;
-	struct scarlett2_mixer_data *private = mixer->private_data;
+static const struct file_operations scarlett2_commands_fops = {
+	.owner   = THIS_MODULE,
+	.open    = scarlett2_commands_open,
+	.read    = seq_read,
+	.write   = scarlett2_commands_write,
+	.llseek  = seq_lseek,
+	.release = single_release,
+};
 
-	if (private->speaker_updated) {
-		mutex_lock(&private->data_mutex);
-		scarlett2_update_speaker_switch_enum_ctl(mixer);
-		mutex_unlock(&private->data_mutex);
+/* The pcap image is built on open, so the reader gets a stable snapshot */
+struct scarlett2_pcap_image {
+	size_t size;
+	u8 data[];
+};
+
+static int scarlett2_pcap_open(struct inode *inode, struct file *file)
+{
+	struct scarlett2_mixer_data *private = inode->i_private;
+	struct scarlett2_pcap_entry *tmp;
+	struct scarlett2_pcap_image *img;
+
+	img = vmalloc(sizeof(*img) + sizeof(struct scarlett2_pcap_file_hdr) +
+		      (private->pcap->mask + 1) * SCARLETT2_PCAP_MAX_ENTRY_SIZE);
+	tmp = kmalloc(sizeof(*tmp), GFP_KERNEL);
+	if ((!img) || (!tmp)) {
+		vfree(img);
+		kfree(tmp);
+		return -ENOMEM;
 	}
 
-	ucontrol->value.enumerated.item[0] = private->talkback_switch;
+	img->size = scarlett2_pcap_build(private, img->data, tmp);
+	kfree(tmp);
+	file->private_data = img;
+
 	return 0;
 }
 
-static int scarlett2_mix_talkback_switch_ctl_get(
-	struct snd_kcontrol *kctl, struct snd_ctl_elem_value *ucontrol)
+static ssize_t scarlett2_pcap_read(struct file *file, char __user *buf,
+				   size_t count, loff_t *ppos)
 {
-	struct usb_mixer_elem_info *elem = kctl->private_data;
-	struct usb_mixer_interface *mixer = elem->head.mixer;
-	struct scarlett2_mixer_data *private = mixer->private_data;
+	struct scarlett2_pcap_image *img = file->private_data;
 
-	ucontrol->value.enumerated.item[0] = private->mix_talkback[elem->control];
+	return simple_read_from_buffer(buf, count, ppos, img->data, img->size);
+}
+
+static int scarlett2_pcap_release(struct inode *inode, struct file *file)
+{
+	vfree(file->private_data);
 	return 0;
 }
 
-static int scarlett2_speaker_switch_update_state(struct usb_mixer_interface *mixer, int alt, int talkback) {
+static const struct file_operations scarlett2_pcap_fops = {
+	.owner   = THIS_MODULE,
+	.open    = scarlett2_pcap_open,
+	.read    = scarlett2_pcap_read,
+	.llseek  = default_llseek,
+	.release = scarlett2_pcap_release,
+};
+
+/* Create the debugfs directory of the device, failures are not fatal */
+static void scarlett2_debugfs_init(struct usb_mixer_interface *mixer)
+{
 	struct scarlett2_mixer_data *private = mixer->private_data;
-	const struct scarlett2_device_info *info = private->info;
-	int old_alt, old_talk, err = 0;
+	char name[32];
+
+	snprintf(name, sizeof(name), "scarlett2-%s", dev_name(&mixer->chip->dev->dev));
+	private->debugfs_dir = debugfs_create_dir(name, NULL);
+
+	debugfs_create_file("stats", 0444, private->debugfs_dir, private,
+			    &scarlett2_stats_fops);
+	debugfs_create_file("transport", 0644, private->debugfs_dir, private,
+			    &scarlett2_transport_fops);
+	debugfs_create_file("commands", 0644, private->debugfs_dir, private,
+			    &scarlett2_commands_fops);
+	if (private->pcap)
+		debugfs_create_file("capture.pcap", 0400, private->debugfs_dir, private,
+				    &scarlett2_pcap_fops);
+}
 
-	mutex_lock(&private->data_mutex);
-	scarlett2_update_speaker_switch_enum_ctl(mixer);
+/*** hwdep Device ***/
 
-	old_alt = private->speaker_switch;
-	old_talk = private->talkback_switch;
+/* Check that the range lies in the hardware configuration area or in
+ * the software configuration area
+ */
+static bool scarlett2_hwdep_range_ok(struct scarlett2_mixer_data *private,
+				     u32 offset, u32 size)
+{
+	if ((size == 0) || (size > SCARLETT2_HWDEP_XFER_MAX))
+		return false;
 
-	if ((old_alt == alt) && (old_talk == talkback))
-		goto unlock;
-	private->speaker_switch = alt;
-	private->talkback_switch = talkback;
+	if ((offset < private->cfg_mirror_size) &&
+	    (size <= private->cfg_mirror_size - offset))
+		return true;
 
-	/* enable/disable speaker switching */
-	if (old_alt == 0 || alt == 0) {
-		err = scarlett2_usb_set_config(
-			mixer, SCARLETT2_CONFIG_SPEAKER_SWITCHING_SWITCH,
-			0, !!alt);
-	}
+	return (private->sw_cfg) &&
+		(offset >= SCARLETT2_SW_CONFIG_BASE) &&
+		(offset - SCARLETT2_SW_CONFIG_BASE < sizeof(struct scarlett2_sw_cfg)) &&
+		(size <= sizeof(struct scarlett2_sw_cfg) - (offset - SCARLETT2_SW_CONFIG_BASE));
+}
 
-	/* update talkback speaker and talkback */
-	if (!err) {
-		int val = (alt == 2);
-		if (info->has_talkback)
-			val |= talkback << 1;
+/* Read the range from the device, the copy in the shared memory is
+ * refreshed for the hardware configuration area
+ */
+static int scarlett2_hwdep_read(struct usb_mixer_interface *mixer,
+				const struct scarlett2_hwdep_xfer *xfer, u8 *buf)
+{
+	struct scarlett2_mixer_data *private = mixer->private_data;
+	int err;
 
-		err = scarlett2_usb_set_config(
-			mixer, SCARLETT2_CONFIG_MAIN_ALT_SPEAKER_SWITCH,
-			0, val);
+	if (xfer->offset >= SCARLETT2_SW_CONFIG_BASE) {
+		/* Let the device see the pending changes first */
+		scarlett2_sw_cfg_flush(mixer);
+		return scarlett2_usb_get(mixer, xfer->offset, buf, xfer->size);
 	}
 
-unlock:
-	mutex_unlock(&private->data_mutex);
-	return err;
+	err = scarlett2_config_mirror_read(mixer, xfer->offset, xfer->size, 0, false);
+	if (err < 0)
+		return err;
+
+	return scarlett2_config_mirror_copy(private, xfer->offset, buf, xfer->size);
 }
 
-static int scarlett2_direct_monitor_switch_enum_ctl_put(
-	struct snd_kcontrol *kctl, struct snd_ctl_elem_value *ucontrol)
+/* Decode the driver state kept in the software configuration again
+ * after it has been changed behind the controls (hwdep writes, resume):
+ * the matrix mixer, the routing, the software mutes and the software
+ * controlled line out volumes are sent to the device and the controls
+ * are notified. Called with data_mutex held.
+ */
+static int scarlett2_sw_cfg_decode(struct usb_mixer_interface *mixer)
 {
-	struct usb_mixer_elem_info *elem = kctl->private_data;
-	struct usb_mixer_interface *mixer = elem->head.mixer;
 	struct scarlett2_mixer_data *private = mixer->private_data;
 	const struct scarlett2_device_info *info = private->info;
-	int old_val, val, err = 0;
+	const struct scarlett2_ports *ports = info->ports;
+	struct scarlett2_sw_cfg *sw_cfg = private->sw_cfg;
+	struct snd_card *card = mixer->chip->card;
+	struct scarlett2_config_write writes[SCARLETT2_ANALOGUE_OUT_MAX];
+	int num_line_out  = ports[SCARLETT2_PORT_TYPE_ANALOGUE].num[SCARLETT2_PORT_OUT];
+	int num_sw_mutes  = ports[SCARLETT2_PORT_TYPE_SPDIF].num[SCARLETT2_PORT_OUT] +
+			    ports[SCARLETT2_PORT_TYPE_ADAT].num[SCARLETT2_PORT_OUT];
+	int num_mix_in    = ports[SCARLETT2_PORT_TYPE_MIX].num[SCARLETT2_PORT_OUT];
+	int num_mix_out   = ports[SCARLETT2_PORT_TYPE_MIX].num[SCARLETT2_PORT_IN];
+	int i, j, idx, num_writes = 0, err;
+	s16 level;
+	u32 mask;
 
-	mutex_lock(&private->data_mutex);
-	scarlett2_update_speaker_switch_enum_ctl(mixer);
+	/* Matrix mixer */
+	for (i = 0; (info->has_mixer) && (i < num_mix_out); ++i) {
+		mask = le32_to_cpu(sw_cfg->mixer_mute[i]);
+		for (j = 0, idx = i * SCARLETT2_INPUT_MIX_MAX; j < num_mix_in; ++j, ++idx) {
+			private->mix[idx] = scarlett2_float_to_mixer_level(le32_to_cpu(sw_cfg->mixer[i][j])) -
+					    (SCARLETT2_MIXER_MIN_DB * 2);
+			private->mix_mutes[idx] = !!(mask & (1 << j));
+			if (private->mix_ctls[idx])
+				snd_ctl_notify(card, SNDRV_CTL_EVENT_MASK_VALUE, &private->mix_ctls[idx]->id);
+			if (private->mix_mute_ctls[idx])
+				snd_ctl_notify(card, SNDRV_CTL_EVENT_MASK_VALUE, &private->mix_mute_ctls[idx]->id);
+		}
 
-	old_val = private->direct_monitor_switch;
-	val = ucontrol->value.integer.value[0];
-	val = (info->has_direct_monitor > 1) ? clamp(val, 0, 2) : !! val;
-	if (old_val == val)
-		goto unlock;
+		err = scarlett2_usb_set_mix(mixer, i);
+		if (err < 0)
+			return err;
+	}
 
-	private->direct_monitor_switch = val;
+	/* Software mutes follow the line outputs with hardware mutes */
+	if (info->has_mux) {
+		mask = le32_to_cpu(sw_cfg->mute_sw);
+		i = (info->has_hw_volume) ? num_line_out : 0;
+		for (j = i + num_sw_mutes; i < j; ++i) {
+			private->mutes[i] = !!(mask & (1 << i));
+			if (private->mute_ctls[i])
+				snd_ctl_notify(card, SNDRV_CTL_EVENT_MASK_VALUE, &private->mute_ctls[i]->id);
+		}
+	}
 
-	/* Update direct monitor settings */
-	err = scarlett2_usb_set_config(mixer, SCARLETT2_CONFIG_DIRECT_MONITOR_SWITCH, 0, val);
+	/* Routing */
+	if (info->has_mux) {
+		err = scarlett2_parse_sw_mux(mixer);
+		if (err < 0)
+			return err;
+		err = scarlett2_usb_set_mux(mixer);
+		if (err < 0)
+			return err;
 
-unlock:
-	mutex_unlock(&private->data_mutex);
-	return err;
-}
+		for (i = 0; i < private->num_outputs; ++i)
+			if (private->mux_ctls[i])
+				snd_ctl_notify(card, SNDRV_CTL_EVENT_MASK_VALUE, &private->mux_ctls[i]->id);
+	}
 
-static int scarlett2_speaker_switch_enum_ctl_put(
-	struct snd_kcontrol *kctl, struct snd_ctl_elem_value *ucontrol)
-{
-	struct usb_mixer_elem_info *elem = kctl->private_data;
-	struct usb_mixer_interface *mixer = elem->head.mixer;
-	struct scarlett2_mixer_data *private = mixer->private_data;
+	/* Software controlled line out volumes */
+	for (i = 0; (info->has_hw_volume) && (i < num_line_out); ++i) {
+		if (private->vol_sw_hw_switch[i])
+			continue;
+		level = le16_to_cpu(sw_cfg->volume[i].volume);
+		private->vol[i] = clamp(level + SCARLETT2_VOLUME_BIAS, 0, SCARLETT2_VOLUME_BIAS);
+		writes[num_writes++] = (struct scarlett2_config_write) {
+			SCARLETT2_CONFIG_LINE_OUT_VOLUME, i, private->vol[i] - SCARLETT2_VOLUME_BIAS
+		};
+	}
 
-	return scarlett2_speaker_switch_update_state(mixer,
-						     ucontrol->value.integer.value[0],
-						     private->talkback_switch);
+	err = (num_writes > 0) ? scarlett2_usb_set_config_multi(mixer, writes, num_writes) : 0;
+	scarlett2_mixer_interrupt_vol_change(mixer);
+
+	return err;
 }
 
-static int scarlett2_talkback_switch_ctl_put(
-	struct snd_kcontrol *kctl, struct snd_ctl_elem_value *ucontrol)
+/* Write the range to the device. The driver state decoded from the
+ * hardware configuration is refreshed on the next access of the
+ * controls. The software configuration gets the checksum recomputed
+ * and the state decoded from it refreshed; its header can not be
+ * written.
+ */
+static int scarlett2_hwdep_write(struct usb_mixer_interface *mixer,
+				 const struct scarlett2_hwdep_xfer *xfer, const u8 *buf)
 {
-	struct usb_mixer_elem_info *elem = kctl->private_data;
-	struct usb_mixer_interface *mixer = elem->head.mixer;
 	struct scarlett2_mixer_data *private = mixer->private_data;
+	int err;
 
-	return scarlett2_speaker_switch_update_state(mixer,
-						     private->speaker_switch,
-						     ucontrol->value.integer.value[0]);
-}
+	if ((xfer->offset >= SCARLETT2_SW_CONFIG_BASE) &&
+	    (xfer->offset - SCARLETT2_SW_CONFIG_BASE < offsetof(struct scarlett2_sw_cfg, out_mux)))
+		return -EPERM;
 
-static int scarlett2_mix_talkback_switch_ctl_put(
-	struct snd_kcontrol *kctl, struct snd_ctl_elem_value *ucontrol)
-{
-	struct usb_mixer_elem_info *elem = kctl->private_data;
-	struct usb_mixer_interface *mixer = elem->head.mixer;
-	struct scarlett2_mixer_data *private = mixer->private_data;
-	const struct scarlett2_ports *ports = private->info->ports;
-	int i, val, old_val, num_mixes, err = 0;
+	scarlett2_data_lock(private);
 
-	mutex_lock(&private->data_mutex);
+	if (xfer->offset >= SCARLETT2_SW_CONFIG_BASE) {
+		u8 *ptr = (u8 *)private->sw_cfg + xfer->offset - SCARLETT2_SW_CONFIG_BASE;
 
-	old_val  = private->mix_talkback[elem->control];
-	val      = !! ucontrol->value.integer.value[0];
-	if (old_val == val)
+		memcpy(ptr, buf, xfer->size);
+		err = scarlett2_commit_software_config(mixer, ptr, xfer->size);
+		if (err < 0)
+			goto unlock;
+
+		err = scarlett2_sw_cfg_decode(mixer);
 		goto unlock;
+	}
 
-	private->mix_talkback[elem->control] = val;
+	err = scarlett2_usb_set(mixer, xfer->offset, buf, xfer->size);
+	if (err < 0)
+		goto unlock;
 
-	/* Build bit mask for each mixer channel and commit to device */
-	val      = 0;
-	num_mixes = ports[SCARLETT2_PORT_TYPE_MIX].num[SCARLETT2_PORT_IN];
-	for (i=0; i<num_mixes; ++i)
-		val |= (private->mix_talkback[i]) << i;
+	scarlett2_config_mirror_update(private, xfer->offset, buf, xfer->size);
+	if (xfer->activate > 0)
+		scarlett2_activate(mixer, xfer->activate);
+	scarlett2_config_save_schedule(mixer);
 
-	err = scarlett2_usb_set_config(
-		mixer, SCARLETT2_CONFIG_MIX_TALKBACK,
-		0, val);
+	private->vol_updated = 1;
+	private->line_ctl_updated = 1;
+	private->speaker_updated = 1;
 
 unlock:
-	mutex_unlock(&private->data_mutex);
+	scarlett2_data_unlock(private);
 	return err;
 }
 
-static const struct snd_kcontrol_new scarlett2_speaker_switch_enum_ctl = {
-	.iface = SNDRV_CTL_ELEM_IFACE_MIXER,
-	.name = "",
-	.info = scarlett2_speaker_switch_enum_ctl_info,
-	.get  = scarlett2_speaker_switch_enum_ctl_get,
-	.put  = scarlett2_speaker_switch_enum_ctl_put,
-};
+static int scarlett2_hwdep_xfer(struct usb_mixer_interface *mixer,
+				unsigned int cmd, void __user *arg)
+{
+	struct scarlett2_mixer_data *private = mixer->private_data;
+	struct scarlett2_hwdep_xfer xfer;
+	u8 *buf;
+	int err;
 
-static const struct snd_kcontrol_new scarlett2_direct_monitor_switch_enum_ctl = {
-	.iface = SNDRV_CTL_ELEM_IFACE_MIXER,
-	.name = "",
-	.info = scarlett2_direct_monitor_switch_enum_ctl_info,
-	.get  = scarlett2_direct_monitor_switch_enum_ctl_get,
-	.put  = scarlett2_direct_monitor_switch_enum_ctl_put,
-};
+	if (copy_from_user(&xfer, arg, sizeof(xfer)))
+		return -EFAULT;
+	if (!scarlett2_hwdep_range_ok(private, xfer.offset, xfer.size) ||
+	    (xfer.activate >= 32))
+		return -EINVAL;
 
-static const struct snd_kcontrol_new scarlett2_talkback_switch_ctl = {
-	.iface = SNDRV_CTL_ELEM_IFACE_MIXER,
-	.name = "",
-	.info = snd_ctl_boolean_mono_info,
-	.get  = scarlett2_talkback_switch_ctl_get,
-	.put  = scarlett2_talkback_switch_ctl_put,
-};
+	buf = kmalloc(xfer.size, GFP_KERNEL);
+	if (!buf)
+		return -ENOMEM;
 
-static const struct snd_kcontrol_new scarlett2_mix_talkback_switch_ctl = {
-	.iface = SNDRV_CTL_ELEM_IFACE_MIXER,
-	.name = "",
-	.info = snd_ctl_boolean_mono_info,
-	.get  = scarlett2_mix_talkback_switch_ctl_get,
-	.put  = scarlett2_mix_talkback_switch_ctl_put,
-};
+	if (cmd == SCARLETT2_IOCTL_READ) {
+		err = scarlett2_hwdep_read(mixer, &xfer, buf);
+		if ((err >= 0) && copy_to_user(u64_to_user_ptr(xfer.data), buf, xfer.size))
+			err = -EFAULT;
+	} else if (copy_from_user(buf, u64_to_user_ptr(xfer.data), xfer.size))
+		err = -EFAULT;
+	else
+		err = scarlett2_hwdep_write(mixer, &xfer, buf);
+
+	kfree(buf);
+	return (err < 0) ? err : 0;
+}
+
+static int scarlett2_hwdep_ioctl(struct snd_hwdep *hw, struct file *file,
+				 unsigned int cmd, unsigned long arg)
+{
+	struct usb_mixer_interface *mixer = hw->private_data;
+	struct scarlett2_mixer_data *private = mixer->private_data;
+	struct scarlett2_hwdep_info info;
+
+	switch (cmd) {
+	case SCARLETT2_IOCTL_PVERSION:
+		return put_user(SCARLETT2_HWDEP_VERSION, (int __user *)arg) ? -EFAULT : 0;
+
+	case SCARLETT2_IOCTL_INFO:
+		memset(&info, 0, sizeof(info));
+		info.shm_size      = private->shm_size;
+		info.cfg_offset    = SCARLETT2_HWDEP_CFG_OFFSET;
+		info.cfg_size      = private->cfg_mirror_size;
+		info.sw_cfg_offset = SCARLETT2_HWDEP_SW_CFG_OFFSET;
+		info.sw_cfg_size   = (private->sw_cfg) ? sizeof(struct scarlett2_sw_cfg) : 0;
+		info.sw_cfg_base   = SCARLETT2_SW_CONFIG_BASE;
+		info.chunk_size    = private->chunk_size;
+		return copy_to_user((void __user *)arg, &info, sizeof(info)) ? -EFAULT : 0;
+
+	case SCARLETT2_IOCTL_READ:
+	case SCARLETT2_IOCTL_WRITE:
+		return scarlett2_hwdep_xfer(mixer, cmd, (void __user *)arg);
+
+	default:
+		return -ENOIOCTLCMD;
+	}
+}
 
-static int scarlett2_add_speaker_switch_ctl(
-	struct usb_mixer_interface *mixer)
+/* The copies are read-only for user space, changes go through ioctls */
+static int scarlett2_hwdep_mmap(struct snd_hwdep *hw, struct file *file,
+				struct vm_area_struct *vma)
 {
+	struct usb_mixer_interface *mixer = hw->private_data;
 	struct scarlett2_mixer_data *private = mixer->private_data;
-	const struct scarlett2_device_info *info = private->info;
-	const struct scarlett2_ports *ports = private->info->ports;
-	char s[SNDRV_CTL_ELEM_ID_NAME_MAXLEN];
-	int err = 0, num_mixes, i;
 
-	if (info->has_speaker_switching) {
-		/* Add speaker switching control */
-		err = scarlett2_add_new_ctl(
-			mixer, &scarlett2_speaker_switch_enum_ctl,
-			0, 1, "Speaker Switching", &private->speaker_ctl);
-		
-		if (err < 0)
-			return err;
-	}
+	if (vma->vm_flags & VM_WRITE)
+		return -EPERM;
+	vma->vm_flags &= ~VM_MAYWRITE;
 
-	if (info->has_direct_monitor) {
-		/* Add direct monitor control */
-		err = scarlett2_add_new_ctl(
-			mixer, &scarlett2_direct_monitor_switch_enum_ctl,
-			0, 1, "Direct Monitor", &private->direct_monitor_ctl);
+	return remap_vmalloc_range(vma, private->shm, vma->vm_pgoff);
+}
 
-		if (err < 0)
-			return err;
-	}
+static int scarlett2_hwdep_init(struct usb_mixer_interface *mixer)
+{
+	struct scarlett2_mixer_data *private = mixer->private_data;
+	struct snd_hwdep *hw;
+	int err;
 
-	if (info->has_talkback) {
-		/* Add talkback switching control */
-		err = scarlett2_add_new_ctl(
-			mixer, &scarlett2_talkback_switch_ctl,
-			0, 1, "Talkback Switching", &private->talkback_ctl);
-		
-		if (err < 0)
-			return err;
-		
-		/* Add 'talkback enable' for mix */
-		num_mixes = ports[SCARLETT2_PORT_TYPE_MIX].num[SCARLETT2_PORT_IN];
-		for (i=0; i<num_mixes; ++i) {
-			snprintf(s, sizeof(s), "Mix %c Talkback", 'A' + i);
-			
-			err = scarlett2_add_new_ctl(
-				mixer, &scarlett2_mix_talkback_switch_ctl,
-				i, 1, s, &private->mix_talkback_ctls[i]);
+	err = snd_hwdep_new(mixer->chip->card, "Focusrite Scarlett", 0, &hw);
+	if (err < 0)
+		return err;
 
-			if (err < 0)
-				return err;
-		}
-	}
+	strlcpy(hw->name, "Focusrite Scarlett Gen 2/3", sizeof(hw->name));
+	hw->private_data = mixer;
+	hw->ops.ioctl = scarlett2_hwdep_ioctl;
+	hw->ops.ioctl_compat = scarlett2_hwdep_ioctl;
+	hw->ops.mmap = scarlett2_hwdep_mmap;
+	private->hwdep = hw;
 
 	return 0;
 }
@@ -4559,9 +7845,25 @@ static void scarlett2_private_free(struct usb_mixer_interface *mixer)
 {
 	struct scarlett2_mixer_data *private = mixer->private_data;
 
+	debugfs_remove_recursive(private->debugfs_dir);
+
+	/* Mixer quirks have no disconnect callback, this is the last
+	 * chance to send the software configuration changes
+	 */
+	scarlett2_deferred_push(mixer);
+	cancel_delayed_work_sync(&private->sw_flush_work);
+	scarlett2_sw_cfg_flush(mixer);
+
+	cancel_delayed_work_sync(&private->activate_work);
 	cancel_delayed_work_sync(&private->work);
-	if (private->sw_cfg != NULL)
-		kfree(private->sw_cfg);
+	cancel_work_sync(&private->cfg_refresh_work);
+	scarlett2_cmd_free(private);
+	scarlett2_pcap_free(private);
+	if (private->wq)
+		destroy_workqueue(private->wq);
+	vfree(private->shm);
+	kfree(private->sw_cfg);
+	kfree(private->sw_cfg_shadow);
 	kfree(private);
 	mixer->private_data = NULL;
 }
@@ -4570,8 +7872,19 @@ static void scarlett2_private_suspend(struct usb_mixer_interface *mixer)
 {
 	struct scarlett2_mixer_data *private = mixer->private_data;
 
+	scarlett2_deferred_push(mixer);
+	cancel_delayed_work_sync(&private->sw_flush_work);
+	scarlett2_sw_cfg_flush(mixer);
+
+	cancel_delayed_work_sync(&private->activate_work);
+	cancel_work_sync(&private->cfg_refresh_work);
 	if (cancel_delayed_work_sync(&private->work))
 		scarlett2_config_save(private->mixer);
+	else
+		scarlett2_activate_flush(private->mixer);
+
+	/* Let the device receive everything before it gets suspended */
+	scarlett2_cmd_flush(private);
 }
 
 /* Look through the interface descriptors for the Focusrite Control
@@ -4616,7 +7929,11 @@ static int scarlett2_init_private(struct usb_mixer_interface *mixer,
 
 	mutex_init(&private->usb_mutex);
 	mutex_init(&private->data_mutex);
+	mutex_init(&private->meter_mutex);
 	INIT_DELAYED_WORK(&private->work, scarlett2_config_save_work);
+	INIT_DELAYED_WORK(&private->activate_work, scarlett2_activate_work);
+	INIT_DELAYED_WORK(&private->sw_flush_work, scarlett2_sw_cfg_flush_work);
+	INIT_WORK(&private->cfg_refresh_work, scarlett2_config_refresh_work);
 	mixer->private_data = private;
 	mixer->private_free = scarlett2_private_free;
 	mixer->private_suspend = scarlett2_private_suspend;
@@ -4632,55 +7949,105 @@ static int scarlett2_init_private(struct usb_mixer_interface *mixer,
 	private->talkback_switch = 0;
 	private->sw_cfg = NULL;
 
+	/* Allocate command slots and transfer buffers for the largest packet;
+	 * the command engine goes first, scarlett2_private_free() stops it
+	 * whatever fails next
+	 */
+	err = scarlett2_cmd_init(mixer);
+	if (err < 0)
+		return err;
+
+	/* The configuration copies live in memory which can be mapped by
+	 * user space through the hwdep device
+	 */
+	private->shm_size = SCARLETT2_HWDEP_SW_CFG_OFFSET + PAGE_ALIGN(sizeof(struct scarlett2_sw_cfg));
+	private->shm = vmalloc_user(private->shm_size);
+	if (!private->shm)
+		return -ENOMEM;
+	private->shm->version = SCARLETT2_HWDEP_VERSION;
+	private->cfg_mirror = (u8 *)private->shm + SCARLETT2_HWDEP_CFG_OFFSET;
+	scarlett2_config_mirror_init(private);
+
+	/* Saves and activations of one device run in order and ahead of normal work */
+	private->wq = alloc_ordered_workqueue("scarlett2-%s", WQ_HIGHPRI,
+					      dev_name(&mixer->chip->dev->dev));
+	if (!private->wq)
+		return -ENOMEM;
+
+	scarlett2_pcap_init(private);
+	scarlett2_pcm_init(private);
+	scarlett2_debugfs_init(mixer);
+
+	/* An emulated transport does not talk to the vendor-specific interface */
 	err = scarlett2_find_fc_interface(mixer->chip->dev, private);
 
-	if (err < 0)
+	if ((err < 0) && (!scarlett2_transport_emulated(private)))
 		return -EINVAL;
 
 	return 0;
 }
 
-/* Read line-in config and line-out volume settings on start */
+/* Read line-in config and line-out volume settings on start: the whole
+ * hardware configuration area is read with one request and every item
+ * is decoded from that snapshot
+ */
 static int scarlett2_read_configs(struct usb_mixer_interface *mixer)
 {
 	struct scarlett2_mixer_data *private = mixer->private_data;
 	const struct scarlett2_device_info *info = private->info;
 	const struct scarlett2_ports *ports = info->ports;
-	u8 msd_switch;
+	struct scarlett2_usb_volume_status volume_status;
+	u8 msd_switch, ghalo_flag;
+	u8 ghalo_leds[SCARLETT2_GAIN_HALO_LEDS_MAX], ghalo_levels[SCARLETT2_GAIN_HALO_LEVELS];
 	__le16 mix_talkbacks;
-	int err, i, num_mixes, val;
+	struct scarlett2_config_req reqs[5];
+	int err, i, num_mixes, val, num = 0;
+
+	/* Take the snapshot of the hardware configuration area */
+	err = scarlett2_config_mirror_fill(mixer);
+	if (err < 0)
+		return err;
 
 	/* LINE/INST, PAD, 48V power, 48V retain */
 	err = scarlett2_update_line_ctl_switches(mixer);
 	if (err < 0)
 		return err;
 
-	/* Mass Storage Device (MSD) mode */
-	if (info->has_msd_mode) {
-		err = scarlett2_usb_get_config(
-			mixer,
-			SCARLETT2_CONFIG_MSD_SWITCH,
-			1,
-			&msd_switch);
-		if (err < 0)
-			return err;
-		private->msd_switch = msd_switch;
-	}
-
 	/* Speaker switching (ALT button) and optional TALKBACK button */
 	err = scarlett2_update_speaker_switch_enum_ctl(mixer);
 	if (err < 0)
 		return err;
 
+	/* Mass Storage Device (MSD) mode, talkback routing and gain halos */
+	if (info->has_msd_mode)
+		reqs[num++] = (struct scarlett2_config_req) {
+			SCARLETT2_CONFIG_MSD_SWITCH, 1, &msd_switch
+		};
+	if (info->has_talkback)
+		reqs[num++] = (struct scarlett2_config_req) {
+			SCARLETT2_CONFIG_MIX_TALKBACK, 1, &mix_talkbacks
+		};
+	if (info->gain_halos_count > 0) {
+		reqs[num++] = (struct scarlett2_config_req) {
+			SCARLETT2_CONFIG_GAIN_HALO_ENABLE, 1, &ghalo_flag
+		};
+		reqs[num++] = (struct scarlett2_config_req) {
+			SCARLETT2_CONFIG_GAIN_HALO_LEVELS, SCARLETT2_GAIN_HALO_LEVELS, ghalo_levels
+		};
+		reqs[num++] = (struct scarlett2_config_req) {
+			SCARLETT2_CONFIG_GAIN_HALO_LEDS, info->gain_halos_count, ghalo_leds
+		};
+	}
+
+	err = scarlett2_usb_get_config_multi(mixer, reqs, num);
+	if (err < 0)
+		return err;
+
+	if (info->has_msd_mode)
+		private->msd_switch = msd_switch;
+
 	/* Talkback routing to each output of internal mixer */
 	if (info->has_talkback) {
-		err = scarlett2_usb_get_config(
-			mixer,
-			SCARLETT2_CONFIG_MIX_TALKBACK,
-			1, &mix_talkbacks);
-		if (err < 0)
-			return err;
-
 		/* Each talkback switch is just a bit assigned to the corresponding mixer output */
 		val = le16_to_cpu(mix_talkbacks);
 		num_mixes = ports[SCARLETT2_PORT_TYPE_MIX].num[SCARLETT2_PORT_IN];
@@ -4688,7 +8055,32 @@ static int scarlett2_read_configs(struct usb_mixer_interface *mixer)
 			private->mix_talkback[i] = !!(val & (1 << i));
 	}
 
-	/* Hardware-controlled volume and mute settings for outputs */
+	/* Gain halo custom flag and colors */
+	if (info->gain_halos_count > 0) {
+		private->ghalo_custom = (ghalo_flag == 0x02);
+		for (i = 0; i < SCARLETT2_GAIN_HALO_LEVELS; i++) {
+			val = ghalo_levels[i];
+			private->ghalo_levels[i] = clamp(val, 0, 7);
+		}
+		for (i = 0; i < info->gain_halos_count; i++) {
+			val = ghalo_leds[i];
+			private->ghalo_leds[i] = clamp(val, 0, 7);
+		}
+	}
+
+	/* Hardware-controlled volume and mute settings for outputs; the
+	 * volume status is the head of the configuration area
+	 */
+	if (info->has_hw_volume && private->vol_updated) {
+		memset(&volume_status, 0, sizeof(volume_status));
+		err = scarlett2_config_mirror_copy(private, 0, &volume_status,
+						   offsetof(struct scarlett2_usb_volume_status, pad4));
+		if (err >= 0) {
+			scarlett2_decode_volumes(mixer, &volume_status);
+			private->vol_updated = 0;
+		}
+	}
+
 	err = scarlett2_update_volumes(mixer);
 	if (err < 0)
 		return err;
@@ -4711,6 +8103,58 @@ static void scarlett2_calc_software_cksum(struct scarlett2_sw_cfg *sw) {
 	sw->checksum = cpu_to_le32(checksum);
 }
 
+/* Update the checksum with the difference between the committed and
+ * the changed words of the ranges, then commit the ranges; the whole
+ * area is marked as changed if the debug check resynchronises it
+ */
+static void scarlett2_update_software_cksum(struct usb_mixer_interface *mixer,
+					    unsigned long *changed)
+{
+	struct scarlett2_mixer_data *private = mixer->private_data;
+	struct scarlett2_sw_cfg *sw = private->sw_cfg, *shadow = private->sw_cfg_shadow;
+	const int size = sizeof(struct scarlett2_sw_cfg);
+	const __le32 *new_ptr = (const __le32 *)sw;
+	__le32 *old_ptr = (__le32 *)shadow;
+	int ck = offsetof(struct scarlett2_sw_cfg, checksum) / sizeof(__le32);
+	int i, offset, end;
+	s32 checksum = le32_to_cpu(shadow->checksum);
+
+	for (offset = find_first_bit(changed, size); offset < size;
+	     offset = find_next_bit(changed, size, end)) {
+		end = find_next_zero_bit(changed, size, offset);
+		for (i = offset / sizeof(__le32); i < DIV_ROUND_UP(end, sizeof(__le32)); ++i) {
+			if (i == ck)
+				continue;
+			checksum += le32_to_cpu(old_ptr[i]) - le32_to_cpu(new_ptr[i]);
+			old_ptr[i] = new_ptr[i];
+		}
+	}
+
+	shadow->checksum = cpu_to_le32(checksum);
+	sw->checksum = shadow->checksum;
+
+	if (!scarlett2_cksum_check)
+		return;
+
+	/* Debug: compare with the full recompute, resynchronise on mismatch */
+	scarlett2_calc_software_cksum(sw);
+	if (sw->checksum != shadow->checksum) {
+		usb_audio_warn(mixer->chip, "software configuration checksum mismatch: 0x%08x, expected 0x%08x",
+			       le32_to_cpu(shadow->checksum), le32_to_cpu(sw->checksum));
+		memcpy(shadow, sw, sizeof(struct scarlett2_sw_cfg));
+		bitmap_fill(changed, sizeof(struct scarlett2_sw_cfg));
+	}
+}
+
+/* Check the header of the software configuration area */
+static bool scarlett2_sw_cfg_header_ok(const struct scarlett2_sw_cfg *sw)
+{
+	return (le16_to_cpu(sw->all_size) == (sizeof(struct scarlett2_sw_cfg) + 0x0c)) &&
+	       (le16_to_cpu(sw->magic1) == 0x3006) &&
+	       (le32_to_cpu(sw->version) == 0x5) &&
+	       (le16_to_cpu(sw->szof) == sizeof(struct scarlett2_sw_cfg));
+}
+
 static int scarlett2_read_software_configs(struct usb_mixer_interface *mixer)
 {
 	struct scarlett2_mixer_data *private = mixer->private_data;
@@ -4769,10 +8213,7 @@ static int scarlett2_read_software_configs(struct usb_mixer_interface *mixer)
 		goto leave;
 	
 	/* Validate the software configuration area header */
-	if ((le16_to_cpu(sw->all_size) != (sizeof(struct scarlett2_sw_cfg) + 0x0c)) ||
-	    (le16_to_cpu(sw->magic1) != 0x3006) ||
-	    (le32_to_cpu(sw->version) != 0x5) ||
-	    (le16_to_cpu(sw->szof) != sizeof(struct scarlett2_sw_cfg))) {
+	if (!scarlett2_sw_cfg_header_ok(sw)) {
 
 		usb_audio_warn(mixer->chip, "The format of software configuration header "
 		    "does not match expected, will proceed with significantly "
@@ -4781,9 +8222,19 @@ static int scarlett2_read_software_configs(struct usb_mixer_interface *mixer)
 		goto leave;
 	}
 
-	/* Commit the pointer */
-	private->sw_cfg = sw;
-	sw              = NULL;
+	/* Make the working copy and the shared one, keep the read copy as
+	 * the base of the incremental checksum
+	 */
+	private->sw_cfg = kmemdup(sw, sizeof(struct scarlett2_sw_cfg), GFP_KERNEL);
+	if (private->sw_cfg == NULL) {
+		err = -ENOMEM;
+		goto leave;
+	}
+	private->sw_cfg_shm = (void *)private->shm + SCARLETT2_HWDEP_SW_CFG_OFFSET;
+	memcpy(private->sw_cfg_shm, sw, sizeof(struct scarlett2_sw_cfg));
+	scarlett2_calc_software_cksum(sw);
+	private->sw_cfg_shadow = sw;
+	sw = NULL;
 
 	usb_audio_info(mixer->chip, "Successfully initialized software configuration area");
 
@@ -4800,7 +8251,7 @@ static int scarlett2_commit_software_config(
 )
 {
 	struct scarlett2_mixer_data *private = mixer->private_data;
-	int offset, err = 0;
+	int offset;
 
 	/* Check bounds, we should not exceed them */
 	offset = ((u8 *)ptr) - ((u8 *)private->sw_cfg);
@@ -4812,30 +8263,170 @@ static int scarlett2_commit_software_config(
 		return -EINVAL;
 	}
 
-	/* Re-compute the checksum of the software configuration area */
-	scarlett2_calc_software_cksum(private->sw_cfg);
+	/* Stage the range; outside of a transaction it is committed at once */
+	bitmap_set(private->sw_staged, offset, bytes);
+	if (private->sw_txn_depth)
+		return 0;
 
-	/* Cancel any pending NVRAM save */
-	cancel_delayed_work_sync(&private->work);
+	return scarlett2_sw_cfg_txn_commit(mixer);
+}
 
-	/* Transfer the configuration with fixed-size data chunks */
-	err = scarlett2_usb_set(mixer, SCARLETT2_SW_CONFIG_BASE + offset, ptr, bytes);
-	if (err < 0)
-		goto leave;
+/* Open the transaction: the ranges passed to
+ * scarlett2_commit_software_config() are staged until the outermost
+ * scarlett2_sw_cfg_txn_commit() or scarlett2_sw_cfg_txn_abort().
+ * Transactions run under data_mutex.
+ */
+static void scarlett2_sw_cfg_txn_begin(struct usb_mixer_interface *mixer)
+{
+	struct scarlett2_mixer_data *private = mixer->private_data;
+
+	private->sw_txn_depth++;
+}
+
+/* Apply the staged ranges as one write set: one checksum update, then
+ * the ranges are handed over to the deferred flush
+ */
+static int scarlett2_sw_cfg_txn_commit(struct usb_mixer_interface *mixer)
+{
+	struct scarlett2_mixer_data *private = mixer->private_data;
+	const int size = sizeof(struct scarlett2_sw_cfg);
+	unsigned long flags;
+	int offset, end;
+
+	if (private->sw_txn_depth && --private->sw_txn_depth)
+		return 0;
+	if (!private->sw_cfg || bitmap_empty(private->sw_staged, size))
+		return 0;
+
+	/* Update the checksum of the software configuration area */
+	scarlett2_update_software_cksum(mixer, private->sw_staged);
+
+	/* Publish the committed ranges to the readers of the shared memory */
+	spin_lock_irqsave(&private->cfg_lock, flags);
+	scarlett2_shm_begin(private);
+	for (offset = find_first_bit(private->sw_staged, size); offset < size;
+	     offset = find_next_bit(private->sw_staged, size, end)) {
+		end = find_next_zero_bit(private->sw_staged, size, offset);
+		memcpy((u8 *)private->sw_cfg_shm + offset,
+		       (u8 *)private->sw_cfg_shadow + offset, end - offset);
+	}
+	private->sw_cfg_shm->checksum = private->sw_cfg_shadow->checksum;
+	scarlett2_shm_end(private);
+	spin_unlock_irqrestore(&private->cfg_lock, flags);
+
+	/* The ranges are sent by the deferred flush */
+	bitmap_or(private->sw_dirty, private->sw_dirty, private->sw_staged, size);
+	bitmap_zero(private->sw_staged, size);
+	private->stat_sw_commits++;
+	queue_delayed_work(private->wq, &private->sw_flush_work,
+			   msecs_to_jiffies(SCARLETT2_SW_FLUSH_DELAY));
+
+	/* Schedule the change to be written to NVRAM */
+	scarlett2_config_save_schedule(mixer);
+	return 0;
+}
+
+/* Drop the transaction and restore the staged ranges from the committed
+ * copy; nested transactions are dropped as a whole
+ */
+static void scarlett2_sw_cfg_txn_abort(struct usb_mixer_interface *mixer)
+{
+	struct scarlett2_mixer_data *private = mixer->private_data;
+	const int size = sizeof(struct scarlett2_sw_cfg);
+	int offset, end;
+
+	private->sw_txn_depth = 0;
+	if (!private->sw_cfg)
+		return;
+
+	for (offset = find_first_bit(private->sw_staged, size); offset < size;
+	     offset = find_next_bit(private->sw_staged, size, end)) {
+		end = find_next_zero_bit(private->sw_staged, size, offset);
+		memcpy((u8 *)private->sw_cfg + offset,
+		       (u8 *)private->sw_cfg_shadow + offset, end - offset);
+	}
+
+	bitmap_zero(private->sw_staged, size);
+	private->stat_sw_aborts++;
+}
+
+/* Send the dirty ranges of the software configuration, joined over
+ * short clean gaps, and then the checksum once
+ */
+static int scarlett2_sw_cfg_flush(struct usb_mixer_interface *mixer)
+{
+	struct scarlett2_mixer_data *private = mixer->private_data;
+	const int size = sizeof(struct scarlett2_sw_cfg);
+	int offset, end, next, ranges = 0, err = 0;
+	u8 *data;
+
+	scarlett2_data_lock(private);
+
+	if (!private->sw_cfg)
+		goto unlock;
+	data = (u8 *)private->sw_cfg;
+
+	for (offset = find_first_bit(private->sw_dirty, size); offset < size; offset = next) {
+		end = find_next_zero_bit(private->sw_dirty, size, offset);
+		next = find_next_bit(private->sw_dirty, size, end);
+
+		/* Sending a few clean bytes is cheaper than another request */
+		while ((next < size) && (next - end <= SCARLETT2_SW_FLUSH_GAP)) {
+			end = find_next_zero_bit(private->sw_dirty, size, next);
+			next = find_next_bit(private->sw_dirty, size, end);
+		}
+
+		err = scarlett2_usb_set(mixer, SCARLETT2_SW_CONFIG_BASE + offset,
+					&data[offset], end - offset);
+		if (err < 0)
+			goto fail;
+
+		bitmap_clear(private->sw_dirty, offset, end - offset);
+		private->sw_cksum_dirty = 1;
+		ranges++;
+	}
+
+	/* Also left over by a flush which has failed to send it */
+	if (!private->sw_cksum_dirty)
+		goto unlock;
 
 	/* Transfer the actual checksum */
 	err = scarlett2_usb_set(mixer, SCARLETT2_SW_CONFIG_BASE + offsetof(struct scarlett2_sw_cfg, checksum),
-	                        &private->sw_cfg->checksum, sizeof(private->sw_cfg->checksum)
-	         );
+				&private->sw_cfg->checksum, sizeof(private->sw_cfg->checksum));
 	if (err < 0)
-		goto leave;
+		goto fail;
 
-leave:
-	/* Schedule the change to be written to NVRAM */
-	schedule_delayed_work(&private->work, msecs_to_jiffies(2000));
+	private->sw_cksum_dirty = 0;
+	private->stat_sw_flushes++;
+	private->stat_sw_ranges += ranges;
+	goto unlock;
+
+fail:
+	usb_audio_warn(mixer->chip, "failed to send the software configuration: %d", err);
+unlock:
+	scarlett2_data_unlock(private);
 	return err;
 }
 
+/* Delayed work to send the software configuration changes */
+static void scarlett2_sw_cfg_flush_work(struct work_struct *work)
+{
+	struct scarlett2_mixer_data *private =
+		container_of(work, struct scarlett2_mixer_data, sw_flush_work.work);
+
+	int err;
+
+	/* Held back until the deferred commit mode is turned off */
+	if (READ_ONCE(private->deferred))
+		return;
+
+	/* The unsent ranges and checksum are kept for another attempt */
+	err = scarlett2_sw_cfg_flush(private->mixer);
+	if ((err < 0) && (err != -ENODEV) && (err != -ESHUTDOWN))
+		queue_delayed_work(private->wq, &private->sw_flush_work,
+				   msecs_to_jiffies(SCARLETT2_SW_FLUSH_RETRY_DELAY));
+}
+
 /* Notify on volume change */
 static void scarlett2_mixer_interrupt_vol_change(
 	struct usb_mixer_interface *mixer)
@@ -4953,6 +8544,9 @@ static void scarlett2_mixer_interrupt(struct urb *urb)
 	if (len == 8) {
 		u32 data = le32_to_cpu(*(u32 *)urb->transfer_buffer);
 
+		/* Forget the configuration changed by the device */
+		scarlett2_config_mirror_invalidate(mixer->private_data, data);
+
 		/* Notify clients about changes */
 		if (data & SCARLETT2_USB_INTERRUPT_VOL_CHANGE)
 			scarlett2_mixer_interrupt_vol_change(mixer);
@@ -4980,6 +8574,135 @@ requeue:
 	}
 }
 
+/* Take the software configuration of the device over after its header
+ * has changed while suspended, the cached one is not written over it;
+ * called with data_mutex held
+ */
+static int scarlett2_sw_cfg_reload(struct usb_mixer_interface *mixer)
+{
+	struct scarlett2_mixer_data *private = mixer->private_data;
+	const int size = sizeof(struct scarlett2_sw_cfg);
+	struct scarlett2_sw_cfg *sw;
+	unsigned long flags;
+	int err;
+
+	sw = kmalloc(size, GFP_KERNEL);
+	if (!sw)
+		return -ENOMEM;
+
+	err = scarlett2_usb_get(mixer, SCARLETT2_SW_CONFIG_BASE, sw, size);
+	if (err < 0)
+		goto leave;
+
+	if (!scarlett2_sw_cfg_header_ok(sw)) {
+		usb_audio_warn(mixer->chip, "The format of software configuration header "
+			       "has changed while suspended, the area is left as it is");
+		goto leave;
+	}
+
+	/* The device holds the newer data, nothing is left to send */
+	bitmap_zero(private->sw_dirty, size);
+	private->sw_cksum_dirty = 0;
+	memcpy(private->sw_cfg, sw, size);
+
+	spin_lock_irqsave(&private->cfg_lock, flags);
+	scarlett2_shm_begin(private);
+	memcpy(private->sw_cfg_shm, sw, size);
+	scarlett2_shm_end(private);
+	spin_unlock_irqrestore(&private->cfg_lock, flags);
+
+	scarlett2_calc_software_cksum(sw);
+	memcpy(private->sw_cfg_shadow, sw, size);
+
+	err = scarlett2_sw_cfg_decode(mixer);
+
+leave:
+	kfree(sw);
+	return err;
+}
+
+/* Check the state cached by the driver after the device has lost power:
+ * the header and the checksum of the software configuration tell if it
+ * still holds what has been flushed on suspend, the hardware
+ * configuration is compared with the mirror by one read. On mismatch
+ * the software configuration, mux and mix are pushed again, or read
+ * back if the header differs. Failures are only reported, so the other
+ * elements of the mixer are resumed anyway.
+ */
+static int scarlett2_resume(struct usb_mixer_elem_list *list)
+{
+	struct usb_mixer_interface *mixer = list->mixer;
+	struct scarlett2_mixer_data *private = mixer->private_data;
+	const struct scarlett2_ports *ports = private->info->ports;
+	struct scarlett2_sw_cfg *shadow = private->sw_cfg_shadow;
+	u8 mirror[SCARLETT2_CONFIG_MIRROR_MAX];
+	u8 header[offsetof(struct scarlett2_sw_cfg, out_mux)];
+	__le32 checksum;
+	int i, err;
+
+	/* Redo the handshake, the device has forgotten the sequence */
+	err = scarlett2_usb_init(mixer);
+	if (err < 0)
+		goto leave;
+
+	scarlett2_data_lock(private);
+
+	/* Hardware configuration */
+	err = scarlett2_config_mirror_copy(private, 0, mirror, private->cfg_mirror_size);
+	if (err < 0)
+		goto unlock;
+	err = scarlett2_config_mirror_fill(mixer);
+	if (err < 0)
+		goto unlock;
+
+	if (memcmp(mirror, private->cfg_mirror, private->cfg_mirror_size)) {
+		usb_audio_info(mixer->chip, "hardware configuration has changed while suspended");
+		scarlett2_mixer_interrupt_vol_change(mixer);
+		scarlett2_mixer_interrupt_line_in_ctl_change(mixer);
+		scarlett2_mixer_interrupt_button_change(mixer);
+		scarlett2_mixer_interrupt_speaker_change(mixer);
+	}
+
+	/* Software configuration */
+	if (!private->sw_cfg)
+		goto unlock;
+
+	err = scarlett2_usb_get(mixer, SCARLETT2_SW_CONFIG_BASE, header, sizeof(header));
+	if (err < 0)
+		goto unlock;
+	err = scarlett2_usb_get(mixer, SCARLETT2_SW_CONFIG_BASE + offsetof(struct scarlett2_sw_cfg, checksum),
+				&checksum, sizeof(checksum));
+	if (err < 0)
+		goto unlock;
+
+	if (memcmp(header, shadow, sizeof(header))) {
+		usb_audio_info(mixer->chip, "software configuration has been replaced while suspended, reading it");
+		err = scarlett2_sw_cfg_reload(mixer);
+		goto unlock;
+	}
+
+	if (checksum == shadow->checksum)
+		goto unlock;
+
+	usb_audio_info(mixer->chip, "software configuration has changed while suspended, restoring it");
+
+	bitmap_fill(private->sw_dirty, sizeof(struct scarlett2_sw_cfg));
+	mod_delayed_work(private->wq, &private->sw_flush_work, 0);
+
+	err = scarlett2_usb_set_mux(mixer);
+	for (i = 0; (err >= 0) && (i < ports[SCARLETT2_PORT_TYPE_MIX].num[SCARLETT2_PORT_IN]); ++i)
+		err = scarlett2_usb_set_mix(mixer, i);
+
+	scarlett2_config_save_schedule(mixer);
+
+unlock:
+	scarlett2_data_unlock(private);
+leave:
+	if (err < 0)
+		usb_audio_err(mixer->chip, "failed to check the state after resume: %d", err);
+	return 0;
+}
+
 static int scarlett2_mixer_status_create(struct usb_mixer_interface *mixer)
 {
 	struct usb_device *dev = mixer->chip->dev;
@@ -5017,6 +8740,8 @@ int snd_scarlett_gen2_controls_create(struct usb_mixer_interface *mixer)
 {
 	struct snd_usb_audio *chip = mixer->chip;
 	const struct scarlett2_device_info *info;
+	struct scarlett2_mixer_data *private;
+	struct usb_mixer_elem_info *elem;
 	int i, err;
 
 	/* only use UAC_VERSION_2 */
@@ -5055,6 +8780,9 @@ int snd_scarlett_gen2_controls_create(struct usb_mixer_interface *mixer)
 	if (err < 0)
 		return err;
 
+	/* Find out how much data can be transferred at once */
+	scarlett2_usb_probe_chunk_size(mixer);
+
 	/* Read volume levels and controls from the interface */
 	err = scarlett2_read_configs(mixer);
 	if (err < 0)
@@ -5110,11 +8838,36 @@ int snd_scarlett_gen2_controls_create(struct usb_mixer_interface *mixer)
 	if (err < 0)
 		return err;
 
-	/* Set up the interrupt polling */
-	err = scarlett2_mixer_status_create(mixer);
+	/* Create the command status control */
+	err = scarlett2_add_cmd_status_ctl(mixer);
+	if (err < 0)
+		return err;
+
+	/* Create the deferred commit control */
+	err = scarlett2_add_new_ctl(mixer, &scarlett2_deferred_ctl, 0, 1,
+				    "Deferred Commit Switch", NULL);
+	if (err < 0)
+		return err;
+
+	/* Create the hwdep device for raw access to the configuration */
+	err = scarlett2_hwdep_init(mixer);
 	if (err < 0)
 		return err;
 
+	/* Set up the interrupt polling, an emulated device sends no notifications */
+	private = mixer->private_data;
+	if (!scarlett2_transport_emulated(private)) {
+		err = scarlett2_mixer_status_create(mixer);
+		if (err < 0)
+			return err;
+	}
+
+	/* Mixer quirks have no resume callback, the reset-resume hook of
+	 * one element runs the check of the cached state
+	 */
+	elem = private->cmd_status_ctl->private_data;
+	elem->head.resume = scarlett2_resume;
+
 	usb_audio_info(chip, "Mixer driver has been initialized");
 
 	return 0;
@@ -0,0 +1,62 @@
+/* SPDX-License-Identifier: GPL-2.0 WITH Linux-syscall-note */
+/*
+ *   User space interface of the Focusrite Scarlett Gen 2/3 hwdep device
+ *
+ *   Copyright (c) 2020 by Vladimir Sadovnikov <sadko4u at gmail.com>
+ */
+
+#ifndef __SCARLETT2_HWDEP_H
+#define __SCARLETT2_HWDEP_H
+
+#include <linux/types.h>
+#include <linux/ioctl.h>
+
+#define SCARLETT2_HWDEP_VERSION                  0x00010001
+
+/* The device memory shared read-only with mmap(): the header, then the
+ * copy of the hardware configuration area and the copy of the software
+ * configuration area at the offsets reported by SCARLETT2_IOCTL_INFO.
+ * seq is odd while the driver updates either copy and grows after each
+ * change; readers should retry if it is odd or has changed while they
+ * were copying the data. The software configuration copy holds only
+ * the committed changes. cfg_stale is set when the device reports a
+ * change of its configuration and cleared once the driver has read
+ * the hardware configuration copy again.
+ */
+struct scarlett2_hwdep_shm {
+	__u32 version;                                                    /* SCARLETT2_HWDEP_VERSION */
+	__u32 seq;                                                        /* Change counter */
+	__u32 cfg_stale;                                                  /* Hardware configuration copy misses device changes */
+};
+
+/* Layout of the shared memory */
+struct scarlett2_hwdep_info {
+	__u32 shm_size;                                                   /* Size to pass to mmap() */
+	__u32 cfg_offset;                                                 /* Offset of the hardware configuration copy */
+	__u32 cfg_size;                                                   /* Size of the hardware configuration copy */
+	__u32 sw_cfg_offset;                                              /* Offset of the software configuration copy */
+	__u32 sw_cfg_size;                                                /* Size of the software configuration, 0 if missing */
+	__u32 sw_cfg_base;                                                /* Device address of the software configuration */
+	__u32 chunk_size;                                                 /* Largest chunk read with one request */
+};
+
+/* Ranged access to the device memory: the hardware configuration area
+ * starting at 0 and the software configuration area starting at
+ * sw_cfg_base. Writes of the software configuration get the checksum
+ * recomputed by the driver; activate is the notification sent after a
+ * write of the hardware configuration, 0 for none.
+ */
+struct scarlett2_hwdep_xfer {
+	__u32 offset;                                                     /* Device address of the first byte */
+	__u32 size;                                                       /* Number of bytes */
+	__u32 activate;                                                   /* Activation to send after a write */
+	__u32 __pad;
+	__u64 data;                                                       /* User space buffer */
+};
+
+#define SCARLETT2_IOCTL_PVERSION _IOR('S', 0x60, int)
+#define SCARLETT2_IOCTL_INFO     _IOR('S', 0x61, struct scarlett2_hwdep_info)
+#define SCARLETT2_IOCTL_READ     _IOW('S', 0x62, struct scarlett2_hwdep_xfer)
+#define SCARLETT2_IOCTL_WRITE    _IOW('S', 0x63, struct scarlett2_hwdep_xfer)
+
+#endif /* __SCARLETT2_HWDEP_H */
@@ -0,0 +1,121 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+/*
+ *   Tracepoints of the Focusrite Scarlett Gen 2/3 proprietary protocol
+ *
+ *   Copyright (c) 2020 by Vladimir Sadovnikov <sadko4u at gmail.com>
+ */
+
+#undef TRACE_SYSTEM
+#define TRACE_SYSTEM snd_scarlett2
+
+#if !defined(__SCARLETT2_TRACE_H) || defined(TRACE_HEADER_MULTI_READ)
+#define __SCARLETT2_TRACE_H
+
+#include <linux/types.h>
+#include <linux/tracepoint.h>
+
+/* Round trip of the command through the queue and the transport */
+TRACE_EVENT(scarlett2_cmd_done,
+	TP_PROTO(u32 cmd, u16 seq, u16 req_size, u16 resp_size, int err,
+		 u64 queue_ns, u64 xfer_ns),
+	TP_ARGS(cmd, seq, req_size, resp_size, err, queue_ns, xfer_ns),
+	TP_STRUCT__entry(
+		__field(u32, cmd)
+		__field(u16, seq)
+		__field(u16, req_size)
+		__field(u16, resp_size)
+		__field(int, err)
+		__field(u64, queue_ns)
+		__field(u64, xfer_ns)
+	),
+	TP_fast_assign(
+		__entry->cmd = cmd;
+		__entry->seq = seq;
+		__entry->req_size = req_size;
+		__entry->resp_size = resp_size;
+		__entry->err = err;
+		__entry->queue_ns = queue_ns;
+		__entry->xfer_ns = xfer_ns;
+	),
+	TP_printk("cmd=0x%x seq=%u req=%u resp=%u err=%d queued=%lluns xfer=%lluns",
+		  __entry->cmd, __entry->seq, __entry->req_size, __entry->resp_size,
+		  __entry->err, __entry->queue_ns, __entry->xfer_ns)
+);
+
+/* Synchronous command issued with scarlett2_usb() */
+TRACE_EVENT(scarlett2_usb,
+	TP_PROTO(u32 cmd, u16 seq, u16 req_size, u16 resp_size, int err,
+		 u64 wait_ns, u64 latency_ns),
+	TP_ARGS(cmd, seq, req_size, resp_size, err, wait_ns, latency_ns),
+	TP_STRUCT__entry(
+		__field(u32, cmd)
+		__field(u16, seq)
+		__field(u16, req_size)
+		__field(u16, resp_size)
+		__field(int, err)
+		__field(u64, wait_ns)
+		__field(u64, latency_ns)
+	),
+	TP_fast_assign(
+		__entry->cmd = cmd;
+		__entry->seq = seq;
+		__entry->req_size = req_size;
+		__entry->resp_size = resp_size;
+		__entry->err = err;
+		__entry->wait_ns = wait_ns;
+		__entry->latency_ns = latency_ns;
+	),
+	TP_printk("cmd=0x%x seq=%u req=%u resp=%u err=%d wait=%lluns latency=%lluns",
+		  __entry->cmd, __entry->seq, __entry->req_size, __entry->resp_size,
+		  __entry->err, __entry->wait_ns, __entry->latency_ns)
+);
+
+/* Chunks of scarlett2_usb_get() and scarlett2_usb_set(); wait_ns is
+ * the time spent on usb_mutex (get) or in the queue (set), latency_ns
+ * is the round trip (get) or the transfer (set). SET_DATA chunks are
+ * traced when their transfer completes.
+ */
+DECLARE_EVENT_CLASS(scarlett2_chunk,
+	TP_PROTO(u16 seq, u32 offset, u16 size, int err, u64 wait_ns, u64 latency_ns),
+	TP_ARGS(seq, offset, size, err, wait_ns, latency_ns),
+	TP_STRUCT__entry(
+		__field(u16, seq)
+		__field(u32, offset)
+		__field(u16, size)
+		__field(int, err)
+		__field(u64, wait_ns)
+		__field(u64, latency_ns)
+	),
+	TP_fast_assign(
+		__entry->seq = seq;
+		__entry->offset = offset;
+		__entry->size = size;
+		__entry->err = err;
+		__entry->wait_ns = wait_ns;
+		__entry->latency_ns = latency_ns;
+	),
+	TP_printk("seq=%u offset=0x%x size=%u err=%d wait=%lluns latency=%lluns",
+		  __entry->seq, __entry->offset, __entry->size, __entry->err,
+		  __entry->wait_ns, __entry->latency_ns)
+);
+
+DEFINE_EVENT(scarlett2_chunk, scarlett2_usb_get_chunk,
+	TP_PROTO(u16 seq, u32 offset, u16 size, int err, u64 wait_ns, u64 latency_ns),
+	TP_ARGS(seq, offset, size, err, wait_ns, latency_ns)
+);
+
+DEFINE_EVENT(scarlett2_chunk, scarlett2_usb_set_chunk,
+	TP_PROTO(u16 seq, u32 offset, u16 size, int err, u64 wait_ns, u64 latency_ns),
+	TP_ARGS(seq, offset, size, err, wait_ns, latency_ns)
+);
+
+#endif /* __SCARLETT2_TRACE_H */
+
+/* The header lives next to the driver in sound/usb; the path is
+ * relative to include/trace, so no extra include flags are needed
+ */
+#undef TRACE_INCLUDE_PATH
+#define TRACE_INCLUDE_PATH ../../sound/usb
+#undef TRACE_INCLUDE_FILE
+#define TRACE_INCLUDE_FILE mixer_scarlett_gen2_trace
+#include <trace/define_trace.h>